@@ -0,0 +1,108 @@
+// One brain step for every blob: a Sequential::forward per blob on a 1-row tensor,
+// against BatchedBrains running the whole population as one batch, with one shared
+// network and with 1, 100 or one-per-blob genomes (grouped GEMM). Sensing and acting
+// are included in every column; the sight query is answered once, outside the timings.
+//   BrainBench [threads] [blobs]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "Brains.hpp"
+#include "SpatialGrid.hpp"
+
+using namespace NeuralNetwork;
+
+namespace
+{
+    template <class Fn>
+    double bestSeconds(int reps, Fn &&fn)
+    {
+        double best = 1e30;
+        for (int r = 0; r < reps; ++r)
+        {
+            auto t0 = std::chrono::steady_clock::now();
+            fn();
+            auto t1 = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+        }
+        return best;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const size_t threads = argc > 1 ? size_t(std::atoi(argv[1])) : std::max(1u, std::thread::hardware_concurrency());
+    const size_t blobs = argc > 2 ? size_t(std::atol(argv[2])) : 100000;
+    ThreadPool pool(threads);
+
+    sim::WorldConfig config;
+    config.width = config.height = std::sqrt(16.f * float(blobs));
+    sim::World world(pool, config);
+    world.spawnRandom(blobs, 5);
+    sim::SpatialGrid grid(config.width, config.height, 16.f);
+    grid.build(pool, world.x.data(), world.y.data(), blobs);
+    std::vector<int64_t> nearest(blobs);
+    grid.nearestAll(pool, world.sight.data(), nearest.data());
+
+    std::printf("threads=%zu  blobs=%zu\n", threads, blobs);
+    std::printf("%-14s %12s %12s %12s %12s %12s %10s\n", "brain", "per-blob ms", "shared ms", "1 genome ms",
+                "100 gen. ms", "per-blob gen", "speedup");
+    for (const std::vector<int> &widths : {std::vector<int>{sim::kSensorCount, 16, sim::kActionCount},
+                                           std::vector<int>{sim::kSensorCount, 64, 64, sim::kActionCount}})
+    {
+        evo::Topology topology;
+        topology.widths = widths;
+        sim::BatchedBrains brains(topology);
+        evo::Population population(pool, topology, blobs, {}, 9);
+        std::unique_ptr<Sequential> shared = topology.build(pool);
+        topology.load(population.genome(0), *shared);
+
+        // Baseline: one forward per blob, the way a per-object Blob would think.
+        std::vector<float> sensors(blobs * sim::kSensorCount);
+        const double tLoop = bestSeconds(1, [&]
+                                         {
+            sim::BatchedBrains::sense(pool, world, nearest.data(), nullptr, blobs, sensors.data());
+            for (size_t i = 0; i < blobs; ++i)
+            {
+                Tensor row(2, &pool, {1, sim::kSensorCount});
+                std::memcpy(row.data, sensors.data() + i * sim::kSensorCount, sizeof(float) * sim::kSensorCount);
+                const Tensor out = shared->forward(row);
+                const uint32_t r = uint32_t(i);
+                sim::BatchedBrains::act(pool, world, &r, 1, out.data);
+            } });
+        const std::vector<int8_t> loopTurn = world.turn;
+
+        const int reps = 5;
+        const double tShared = bestSeconds(reps, [&]
+                                           { brains.run(world, nearest.data(), *shared); });
+        const bool sharedSame = world.turn == loopTurn;
+
+        std::vector<uint32_t> group(blobs, 0);
+        const double tOne = bestSeconds(reps, [&]
+                                        { brains.run(world, nearest.data(), population.genome(0), 1, group.data()); });
+        const bool oneSame = world.turn == loopTurn;
+        for (size_t i = 0; i < blobs; ++i)
+            group[i] = uint32_t(i % 100);
+        const double tHundred = bestSeconds(reps, [&]
+                                            { brains.run(world, nearest.data(), population.genome(0), 100, group.data()); });
+        for (size_t i = 0; i < blobs; ++i)
+            group[i] = uint32_t(i);
+        const double tEach = bestSeconds(reps, [&]
+                                         { brains.run(world, nearest.data(), population.genome(0), blobs, group.data()); });
+
+        char label[32];
+        int at = 0;
+        for (size_t l = 0; l < widths.size(); ++l)
+            at += std::snprintf(label + at, sizeof(label) - size_t(at), l ? "-%d" : "%d", widths[l]);
+        std::printf("%-14s %12.1f %12.1f %12.1f %12.1f %12.1f %9.0fx%s\n", label, tLoop * 1e3, tShared * 1e3,
+                    tOne * 1e3, tHundred * 1e3, tEach * 1e3, tLoop / tShared,
+                    sharedSame && oneSame ? "" : "  (batched turns differ)");
+    }
+    return 0;
+}
@@ -0,0 +1,100 @@
+// Compares the packed, cache-blocked sgemm behind matmul_rows against the
+// previous row-wise kernel on the shapes Dense::forward/backward produce.
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Ops_Parallel.h"
+
+namespace
+{
+    // The original matmul_rows: B is walked column-wise in the inner loop.
+    void matmul_rows_naive(ThreadPool *pool,
+                           const float *A, int Ar, int Ac, int Astr0, int Astr1,
+                           const float *B, int Bc, int Bstr0, int Bstr1,
+                           float *C, int Cstr0, int Cstr1)
+    {
+        ForEachRange(pool, 0, Ar, [&](int64_t s, int64_t e)
+                     {
+            for (int i = int(s); i < int(e); ++i) {
+                const float* aRow = A + i * Astr0;
+                for (int j = 0; j < Bc; ++j) {
+                    float sum = 0.f;
+                    for (int k = 0; k < Ac; ++k)
+                        sum += aRow[k * Astr1] * B[k * Bstr0 + j * Bstr1];
+                    C[i * Cstr0 + j * Cstr1] = sum;
+                }
+            } });
+    }
+
+    struct Shape
+    {
+        const char *what;
+        int M, K, N;
+    };
+
+    template <class Fn>
+    double bestSeconds(int reps, Fn &&fn)
+    {
+        double best = 1e30;
+        for (int r = 0; r < reps; ++r)
+        {
+            auto t0 = std::chrono::steady_clock::now();
+            fn();
+            auto t1 = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+        }
+        return best;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const size_t threads = argc > 1 ? size_t(std::atoi(argv[1])) : std::max(1u, std::thread::hardware_concurrency());
+    ThreadPool pool(threads);
+
+    // Dense(in, out) at batch B: forward X[B,in]·W[in,out], dX = dY[B,out]·W^T, dW = X^T·dY.
+    const Shape shapes[] = {
+        {"fwd  784->128 b64", 64, 784, 128},
+        {"dX   784<-128 b64", 64, 128, 784},
+        {"dW   784x128  b64", 784, 64, 128},
+        {"fwd  128->64  b64", 64, 128, 64},
+        {"fwd  64->10   b64", 64, 64, 10},
+        {"fwd  784->512 b256", 256, 784, 512},
+        {"fwd  512->512 b256", 256, 512, 512},
+        {"dW   512x512  b256", 512, 256, 512},
+        {"fwd  1024->1024 b512", 512, 1024, 1024},
+    };
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> dist(-1.f, 1.f);
+
+    std::printf("threads=%zu  tile=%dx%d  KC=%d MC=%d NC=%d\n", threads, gemm::MR, gemm::NR, gemm::KC, gemm::MC, gemm::NC);
+    std::printf("%-22s %10s %10s %10s %10s %8s\n", "shape", "naive ms", "GFLOP/s", "blocked ms", "GFLOP/s", "speedup");
+    for (const Shape &s : shapes)
+    {
+        std::vector<float> A(size_t(s.M) * s.K), B(size_t(s.K) * s.N), C0(size_t(s.M) * s.N), C1(C0.size());
+        for (float &v : A)
+            v = dist(rng);
+        for (float &v : B)
+            v = dist(rng);
+
+        const double flops = 2.0 * s.M * s.N * s.K;
+        const int reps = flops > 1e9 ? 3 : 10;
+        double tn = bestSeconds(reps, [&]
+                                { matmul_rows_naive(&pool, A.data(), s.M, s.K, s.K, 1, B.data(), s.N, s.N, 1, C0.data(), s.N, 1); });
+        double tb = bestSeconds(reps, [&]
+                                { matmul_rows(&pool, A.data(), s.M, s.K, s.K, 1, B.data(), s.N, s.N, 1, C1.data(), s.N, 1); });
+
+        float maxErr = 0.f;
+        for (size_t i = 0; i < C0.size(); ++i)
+            maxErr = std::max(maxErr, std::fabs(C0[i] - C1[i]));
+
+        std::printf("%-22s %10.3f %10.2f %10.3f %10.2f %7.1fx%s\n", s.what,
+                    tn * 1e3, flops / tn * 1e-9, tb * 1e3, flops / tb * 1e-9, tn / tb,
+                    maxErr > 1e-3f ? "  MISMATCH" : "");
+    }
+    return 0;
+}
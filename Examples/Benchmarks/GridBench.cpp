@@ -0,0 +1,108 @@
+// Spatial grid vs brute force for the per-tick "what does every blob see" query.
+// Density is held at one blob per 16 square units (1M blobs on 4096 x 4096) and sight
+// ranges are the world's, 4..32, so the grid's work per blob stays flat as the
+// population grows while brute force grows with it. Brute force runs up to 30K blobs
+// and doubles as a check of the grid's answers.
+//   GridBench [threads] [cell size]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "ParallelFor.h"
+#include "SpatialGrid.hpp"
+#include "World.hpp"
+
+namespace
+{
+    template <class Fn>
+    double bestSeconds(int reps, Fn &&fn)
+    {
+        double best = 1e30;
+        for (int r = 0; r < reps; ++r)
+        {
+            auto t0 = std::chrono::steady_clock::now();
+            fn();
+            auto t1 = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+        }
+        return best;
+    }
+
+    void nearestBrute(ThreadPool &pool, const sim::World &w, std::vector<int64_t> &out)
+    {
+        const int64_t n = int64_t(w.size());
+        ParallelFor(pool, 0, n, [&](int64_t s, int64_t e)
+                    {
+            for (int64_t i = s; i < e; ++i)
+            {
+                int64_t best = -1;
+                float bestD2 = w.sight[i] * w.sight[i];
+                for (int64_t j = 0; j < n; ++j)
+                {
+                    const float dx = w.x[j] - w.x[i], dy = w.y[j] - w.y[i];
+                    const float d2 = dx * dx + dy * dy;
+                    if (j != i && d2 <= bestD2 && (best < 0 || d2 < bestD2))
+                    {
+                        best = j;
+                        bestD2 = d2;
+                    }
+                }
+                out[i] = best;
+            } }, -1, 1);
+    }
+
+    float dist2(const sim::World &w, size_t i, int64_t j)
+    {
+        if (j < 0)
+            return -1.f;
+        const float dx = w.x[size_t(j)] - w.x[i], dy = w.y[size_t(j)] - w.y[i];
+        return dx * dx + dy * dy;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const size_t threads = argc > 1 ? size_t(std::atoi(argv[1])) : std::max(1u, std::thread::hardware_concurrency());
+    ThreadPool pool(threads);
+    const float cell = argc > 2 ? float(std::atof(argv[2])) : 16.f;
+
+    std::printf("threads=%zu  cell=%.0f\n", threads, cell);
+    std::printf("%-9s %10s %10s %12s %12s %12s %8s\n", "blobs", "build ms", "query ms", "ns/blob", "brute ms", "speedup", "check");
+    for (size_t n : {10000, 30000, 100000, 300000, 1000000})
+    {
+        sim::WorldConfig config;
+        config.width = config.height = std::sqrt(16.f * float(n));
+        sim::World world(pool, config);
+        world.spawnRandom(n, 3);
+
+        sim::SpatialGrid grid(config.width, config.height, cell);
+        std::vector<int64_t> seen(n), brute(n);
+        const int reps = n <= 100000 ? 20 : 5;
+
+        const double tb = bestSeconds(reps, [&]
+                                      { grid.build(pool, world.x.data(), world.y.data(), n); });
+        const double tq = bestSeconds(reps, [&]
+                                      { grid.nearestAll(pool, world.sight.data(), seen.data()); });
+
+        char bruteMs[32] = "-", speedup[32] = "-", check[16] = "-";
+        if (n <= 30000)
+        {
+            const double tf = bestSeconds(1, [&]
+                                          { nearestBrute(pool, world, brute); });
+            // Ties may pick different blobs; the distance must agree.
+            size_t bad = 0;
+            for (size_t i = 0; i < n; ++i)
+                bad += dist2(world, i, seen[i]) != dist2(world, i, brute[i]);
+            std::snprintf(bruteMs, sizeof(bruteMs), "%.1f", tf * 1e3);
+            std::snprintf(speedup, sizeof(speedup), "%.0fx", tf / (tb + tq));
+            std::snprintf(check, sizeof(check), bad ? "FAIL" : "ok");
+        }
+        std::printf("%-9zu %10.2f %10.2f %12.1f %12s %12s %8s\n", n, tb * 1e3, tq * 1e3,
+                    (tb + tq) * 1e9 / double(n), bruteMs, speedup, check);
+    }
+    return 0;
+}
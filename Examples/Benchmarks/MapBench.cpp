@@ -0,0 +1,91 @@
+// std::function vs templated functor kernels for unary_map / binary_map / ForEachRange.
+// Both paths run the same lambdas; the only difference is whether the callable
+// is type-erased, so the gap is the cost of the indirect call per element.
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "Ops_Parallel.h"
+
+namespace
+{
+    template <class Fn>
+    double bestSeconds(int reps, Fn &&fn)
+    {
+        double best = 1e30;
+        for (int r = 0; r < reps; ++r)
+        {
+            auto t0 = std::chrono::steady_clock::now();
+            fn();
+            auto t1 = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+        }
+        return best;
+    }
+
+    void run(ThreadPool *pool, const char *label)
+    {
+        std::printf("\n%s\n", label);
+        std::printf("%-10s %-14s %12s %12s %8s\n", "n", "kernel", "function ns/e", "template ns/e", "speedup");
+
+        const auto leaky = [](float a)
+        { return a > 0.f ? a : 0.01f * a; };
+        const auto sgd = [](float w, float g)
+        { return w - 0.05f * g; };
+        const std::function<float(float)> leakyFn = leaky;
+        const std::function<float(float, float)> sgdFn = sgd;
+
+        for (int64_t n = 1 << 10; n <= (int64_t(1) << 24); n <<= 2)
+        {
+            std::vector<float> a(n), b(n), out(n);
+            for (int64_t i = 0; i < n; ++i)
+            {
+                a[i] = std::sin(float(i));
+                b[i] = std::cos(float(i));
+            }
+            const int reps = n <= (1 << 16) ? 200 : (n <= (1 << 20) ? 20 : 5);
+
+            double tf = bestSeconds(reps, [&]
+                                    { unary_map(pool, out.data(), a.data(), n, leakyFn); });
+            double tt = bestSeconds(reps, [&]
+                                    { unary_map(pool, out.data(), a.data(), n, leaky); });
+            std::printf("%-10lld %-14s %12.3f %12.3f %7.1fx\n", (long long)n, "unary_map",
+                        tf * 1e9 / n, tt * 1e9 / n, tf / tt);
+
+            tf = bestSeconds(reps, [&]
+                             { binary_map(pool, out.data(), a.data(), b.data(), n, sgdFn); });
+            tt = bestSeconds(reps, [&]
+                             { binary_map(pool, out.data(), a.data(), b.data(), n, sgd); });
+            std::printf("%-10lld %-14s %12.3f %12.3f %7.1fx\n", (long long)n, "binary_map",
+                        tf * 1e9 / n, tt * 1e9 / n, tf / tt);
+
+            // Range body through ForEachRange: erasure costs one call per chunk, so this stays ~1x.
+            const std::function<void(int64_t, int64_t)> rangeFn = [&](int64_t s, int64_t e)
+            {
+                for (int64_t i = s; i < e; ++i)
+                    out[i] = a[i] * b[i];
+            };
+            tf = bestSeconds(reps, [&]
+                             { ForEachRange(pool, 0, n, rangeFn); });
+            tt = bestSeconds(reps, [&]
+                             { ForEachRange(pool, 0, n, [&](int64_t s, int64_t e)
+                                            {
+                for (int64_t i = s; i < e; ++i)
+                    out[i] = a[i] * b[i]; }); });
+            std::printf("%-10lld %-14s %12.3f %12.3f %7.1fx\n", (long long)n, "ForEachRange",
+                        tf * 1e9 / n, tt * 1e9 / n, tf / tt);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const size_t threads = argc > 1 ? size_t(std::atoi(argv[1])) : std::max(1u, std::thread::hardware_concurrency());
+    run(nullptr, "serial (pool = nullptr)");
+    ThreadPool pool(threads);
+    char label[64];
+    std::snprintf(label, sizeof(label), "ThreadPool(%zu)", threads);
+    run(&pool, label);
+    return 0;
+}
@@ -0,0 +1,170 @@
+#include "Brains.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "./ParallelFor.h"
+
+namespace sim
+{
+
+    namespace
+    {
+        // Rows of one genome handed to a thread at a time.
+        constexpr uint32_t kBlockRows = 256;
+
+        // Fewer rows than a register tile: packing the weights would cost as much as
+        // the product, so accumulate each output row as a sum of scaled weight rows.
+        void smallGemm(int rows, int N, int K, const float *A, const float *W, float *C, const gemm::Epilogue &ep)
+        {
+            const simd::Kernels &k = simd::kernels();
+            for (int r = 0; r < rows; ++r)
+            {
+                float *c = C + int64_t(r) * N;
+                std::fill(c, c + N, 0.f);
+                for (int j = 0; j < K; ++j)
+                    k.axpy(c, A[int64_t(r) * K + j], W + int64_t(j) * N, N);
+                ep.apply(c, ep.bias, N);
+            }
+        }
+    }
+
+    BatchedBrains::BatchedBrains(evo::Topology topology)
+        : topology_(std::move(topology))
+    {
+        if (topology_.layers() < 1 || topology_.widths.front() != kSensorCount ||
+            topology_.widths.back() != kActionCount)
+            throw std::invalid_argument("brain topology must map kSensorCount inputs to kActionCount outputs");
+    }
+
+    void BatchedBrains::sense(ThreadPool &pool, const World &world, const int64_t *nearest, const uint32_t *rows,
+                              size_t n, float *sensors)
+    {
+        const WorldConfig &c = world.config();
+        ParallelFor(pool, 0, int64_t(n), [&](int64_t s, int64_t e)
+                    {
+            for (int64_t r = s; r < e; ++r)
+            {
+                const size_t i = rows ? rows[r] : size_t(r);
+                float *out = sensors + r * kSensorCount;
+                out[SenseHealth] = world.health[i] / c.maxHealth;
+                out[SenseFood] = world.food[i] / c.maxFood;
+
+                const int64_t j = nearest[i];
+                if (j < 0)
+                {
+                    std::fill(out + SenseSeen, out + kSensorCount, 0.f);
+                    continue;
+                }
+                const float dx = world.x[size_t(j)] - world.x[i], dy = world.y[size_t(j)] - world.y[i];
+                const int f = world.facing[i];
+                const float fx = float(int(f == East) - int(f == West));
+                const float fy = float(int(f == North) - int(f == South));
+                const float inv = world.sight[i] > 0.f ? 1.f / world.sight[i] : 0.f;
+                out[SenseSeen] = 1.f;
+                out[SenseAhead] = (dx * fx + dy * fy) * inv;
+                out[SenseRight] = (dx * fy - dy * fx) * inv;
+                out[SenseNeighbourHealth] = world.health[size_t(j)] / c.maxHealth;
+                out[SenseNeighbourLooks] = world.looks[size_t(j)];
+                const float both = world.attack[i] + world.attack[size_t(j)];
+                out[SenseThreat] = both > 0.f ? world.attack[size_t(j)] / both : 0.5f;
+            } }, ParallelCost::bytes(64.0));
+    }
+
+    void BatchedBrains::act(ThreadPool &pool, World &world, const uint32_t *rows, size_t n, const float *actions)
+    {
+        ParallelFor(pool, 0, int64_t(n), [&](int64_t s, int64_t e)
+                    {
+            for (int64_t r = s; r < e; ++r)
+            {
+                const size_t i = rows ? rows[r] : size_t(r);
+                const float *a = actions + r * kActionCount;
+                world.throttle[i] = std::min(std::max(a[ActThrottle], 0.f), 1.f);
+                const float steer = a[ActSteer];
+                world.turn[i] = int8_t(steer < 1.f / 3.f ? -1 : (steer > 2.f / 3.f ? 1 : 0));
+            } }, ParallelCost::bytes(16.0));
+    }
+
+    void BatchedBrains::run(World &world, const int64_t *nearest, NeuralNetwork::Sequential &shared)
+    {
+        ThreadPool &pool = world.pool();
+        const size_t n = world.size();
+        if (n == 0)
+            return;
+
+        const int shape[2] = {int(n), kSensorCount};
+        NeuralNetwork::Tensor batch = NeuralNetwork::Tensor::uninitialized(2, &pool, shape);
+        sense(pool, world, nearest, nullptr, n, batch.data);
+        const NeuralNetwork::Tensor actions = shared.forward(batch).contiguous();
+        if (actions.dims != 2 || actions.shape[0] != int(n) || actions.shape[1] != kActionCount)
+            throw std::invalid_argument("shared brain must output [blobs, kActionCount]");
+        act(pool, world, nullptr, n, actions.data);
+    }
+
+    void BatchedBrains::groupRows(size_t n, size_t numGenomes, const uint32_t *group)
+    {
+        starts_.assign(numGenomes + 1, 0);
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (group[i] >= numGenomes)
+                throw std::out_of_range("blob's genome index is out of range");
+            ++starts_[group[i] + 1];
+        }
+        for (size_t g = 0; g < numGenomes; ++g)
+            starts_[g + 1] += starts_[g];
+
+        order_.resize(n);
+        blocks_.clear();
+        for (size_t g = 0; g < numGenomes; ++g)
+            for (uint32_t b = starts_[g]; b < starts_[g + 1]; b += kBlockRows)
+                blocks_.push_back({uint32_t(g), b, std::min(b + kBlockRows, starts_[g + 1])});
+        for (size_t i = 0; i < n; ++i)
+            order_[starts_[group[i]]++] = uint32_t(i);
+    }
+
+    void BatchedBrains::run(World &world, const int64_t *nearest, const float *genomes, size_t numGenomes,
+                            const uint32_t *group)
+    {
+        ThreadPool &pool = world.pool();
+        const size_t n = world.size();
+        if (n == 0)
+            return;
+        groupRows(n, numGenomes, group);
+
+        const std::vector<int> &widths = topology_.widths;
+        const size_t widest = size_t(*std::max_element(widths.begin(), widths.end()));
+        in_.resize(n * widest);
+        out_.resize(n * widest);
+        sense(pool, world, nearest, order_.data(), n, in_.data());
+
+        const size_t length = topology_.genomeLength();
+        for (int l = 0; l < topology_.layers(); ++l)
+        {
+            const int K = widths[l], N = widths[l + 1];
+            gemm::Epilogue ep;
+            ep.act = l + 1 == topology_.layers() ? topology_.output : topology_.hidden;
+            ep.alpha = topology_.leakySlope;
+
+            ParallelFor(pool, 0, int64_t(blocks_.size()), [&](int64_t s, int64_t e)
+                        {
+                for (int64_t b = s; b < e; ++b)
+                {
+                    const Block &blk = blocks_[size_t(b)];
+                    const float *genome = genomes + size_t(blk.genome) * length;
+                    const float *W = genome + topology_.weightOffset(l);
+                    gemm::Epilogue blockEp = ep;
+                    blockEp.bias = genome + topology_.biasOffset(l);
+                    const int rows = int(blk.end - blk.begin);
+                    const float *A = in_.data() + size_t(blk.begin) * K;
+                    float *C = out_.data() + size_t(blk.begin) * N;
+                    if (rows < gemm::MR)
+                        smallGemm(rows, N, K, A, W, C, blockEp);
+                    else
+                        gemm::sgemm(nullptr, rows, N, K, A, K, 1, W, N, 1, C, N, 1, blockEp);
+                } }, ParallelCost::flops(2.0 * K * N * double(n) / double(blocks_.size())));
+            in_.swap(out_);
+        }
+        act(pool, world, order_.data(), n, in_.data());
+    }
+
+} // namespace sim
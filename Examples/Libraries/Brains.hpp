@@ -0,0 +1,88 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "./Evolution.hpp"
+#include "./NeuralNetwork.hpp"
+#include "./World.hpp"
+
+namespace sim
+{
+
+    // What a blob's brain reads each tick, one row per blob, all roughly in [-1, 1].
+    // The neighbour is the closest other blob within sight (all zeros if none), and
+    // its offset is in the blob's own frame: ahead and to the right are positive.
+    enum Sensor
+    {
+        SenseHealth,          // health / maxHealth
+        SenseFood,            // food / maxFood
+        SenseSeen,            // 1 if a neighbour is in sight
+        SenseAhead,           // neighbour offset along facing / sight
+        SenseRight,           // neighbour offset to the right / sight
+        SenseNeighbourHealth, // neighbour health / maxHealth
+        SenseNeighbourLooks,  // neighbour looks
+        SenseThreat,          // neighbour attack / (own attack + neighbour attack)
+        kSensorCount
+    };
+
+    // What it writes: throttle directly, and the turn as left below 1/3, right above 2/3.
+    enum Action
+    {
+        ActThrottle,
+        ActSteer,
+        kActionCount
+    };
+
+    // Runs every blob's brain for one tick as a few large matrix products instead of a
+    // forward call per blob: sense all blobs into one [blobs, kSensorCount] batch, run
+    // the batch through the Dense layers, write turn and throttle back to the world.
+    //
+    // The topology's widths must start at kSensorCount and end at kActionCount.
+    class BatchedBrains
+    {
+    public:
+        explicit BatchedBrains(evo::Topology topology);
+
+        const evo::Topology &topology() const { return topology_; }
+
+        // nearest[i] is the blob blob i sees (or -1), as SpatialGrid::nearestAll finds
+        // it from the sight column; the same answer can then drive attacks and mating.
+
+        // All blobs share one network: one GEMM per layer over the whole population.
+        void run(World &world, const int64_t *nearest, NeuralNetwork::Sequential &shared);
+
+        // Blob i runs genome group[i] of genomes, a [numGenomes, genomeLength] buffer
+        // laid out as evo::Population stores it. Blobs are grouped by genome with a
+        // counting sort, and each layer is one GEMM per genome over that genome's rows,
+        // read straight from its weights in the genome buffer. Large groups are split
+        // into row blocks, so one genome for everyone and one genome per blob both
+        // spread over the pool.
+        void run(World &world, const int64_t *nearest, const float *genomes, size_t numGenomes,
+                 const uint32_t *group);
+
+        // Fills sensors ([size, kSensorCount]) for blobs rows[0..n) in that order
+        // (all blobs in index order when rows is null).
+        static void sense(ThreadPool &pool, const World &world, const int64_t *nearest, const uint32_t *rows,
+                          size_t n, float *sensors);
+        // Applies actions ([n, kActionCount]) row r to blob rows[r] (r when rows is null).
+        static void act(ThreadPool &pool, World &world, const uint32_t *rows, size_t n, const float *actions);
+
+    private:
+        // rows [begin, end) of the grouped batch, all running `genome`.
+        struct Block
+        {
+            uint32_t genome;
+            uint32_t begin;
+            uint32_t end;
+        };
+
+        void groupRows(size_t n, size_t numGenomes, const uint32_t *group);
+
+        evo::Topology topology_;
+        std::vector<uint32_t> order_;  // blob in each grouped row
+        std::vector<uint32_t> starts_; // counting-sort offsets per genome
+        std::vector<Block> blocks_;
+        std::vector<float> in_, out_;  // ping-pong activations, [n, widest layer]
+    };
+
+} // namespace sim
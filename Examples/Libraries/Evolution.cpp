@@ -0,0 +1,241 @@
+#include "Evolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+namespace evo
+{
+
+    namespace
+    {
+        uint64_t splitmix64(uint64_t &state)
+        {
+            uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+
+        double uniform01(uint64_t &state)
+        {
+            return double(splitmix64(state) >> 11) * 0x1.0p-53;
+        }
+
+        NeuralNetwork::Layer *activationLayer(gemm::Epilogue::Activation act, float leakySlope)
+        {
+            switch (act)
+            {
+            case gemm::Epilogue::ReLU:
+                return new NeuralNetwork::ReLu();
+            case gemm::Epilogue::LeakyReLU:
+                return new NeuralNetwork::LeakyReLU(leakySlope);
+            case gemm::Epilogue::Sigmoid:
+                return new NeuralNetwork::Sigmoid();
+            default:
+                return nullptr;
+            }
+        }
+
+        std::vector<NeuralNetwork::Dense *> denseLayers(const NeuralNetwork::Sequential &net)
+        {
+            std::vector<NeuralNetwork::Dense *> out;
+            for (NeuralNetwork::Layer *layer : net.layers)
+            {
+                if (auto *dense = dynamic_cast<NeuralNetwork::Dense *>(layer))
+                    out.push_back(dense);
+                else if (auto *fused = dynamic_cast<NeuralNetwork::DenseActivation *>(layer))
+                    out.push_back(fused->dense);
+            }
+            return out;
+        }
+    }
+
+    // ---------- Topology ----------
+
+    size_t Topology::weightOffset(int layer) const
+    {
+        size_t at = 0;
+        for (int l = 0; l < layer; ++l)
+            at += size_t(widths[l] + 1) * widths[l + 1];
+        return at;
+    }
+
+    size_t Topology::genomeLength() const
+    {
+        return layers() > 0 ? weightOffset(layers()) : 0;
+    }
+
+    std::unique_ptr<NeuralNetwork::Sequential> Topology::build(ThreadPool &pool) const
+    {
+        if (layers() < 1)
+            throw std::invalid_argument("Topology needs at least an input and an output width");
+        auto net = std::make_unique<NeuralNetwork::Sequential>(pool);
+        for (int l = 0; l < layers(); ++l)
+        {
+            net->add(new NeuralNetwork::Dense(widths[l], widths[l + 1]));
+            if (NeuralNetwork::Layer *act = activationLayer(l + 1 == layers() ? output : hidden, leakySlope))
+                net->add(act);
+        }
+        return net;
+    }
+
+    void Topology::load(const float *genome, NeuralNetwork::Sequential &net) const
+    {
+        const std::vector<NeuralNetwork::Dense *> dense = denseLayers(net);
+        if (int(dense.size()) != layers())
+            throw std::invalid_argument("genome does not match the network's layers");
+        for (int l = 0; l < layers(); ++l)
+        {
+            NeuralNetwork::Dense &d = *dense[l];
+            if (d.weights.shape[0] != widths[l] || d.weights.shape[1] != widths[l + 1])
+                throw std::invalid_argument("genome does not match the network's layer widths");
+            std::memcpy(d.weights.data, genome + weightOffset(l), sizeof(float) * d.weights.length());
+            std::memcpy(d.bias.data, genome + biasOffset(l), sizeof(float) * d.bias.length());
+        }
+    }
+
+    void Topology::store(const NeuralNetwork::Sequential &net, float *genome) const
+    {
+        const std::vector<NeuralNetwork::Dense *> dense = denseLayers(net);
+        if (int(dense.size()) != layers())
+            throw std::invalid_argument("genome does not match the network's layers");
+        for (int l = 0; l < layers(); ++l)
+        {
+            const NeuralNetwork::Dense &d = *dense[l];
+            if (d.weights.shape[0] != widths[l] || d.weights.shape[1] != widths[l + 1])
+                throw std::invalid_argument("genome does not match the network's layer widths");
+            std::memcpy(genome + weightOffset(l), d.weights.data, sizeof(float) * d.weights.length());
+            std::memcpy(genome + biasOffset(l), d.bias.data, sizeof(float) * d.bias.length());
+        }
+    }
+
+    // ---------- Population ----------
+
+    // A brain for the duration of one evaluation chunk, reused across chunks and generations.
+    struct Population::BrainLease
+    {
+        Population &pop;
+        std::unique_ptr<NeuralNetwork::Sequential> brain;
+
+        explicit BrainLease(Population &p) : pop(p)
+        {
+            {
+                std::lock_guard<std::mutex> lock(pop.brainsMu_);
+                if (!pop.idleBrains_.empty())
+                {
+                    brain = std::move(pop.idleBrains_.back());
+                    pop.idleBrains_.pop_back();
+                }
+            }
+            if (!brain)
+                brain = pop.topology_.build(pop.inline_);
+        }
+
+        ~BrainLease()
+        {
+            std::lock_guard<std::mutex> lock(pop.brainsMu_);
+            pop.idleBrains_.push_back(std::move(brain));
+        }
+    };
+
+    Population::Population(ThreadPool &pool, Topology topology, size_t size, EvolutionConfig config,
+                           uint64_t seed)
+        : pool_(pool), topology_(std::move(topology)), config_(config), size_(size),
+          length_(topology_.genomeLength()), seed_(seed),
+          genomes_(size * length_, 0.f), next_(size * length_), fitness_(size, 0.f)
+    {
+        if (size_ == 0 || length_ == 0)
+            throw std::invalid_argument("Population needs at least one individual and one weight");
+
+        const simd::Kernels &k = simd::kernels();
+        ParallelFor(pool_, 0, int64_t(size_), [&](int64_t s, int64_t e)
+                    {
+            for (int64_t i = s; i < e; ++i)
+            {
+                uint64_t rng = seed_ ^ (uint64_t(i) * 0xD1B54A32D192ED03ull);
+                for (int l = 0; l < topology_.layers(); ++l)
+                {
+                    const float sigma = 1.f / std::sqrt(float(topology_.widths[l]));
+                    k.mutate(genome(size_t(i)) + topology_.weightOffset(l), 1.f, sigma, uint32_t(splitmix64(rng)),
+                             int64_t(topology_.widths[l]) * topology_.widths[l + 1]);
+                }
+            } }, ParallelCost::bytes(8.0 * double(length_)));
+    }
+
+    size_t Population::best() const
+    {
+        return size_t(std::max_element(fitness_.begin(), fitness_.end()) - fitness_.begin());
+    }
+
+    std::vector<size_t> Population::ranking() const
+    {
+        std::vector<size_t> order(size_);
+        std::iota(order.begin(), order.end(), size_t(0));
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+                         { return fitness_[a] > fitness_[b]; });
+        return order;
+    }
+
+    void Population::evaluate(const Fitness &fitness)
+    {
+        ParallelFor(pool_, 0, int64_t(size_), [&](int64_t s, int64_t e)
+                    {
+            BrainLease lease(*this);
+            for (int64_t i = s; i < e; ++i)
+            {
+                topology_.load(genome(size_t(i)), *lease.brain);
+                const float f = fitness(*lease.brain, size_t(i));
+                // NaN would break the ordering selection relies on.
+                fitness_[size_t(i)] = std::isnan(f) ? -std::numeric_limits<float>::infinity() : f;
+            } }, /*desiredTasks*/ -1, /*minChunk*/ 1);
+    }
+
+    size_t Population::tournament(uint64_t &rng) const
+    {
+        size_t best = size_t(splitmix64(rng) % size_);
+        for (int t = 1; t < config_.tournament; ++t)
+        {
+            const size_t other = size_t(splitmix64(rng) % size_);
+            if (fitness_[other] > fitness_[best])
+                best = other;
+        }
+        return best;
+    }
+
+    void Population::nextGeneration()
+    {
+        const size_t elites = std::min(config_.elites, size_);
+        if (elites > 0)
+        {
+            const std::vector<size_t> order = ranking();
+            for (size_t c = 0; c < elites; ++c)
+                std::memcpy(next_.data() + c * length_, genome(order[c]), sizeof(float) * length_);
+        }
+
+        const simd::Kernels &k = simd::kernels();
+        ParallelFor(pool_, int64_t(elites), int64_t(size_), [&](int64_t s, int64_t e)
+                    {
+            for (int64_t c = s; c < e; ++c)
+            {
+                // Each child's draws depend only on (seed, generation, child), not on threading.
+                uint64_t rng = seed_ + generation_ * 0xD1B54A32D192ED03ull + uint64_t(c) * 0x9E3779B97F4A7C15ull;
+                splitmix64(rng);
+                const float *a = genome(tournament(rng));
+                const float *b = genome(tournament(rng));
+                float *child = next_.data() + size_t(c) * length_;
+                if (uniform01(rng) < config_.crossoverRate)
+                    k.crossover(child, a, b, uint32_t(splitmix64(rng)), int64_t(length_));
+                else
+                    std::memcpy(child, a, sizeof(float) * length_);
+                k.mutate(child, config_.mutationRate, config_.mutationSigma, uint32_t(splitmix64(rng)), int64_t(length_));
+            } }, ParallelCost::bytes(12.0 * double(length_)));
+
+        genomes_.swap(next_);
+        ++generation_;
+    }
+
+} // namespace evo
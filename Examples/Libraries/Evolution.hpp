@@ -0,0 +1,111 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "./NeuralNetwork.hpp"
+
+// Neuroevolution: a population of fully connected networks whose weights are
+// evolved instead of trained. Every individual's parameters are one flat genome, and
+// the whole population is a single [size, genomeLength] buffer, so breeding a
+// generation is a pass of the SIMD crossover/mutate kernels over contiguous rows.
+namespace evo
+{
+
+    // widths[0] inputs -> widths[1] -> ... -> widths.back() outputs. Every Dense layer
+    // but the last is followed by `hidden`, the last by `output` (None for linear).
+    struct Topology
+    {
+        std::vector<int> widths;
+        gemm::Epilogue::Activation hidden = gemm::Epilogue::LeakyReLU;
+        gemm::Epilogue::Activation output = gemm::Epilogue::Sigmoid;
+        float leakySlope = 0.01f;
+
+        int layers() const { return int(widths.size()) - 1; }
+
+        // A genome holds, for each layer in order, its [in, out] weights row-major and
+        // then its out biases: Dense's own layout, so loading is one copy per tensor.
+        size_t genomeLength() const;
+        size_t weightOffset(int layer) const;
+        size_t biasOffset(int layer) const { return weightOffset(layer) + size_t(widths[layer]) * widths[layer + 1]; }
+
+        std::unique_ptr<NeuralNetwork::Sequential> build(ThreadPool &pool) const;
+
+        // Copy between a genome and a network built from this topology (or any
+        // Sequential whose Dense layers have these shapes). Throw on a mismatch.
+        void load(const float *genome, NeuralNetwork::Sequential &net) const;
+        void store(const NeuralNetwork::Sequential &net, float *genome) const;
+    };
+
+    struct EvolutionConfig
+    {
+        size_t elites = 2;          // fittest individuals copied unchanged into the next generation
+        int tournament = 3;         // a parent is the fittest of this many random picks
+        float crossoverRate = 0.7f; // otherwise a child is a mutated copy of its first parent
+        float mutationRate = 0.05f; // chance that each weight is perturbed
+        float mutationSigma = 0.1f; // standard deviation of a perturbation
+    };
+
+    class Population
+    {
+    public:
+        // Scores one individual; brain already holds its weights. Called concurrently
+        // from pool threads, each with its own brain.
+        using Fitness = std::function<float(NeuralNetwork::Sequential &brain, size_t individual)>;
+
+        // Weights start as N(0, 1/fan_in) noise, biases at zero.
+        Population(ThreadPool &pool, Topology topology, size_t size, EvolutionConfig config = {},
+                   uint64_t seed = 1);
+
+        size_t size() const { return size_; }
+        size_t genomeLength() const { return length_; }
+        const Topology &topology() const { return topology_; }
+        EvolutionConfig &config() { return config_; }
+        uint64_t generation() const { return generation_; }
+
+        float *genome(size_t i) { return genomes_.data() + i * length_; }
+        const float *genome(size_t i) const { return genomes_.data() + i * length_; }
+
+        // As of the last evaluate() (or setFitness); higher is fitter.
+        const std::vector<float> &fitness() const { return fitness_; }
+        void setFitness(size_t i, float f) { fitness_[i] = f; }
+        size_t best() const;
+        // Indices, fittest first.
+        std::vector<size_t> ranking() const;
+
+        // Scores every individual, spread over the pool. The brains run their layers
+        // inline on the evaluating thread: with thousands of small networks the
+        // parallelism is across individuals, not inside one forward pass.
+        void evaluate(const Fitness &fitness);
+
+        // Replaces the population with its offspring: the elites survive as they are,
+        // every other child is bred from two tournament-selected parents by uniform
+        // crossover and mutation. Children are independent, so they are bred in parallel
+        // into a second buffer that then becomes the population.
+        void nextGeneration();
+
+    private:
+        struct BrainLease;
+
+        size_t tournament(uint64_t &rng) const;
+
+        ThreadPool &pool_;
+        Topology topology_;
+        EvolutionConfig config_;
+        size_t size_;
+        size_t length_;
+        uint64_t seed_;
+        uint64_t generation_ = 0;
+
+        std::vector<float> genomes_; // [size, length]
+        std::vector<float> next_;    // offspring being bred
+        std::vector<float> fitness_;
+
+        ThreadPool inline_{0}; // no workers: brain layers run on the calling thread
+        std::mutex brainsMu_;
+        std::vector<std::unique_ptr<NeuralNetwork::Sequential>> idleBrains_;
+    };
+
+} // namespace evo
@@ -0,0 +1,190 @@
+#include "ModelPartitioner.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+    // Rough sustained SGEMM rate per hardware thread when a node has not been measured.
+    constexpr double kDefaultGflopsPerThread = 8.0;
+
+    double node_flops_per_sec(const NodeCompute &n)
+    {
+        const double gflops = n.gflops > 0.0 ? n.gflops : kDefaultGflopsPerThread * std::max(1u, n.threads);
+        return gflops * 1e9;
+    }
+
+    // Roofline: a stage streams at least its resident bytes once per step. A stage that
+    // ends before the last layer also ships its output forward and the gradient back.
+    double stage_seconds(const NodeCompute &n, double flops, std::uint64_t bytes,
+                         std::uint64_t out_bytes, bool ends_model, double link_bytes_per_sec)
+    {
+        double t = flops / node_flops_per_sec(n);
+        if (n.mem_gbs > 0.0)
+            t = std::max(t, double(bytes) / (n.mem_gbs * 1e9));
+        if (!ends_model && link_bytes_per_sec > 0.0)
+            t += 2.0 * double(out_bytes) / link_bytes_per_sec;
+        return t;
+    }
+
+    std::uint64_t usable_bytes(const NodeCompute &n, std::uint64_t safety_mem_per_thread_mb)
+    {
+        const std::uint64_t reserve = std::uint64_t(std::max(1u, n.threads)) * safety_mem_per_thread_mb;
+        return n.ram_mb > reserve ? (n.ram_mb - reserve) * 1024ull * 1024ull : 0;
+    }
+}
+
+std::vector<NodeAssignment>
+ModelPartitioner::partition_by_capacity(const std::vector<NodeCompute> &nodes,
+                                        const std::vector<LayerCost> &layers,
+                                        std::uint64_t safety_mem_per_thread_mb,
+                                        double link_bytes_per_sec)
+{
+    const int N = int(nodes.size());
+    const int L = int(layers.size());
+    if (N == 0 || L == 0)
+        return {};
+
+    std::vector<double> flops(L + 1, 0.0);
+    std::vector<std::uint64_t> bytes(L + 1, 0);
+    for (int i = 0; i < L; ++i)
+    {
+        flops[i + 1] = flops[i] + layers[i].flops;
+        bytes[i + 1] = bytes[i] + layers[i].bytes;
+    }
+
+    // Time of node j running layers [k, i); infinite if they don't fit in its RAM.
+    const double inf = std::numeric_limits<double>::infinity();
+    auto stage_time = [&](int j, int k, int i)
+    {
+        if (k == i)
+            return 0.0;
+        if (bytes[i] - bytes[k] > usable_bytes(nodes[j], safety_mem_per_thread_mb))
+            return inf;
+        return stage_seconds(nodes[j], flops[i] - flops[k], bytes[i] - bytes[k],
+                             layers[i - 1].out_bytes, i == L, link_bytes_per_sec);
+    };
+
+    // best[j][i]: smallest possible slowest-stage time placing layers [0, i) on nodes [0, j).
+    // Nodes keep their chain order; a node may take no layers.
+    std::vector<std::vector<double>> best(N + 1, std::vector<double>(L + 1, inf));
+    std::vector<std::vector<int>> cut(N + 1, std::vector<int>(L + 1, 0));
+    best[0][0] = 0.0;
+    for (int j = 1; j <= N; ++j)
+    {
+        for (int i = 0; i <= L; ++i)
+        {
+            for (int k = 0; k <= i; ++k)
+            {
+                if (best[j - 1][k] == inf)
+                    continue;
+                const double t = std::max(best[j - 1][k], stage_time(j - 1, k, i));
+                if (t < best[j][i])
+                {
+                    best[j][i] = t;
+                    cut[j][i] = k;
+                }
+            }
+        }
+    }
+    if (best[N][L] == inf)
+        throw std::runtime_error("ModelPartitioner: model does not fit in the nodes' memory");
+
+    std::vector<std::pair<int, int>> ranges(N);
+    for (int j = N, i = L; j > 0; --j)
+    {
+        const int k = cut[j][i];
+        ranges[j - 1] = {k, i};
+        i = k;
+    }
+
+    std::vector<NodeAssignment> out;
+    for (int j = 0; j < N; ++j)
+    {
+        const auto [k, i] = ranges[j];
+        if (k == i)
+            continue;
+        NodeAssignment a;
+        a.node_index = j;
+        for (int l = k; l < i; ++l)
+            a.layers.push_back(l);
+        a.array_bytes = bytes[i] - bytes[k];
+        a.est_seconds = stage_time(j, k, i);
+        out.push_back(std::move(a));
+    }
+    for (size_t s = 0; s < out.size(); ++s)
+    {
+        out[s].is_first = s == 0;
+        out[s].is_last = s + 1 == out.size();
+        if (!out[s].is_last)
+            out[s].next_addr = nodes[out[s + 1].node_index].addr;
+    }
+    return out;
+}
+
+std::vector<NodeAssignment>
+ModelPartitioner::partition_by_capacity(const std::vector<NodeCompute> &nodes,
+                                        int total_layers,
+                                        std::uint64_t bytes_per_layer,
+                                        std::uint64_t safety_mem_per_thread_mb)
+{
+    LayerCost uniform;
+    uniform.flops = double(bytes_per_layer);
+    uniform.bytes = bytes_per_layer;
+    return partition_by_capacity(nodes, std::vector<LayerCost>(std::max(0, total_layers), uniform),
+                                 safety_mem_per_thread_mb, 0.0);
+}
+
+double ModelPartitioner::estimate_seconds(const NodeCompute &node, const std::vector<LayerCost> &layers,
+                                          int begin, int end, double link_bytes_per_sec)
+{
+    if (begin >= end)
+        return 0.0;
+    double flops = 0.0;
+    std::uint64_t bytes = 0;
+    for (int l = begin; l < end; ++l)
+    {
+        flops += layers[l].flops;
+        bytes += layers[l].bytes;
+    }
+    return stage_seconds(node, flops, bytes, layers[end - 1].out_bytes, end == int(layers.size()),
+                         link_bytes_per_sec);
+}
+
+std::vector<LayerCost> ModelPartitioner::dense_layer_costs(const std::vector<int> &widths, int batch)
+{
+    std::vector<LayerCost> costs;
+    for (size_t l = 0; l + 1 < widths.size(); ++l)
+    {
+        const double in = widths[l], out = widths[l + 1], b = batch;
+        LayerCost c;
+        c.flops = 6.0 * b * in * out; // forward GEMM, plus dX and dW GEMMs
+        // weights + bias, their accumulated gradients, the saved input and the output
+        c.bytes = std::uint64_t(4.0 * (2.0 * (in * out + out) + b * (in + out)));
+        c.out_bytes = std::uint64_t(4.0 * b * out);
+        costs.push_back(c);
+    }
+    return costs;
+}
+
+nlohmann::json ModelPartitioner::to_config_json(const NodeAssignment &a, int node_index)
+{
+    nlohmann::json j;
+    j["node_index"] = node_index;
+    j["is_first"] = a.is_first;
+    j["is_last"] = a.is_last;
+    j["layers"] = a.layers;
+    j["array_size"] = a.array_bytes;
+    j["next_node_addr"] = a.next_addr;
+    return j;
+}
+
+std::vector<std::string> ModelPartitioner::chain_addrs(const std::vector<NodeCompute> &nodes)
+{
+    std::vector<std::string> addrs;
+    addrs.reserve(nodes.size());
+    for (const auto &n : nodes)
+        addrs.push_back(n.addr);
+    return addrs;
+}
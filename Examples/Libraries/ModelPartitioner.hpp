@@ -10,6 +10,16 @@ struct NodeCompute
     std::string addr;     // "ip:port"
     std::uint64_t ram_mb; // free RAM
     unsigned threads;     // hardware threads
+    double gflops = 0.0;  // measured throughput; 0 = estimate from threads
+    double mem_gbs = 0.0; // measured memory bandwidth; 0 = compute-bound estimate only
+};
+
+// Cost of one layer for one training step (forward + backward).
+struct LayerCost
+{
+    double flops = 0.0;
+    std::uint64_t bytes = 0;     // memory the owning node must hold (params, grads, saved activations)
+    std::uint64_t out_bytes = 0; // activation sent downstream (and gradient sent back) if a stage ends here
 };
 
 struct NodeAssignment
@@ -20,19 +30,39 @@ struct NodeAssignment
     std::string next_addr; // empty if last
     bool is_first = false;
     bool is_last = false;
+    double est_seconds = 0.0; // predicted step time of this stage under the cost model
 };
 
 class ModelPartitioner
 {
 public:
-    // total_layers: e.g. 120
+    // Splits the layers into contiguous stages along the node chain so that the slowest
+    // stage is as fast as possible, subject to each node's RAM. Stage time is
+    // max(flops / node speed, bytes / node bandwidth) plus the boundary transfer over
+    // the link. Nodes that would get no layers are left out of the chain.
+    // Throws std::runtime_error if the model cannot fit.
     // safety_mem_per_thread_mb: reserve headroom per thread so we don't overcommit
     static std::vector<NodeAssignment>
+    partition_by_capacity(const std::vector<NodeCompute> &nodes,
+                          const std::vector<LayerCost> &layers,
+                          std::uint64_t safety_mem_per_thread_mb = 128,
+                          double link_bytes_per_sec = 117e6);
+
+    // Uniform layers when nothing better is known: cost is proportional to bytes.
+    // total_layers: e.g. 120
+    static std::vector<NodeAssignment>
     partition_by_capacity(const std::vector<NodeCompute> &nodes,
                           int total_layers,
                           std::uint64_t bytes_per_layer,
                           std::uint64_t safety_mem_per_thread_mb = 128);
 
+    // Step time of node running layers [begin, end) under the same model the split uses.
+    static double estimate_seconds(const NodeCompute &node, const std::vector<LayerCost> &layers,
+                                   int begin, int end, double link_bytes_per_sec = 117e6);
+
+    // Costs of a fully-connected stack widths[0] -> widths[1] -> ... trained at this batch size.
+    static std::vector<LayerCost> dense_layer_costs(const std::vector<int> &widths, int batch);
+
     // Serialize one node's assignment to a JSON config to send over the wire
     static nlohmann::json to_config_json(const NodeAssignment &a, int node_index);
 
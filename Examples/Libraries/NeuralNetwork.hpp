@@ -1,38 +1,550 @@
 #ifndef NEURALNETWORK_HPP
 #define NEURALNETWORK_HPP
 
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <stdexcept>
+#include <optional>
 #include <vector>
+#include <cmath>
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <random>
+#include <new>
+
+#include "./ThreadPool.hpp"
+#include "./ParallelFor.h"
+#include "./Ops_Parallel.h"
+#include "./TensorArena.hpp"
 
 namespace NeuralNetwork
 {
     struct Tensor
     {
+        // Tensors up to this rank keep shape/strides inline; larger ranks spill to the arena.
+        static constexpr int kInlineDims = 6;
+
         int dims;
         int *shape;
         int *strides;
         float *data;
 
-        Tensor();
-        Tensor(int dims_, const int *shape_);
-        Tensor(const Tensor &original);
-        Tensor &operator=(const Tensor &other);
-        Tensor(Tensor &&other) noexcept;
-        Tensor &operator=(Tensor &&other) noexcept;
-        ~Tensor();
-
-        float operator()(const int *coordinates) const;
-        float &operator()(const int *coordinates);
-        void set(const int *coordinates, float value);
-
-        Tensor operator*(const Tensor &other);
-        Tensor dot(const Tensor &other) const;
-        Tensor operator%(const Tensor &other);
-        Tensor operator+(const Tensor &other) const;
-        Tensor operator-(const Tensor &other) const;
-
-        int length() const;
-        bool equalsSize(const Tensor &other) const;
-        std::size_t toLinearIndex(const int *coordinates) const;
+        ThreadPool *pool = nullptr;
+
+        Tensor()
+            : dims(0), shape(nullptr), strides(nullptr), data(nullptr), pool(nullptr), storage(nullptr) {}
+
+        Tensor(int dims_, ThreadPool *pool_, const int *shape_)
+            : Tensor(dims_, pool_, shape_, NoFill{})
+        {
+            std::memset(data, 0, length() * sizeof(float));
+        }
+
+        // Leaves the elements unset, for callers that overwrite all of them (e.g. a
+        // network receive straight into the buffer).
+        static Tensor uninitialized(int dims_, ThreadPool *pool_, const int *shape_)
+        {
+            return Tensor(dims_, pool_, shape_, NoFill{});
+        }
+
+        Tensor(int dims_, ThreadPool *pool_, std::initializer_list<int> shape_)
+            : pool(pool_)
+        {
+            if ((int)shape_.size() != dims_)
+                throw std::invalid_argument("dims != shape_.size()");
+            initMeta(dims_);
+
+            int i = 0;
+            for (int s : shape_)
+                shape[i++] = s;
+            initStrides();
+
+            allocData(length());
+            std::memset(data, 0, length() * sizeof(float));
+        }
+
+        // Copies are always deep and contiguous, even when copying a view; use view()
+        // to share storage instead.
+        Tensor(const Tensor &original)
+            : pool(original.pool)
+        {
+            copyMeta(original);
+            copyData(original);
+        }
+
+        Tensor &operator=(const Tensor &other)
+        {
+            if (this == &other)
+                return *this;
+
+            release();
+
+            pool = other.pool;
+            copyMeta(other);
+            copyData(other);
+
+            return *this;
+        }
+
+        Tensor(Tensor &&other) noexcept
+            : pool(other.pool)
+        {
+            stealFrom(other);
+        }
+
+        Tensor &operator=(Tensor &&other) noexcept
+        {
+            if (this == &other)
+                return *this;
+
+            release();
+
+            pool = other.pool;
+            stealFrom(other);
+
+            return *this;
+        }
+
+        ~Tensor()
+        {
+            release();
+        }
+
+        float operator()(const int *coordinates) const
+        {
+            return data[toLinearIndex(coordinates)];
+        }
+
+        float &operator()(const int *coordinates)
+        {
+            return data[toLinearIndex(coordinates)];
+        }
+
+        void set(const int *coordinates, float value)
+        {
+            data[toLinearIndex(coordinates)] = value;
+        }
+
+        Tensor operator*(const Tensor &other) const
+        {
+            equalsSize(other);
+            const Tensor a = contiguous(), b = other.contiguous();
+            Tensor result(dims, pool, shape);
+            int len = length();
+
+            vec_mul(pool, result.data, a.data, b.data, len);
+
+            return result;
+        }
+
+        Tensor dot(const Tensor &other) const
+        {
+            if (dims == 1 && other.dims == 1)
+            {
+                if (length() != other.length())
+                    throw std::out_of_range("Vector length mismatch");
+                const Tensor a = contiguous(), b = other.contiguous();
+                Tensor res(1, pool, {1}); // scalar
+                res.pool = pool ? pool : other.pool;
+                float sum = 0.f;
+
+                if (res.pool && res.pool->size() > 1)
+                {
+                    const int n = length();
+                    const int tasks = std::max<int>(1, int(res.pool->size()) * 4);
+                    std::vector<float> partial(tasks, 0.f);
+                    ForEachRange(res.pool, 0, tasks, [&](int64_t s, int64_t e)
+                                 {
+                for (int t=int(s); t<int(e); ++t) {
+                    int i0 = int((int64_t(n) *  t    ) / tasks);
+                    int i1 = int((int64_t(n) * (t+1)) / tasks);
+                    float acc = 0.f;
+                    for (int i=i0; i<i1; ++i) acc += a.data[i] * b.data[i];
+                    partial[t] += acc;
+                } }, ParallelCost::bytes(8.0 * n / tasks));
+                    for (float v : partial)
+                        sum += v;
+                }
+                else
+                {
+                    for (int i = 0; i < length(); ++i)
+                        sum += a.data[i] * b.data[i];
+                }
+                res.data[0] = sum;
+                return res;
+            }
+            else if (dims == 2 && other.dims == 2)
+            {
+                if (shape[1] != other.shape[0])
+                    throw std::out_of_range("Matrix shapes are incompatible");
+                int thisRows = shape[0], thisCol = shape[1], otherCols = other.shape[1];
+                int newShape[2] = {thisRows, otherCols};
+                Tensor res(2, pool, newShape);
+
+                // Use parallel row kernel
+                matmul_rows(res.pool,
+                            /*A*/ data, thisRows, thisCol, strides[0], strides[1],
+                            /*B*/ other.data, otherCols, other.strides[0], other.strides[1],
+                            /*C*/ res.data, res.strides[0], res.strides[1]);
+                return res;
+            }
+            else
+            {
+                throw std::out_of_range("Dot product not implemented for these dimensions");
+            }
+        }
+
+        // dot product
+        Tensor operator%(const Tensor &other) const
+        {
+            return dot(other);
+        }
+
+        Tensor operator+(const Tensor &other) const
+        {
+            equalsSize(other);
+            const Tensor a = contiguous(), b = other.contiguous();
+            Tensor res(dims, pool, shape);
+            int len = length();
+            vec_add(pool, res.data, a.data, b.data, len);
+
+            return res;
+        }
+
+        Tensor operator-(const Tensor &other) const
+        {
+            equalsSize(other);
+            const Tensor a = contiguous(), b = other.contiguous();
+            Tensor res(dims, pool, shape);
+            int len = length();
+            vec_sub(pool, res.data, a.data, b.data, len);
+
+            return res;
+        }
+
+        uint64_t length() const
+        {
+            uint64_t length = 1;
+            for (int i = 0; i < dims; i++)
+                length *= shape[i];
+            return length;
+        }
+
+        bool equalsSize(const Tensor &other) const
+        {
+            if (dims != other.dims)
+            {
+                throw std::out_of_range("Dimension mismatch");
+            }
+            for (int i = 0; i < dims; i++)
+                if (shape[i] != other.shape[i])
+                {
+                    throw std::out_of_range("Shape mismatch");
+                }
+            return true;
+        }
+
+        std::size_t toLinearIndex(const int *coordinates) const
+        {
+            std::size_t index = 0;
+            for (int i = dims - 1; i >= 0; i--)
+            {
+                if (coordinates[i] >= 0 && coordinates[i] < shape[i])
+                {
+                    index += coordinates[i] * strides[i];
+                }
+                else
+                {
+                    throw std::out_of_range("Coordinate is out of range");
+                }
+            }
+            return index;
+        }
+
+        void setPool(ThreadPool *_pool)
+        {
+            pool = _pool;
+        }
+
+        // Views share this tensor's storage (refcounted) and carry their own shape,
+        // strides and data offset; writes through a view are visible in the source.
+        // All of these are O(1) except reshape of a non-contiguous tensor, which
+        // has to pack first.
+        Tensor view() const
+        {
+            Tensor v;
+            v.pool = pool;
+            v.copyMeta(*this);
+            v.data = data;
+            v.storage = storage;
+            if (storage)
+                storage->refs.fetch_add(1, std::memory_order_relaxed);
+            return v;
+        }
+
+        // Swaps the last two axes.
+        Tensor transpose() const
+        {
+            if (dims < 2)
+                throw std::out_of_range("transpose needs at least 2 dims");
+            Tensor v = view();
+            std::swap(v.shape[dims - 1], v.shape[dims - 2]);
+            std::swap(v.strides[dims - 1], v.strides[dims - 2]);
+            return v;
+        }
+
+        Tensor reshape(int dims_, const int *shape_) const
+        {
+            uint64_t n = 1;
+            for (int i = 0; i < dims_; i++)
+                n *= shape_[i];
+            if (n != length())
+                throw std::invalid_argument("reshape must preserve the element count");
+
+            Tensor v = contiguous();
+            v.releaseMeta();
+            v.initMeta(dims_);
+            for (int i = 0; i < dims_; i++)
+                v.shape[i] = shape_[i];
+            v.initStrides();
+            return v;
+        }
+
+        Tensor reshape(std::initializer_list<int> shape_) const
+        {
+            return reshape(int(shape_.size()), shape_.begin());
+        }
+
+        // Rows [begin, end) along axis 0.
+        Tensor sliceRows(int begin, int end) const
+        {
+            if (dims < 1 || begin < 0 || end > shape[0] || begin > end)
+                throw std::out_of_range("Row slice is out of range");
+            Tensor v = view();
+            v.shape[0] = end - begin;
+            if (v.data)
+                v.data += std::ptrdiff_t(begin) * strides[0];
+            return v;
+        }
+
+        // Drops every axis of extent 1 (axis < 0), or just the given one.
+        Tensor squeeze(int axis = -1) const
+        {
+            if (axis >= dims || (axis >= 0 && shape[axis] != 1))
+                throw std::out_of_range("squeeze axis must have extent 1");
+            int newShape[kInlineDims], newStrides[kInlineDims];
+            std::vector<int> spillShape, spillStrides;
+            int *ns = newShape, *nst = newStrides;
+            if (dims > kInlineDims)
+            {
+                spillShape.resize(dims);
+                spillStrides.resize(dims);
+                ns = spillShape.data();
+                nst = spillStrides.data();
+            }
+            int n = 0;
+            for (int i = 0; i < dims; i++)
+            {
+                if (axis < 0 ? shape[i] == 1 : i == axis)
+                    continue;
+                ns[n] = shape[i];
+                nst[n] = strides[i];
+                n++;
+            }
+
+            Tensor v = view();
+            v.releaseMeta();
+            v.initMeta(n);
+            std::memcpy(v.shape, ns, n * sizeof(int));
+            std::memcpy(v.strides, nst, n * sizeof(int));
+            return v;
+        }
+
+        bool isContiguous() const
+        {
+            int64_t expected = 1;
+            for (int i = dims - 1; i >= 0; i--)
+            {
+                if (shape[i] != 1 && strides[i] != expected)
+                    return false;
+                expected *= shape[i];
+            }
+            return true;
+        }
+
+        // A view of this tensor if it is already packed row-major, otherwise a packed copy.
+        Tensor contiguous() const
+        {
+            return isContiguous() ? view() : Tensor(*this);
+        }
+
+    private:
+        struct NoFill
+        {
+        };
+
+        Tensor(int dims_, ThreadPool *pool_, const int *shape_, NoFill)
+            : pool(pool_)
+        {
+            initMeta(dims_);
+            for (int i = 0; i < dims; i++)
+                shape[i] = shape_[i];
+            initStrides();
+            allocData(length());
+        }
+
+        // Refcounted owner of a data buffer; both live in the arena. Kept apart from
+        // the buffer so power-of-two tensors stay in their own size class.
+        struct Storage
+        {
+            std::atomic<int> refs;
+            float *base;
+            std::size_t bytes;
+        };
+
+        Storage *storage = nullptr;
+        int inlineShape[kInlineDims];
+        int inlineStrides[kInlineDims];
+
+        // Buffers come from the per-thread TensorArena so the temporaries of one
+        // training step are recycled by the next instead of hitting malloc.
+        static int *allocInts(int n)
+        {
+            return static_cast<int *>(TensorArena::allocate(sizeof(int) * n));
+        }
+
+        void allocData(uint64_t n)
+        {
+            const std::size_t bytes = sizeof(float) * n;
+            data = static_cast<float *>(TensorArena::allocate(bytes));
+            storage = new (TensorArena::allocate(sizeof(Storage))) Storage{{1}, data, bytes};
+        }
+
+        bool metaInline() const
+        {
+            return shape == inlineShape;
+        }
+
+        void initMeta(int n)
+        {
+            dims = n;
+            if (n <= kInlineDims)
+            {
+                shape = inlineShape;
+                strides = inlineStrides;
+            }
+            else
+            {
+                shape = allocInts(n);
+                strides = allocInts(n);
+            }
+        }
+
+        void initStrides()
+        {
+            if (dims == 0)
+                return;
+            strides[dims - 1] = 1;
+            for (int i = dims - 2; i >= 0; i--)
+                strides[i] = strides[i + 1] * shape[i + 1];
+        }
+
+        void copyMeta(const Tensor &other)
+        {
+            if (!other.shape)
+            {
+                dims = 0;
+                shape = strides = nullptr;
+                return;
+            }
+            initMeta(other.dims);
+            std::memcpy(shape, other.shape, dims * sizeof(int));
+            std::memcpy(strides, other.strides, dims * sizeof(int));
+        }
+
+        // Expects copyMeta(other) to have run; packs other's elements row-major.
+        void copyData(const Tensor &other)
+        {
+            data = nullptr;
+            storage = nullptr;
+            if (!other.data)
+                return;
+            const uint64_t n = other.length();
+            allocData(n);
+            if (other.isContiguous())
+            {
+                std::memcpy(data, other.data, n * sizeof(float));
+                return;
+            }
+
+            initStrides();
+            std::vector<int> idx(dims, 0);
+            const int inner = dims - 1;
+            const int innerLen = shape[inner], innerStride = other.strides[inner];
+            for (uint64_t out = 0; out < n; out += innerLen)
+            {
+                const float *src = other.data;
+                for (int i = 0; i < inner; i++)
+                    src += std::ptrdiff_t(idx[i]) * other.strides[i];
+                for (int j = 0; j < innerLen; j++)
+                    data[out + j] = src[std::ptrdiff_t(j) * innerStride];
+                for (int i = inner - 1; i >= 0; i--)
+                {
+                    if (++idx[i] < shape[i])
+                        break;
+                    idx[i] = 0;
+                }
+            }
+        }
+
+        // Leaves other empty. Inline metadata has to be copied; spilled metadata is taken over.
+        void stealFrom(Tensor &other) noexcept
+        {
+            if (other.shape && other.metaInline())
+            {
+                copyMeta(other);
+            }
+            else
+            {
+                dims = other.dims;
+                shape = other.shape;
+                strides = other.strides;
+            }
+            data = other.data;
+            storage = other.storage;
+
+            other.dims = 0;
+            other.shape = nullptr;
+            other.strides = nullptr;
+            other.data = nullptr;
+            other.storage = nullptr;
+        }
+
+        void releaseMeta()
+        {
+            if (shape && !metaInline())
+            {
+                TensorArena::deallocate(shape, sizeof(int) * dims);
+                TensorArena::deallocate(strides, sizeof(int) * dims);
+            }
+            shape = nullptr;
+            strides = nullptr;
+        }
+
+        void release()
+        {
+            if (storage && storage->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                TensorArena::deallocate(storage->base, storage->bytes);
+                storage->~Storage();
+                TensorArena::deallocate(storage, sizeof(Storage));
+            }
+            storage = nullptr;
+            data = nullptr;
+            releaseMeta();
+        }
     };
 
     struct Layer
@@ -40,53 +552,417 @@ namespace NeuralNetwork
         virtual Tensor forward(const Tensor &input) = 0;
         virtual Tensor backward(const Tensor &grad_output, float learning_rate) = 0;
         virtual ~Layer() = default;
+
+        virtual void SetPool(ThreadPool *p) { pool = p; }
+
+        // With updates deferred, backward() only accumulates parameter gradients and
+        // applyUpdates() takes the SGD step and clears them. Pipeline training uses this
+        // to sum the gradients of every micro-batch before one update.
+        virtual void setDeferUpdates(bool defer) { deferUpdates = defer; }
+        virtual void applyUpdates(float /*learning_rate*/) {}
+        // Appends the gradients summed so far while updates are deferred, e.g. for
+        // averaging across data-parallel replicas before applyUpdates().
+        virtual void gradients(std::vector<Tensor *> & /*out*/) {}
+
+    protected:
+        ThreadPool *pool = nullptr;
+        bool deferUpdates = false;
     };
 
     struct Dense : public Layer
     {
         Tensor weights;
         Tensor bias;
-        Tensor last_input;
+        Tensor last_input; // view of the forward input
+
+        Dense(int input_size, int output_size)
+            : weights(2, pool, {input_size, output_size}), bias(1, pool, {output_size})
+        {
+            std::mt19937 rng(123);
+            std::uniform_real_distribution<float> dist(-0.05f, 0.05f);
+            unary_map(pool, weights.data, weights.data, weights.length(),
+                      [&](float)
+                      { return dist(rng); });
+            unary_map(pool, bias.data, bias.data, bias.length(), [](float a)
+                      { return 0.f; });
+        }
+
+        void SetPool(ThreadPool *pool_) override
+        {
+            pool = pool_;
+            weights.setPool(pool_);
+            bias.setPool(pool_);
+            last_input.setPool(pool_);
+        }
+
+        Tensor forward(const Tensor &input) override
+        {
+            if (input.dims == 2)
+                return forward(input, gemm::Epilogue::None);
+
+            last_input = input.view(); // shares the caller's buffer until backward
+            Tensor output = input.dot(weights);
+            if (output.dims == 2 && bias.dims == 1)
+            {
+                add_bias_broadcast(pool,
+                                   /*Y*/ output.data, /*b*/ bias.data,
+                                   /*B*/ output.shape[0], /*O*/ output.shape[1],
+                                   /*Ystr0*/ output.strides[0], /*Ystr1*/ output.strides[1]);
+                return output;
+            }
+
+            return output + bias;
+        }
+
+        // Batched forward with the bias and an optional activation applied in the GEMM epilogue.
+        Tensor forward(const Tensor &input, gemm::Epilogue::Activation act, float alpha = 0.f)
+        {
+            if (input.dims != 2 || input.shape[1] != weights.shape[0])
+                throw std::out_of_range("Dense expects a [batch, in] input");
+            last_input = input.view(); // shares the caller's buffer until backward
+
+            int outShape[2] = {input.shape[0], weights.shape[1]};
+            Tensor output(2, pool, outShape);
+            gemm::Epilogue ep;
+            ep.bias = bias.data;
+            ep.act = act;
+            ep.alpha = alpha;
+            matmul_rows(pool,
+                        /*A*/ input.data, input.shape[0], input.shape[1], input.strides[0], input.strides[1],
+                        /*B*/ weights.data, weights.shape[1], weights.strides[0], weights.strides[1],
+                        /*C*/ output.data, output.strides[0], output.strides[1], ep);
+            return output;
+        }
+
+        Tensor backward(const Tensor &grad_output, float lr) override
+        {
+            // dX
+            Tensor grad_input = grad_output.dot(weights.transpose());
+
+            // dW = X^T · dY
+            Tensor grad_weights = last_input.transpose().dot(grad_output);
 
-        Dense(int input_size, int output_size);
+            // db = sum over rows
+            Tensor grad_bias(1, pool, bias.shape);
+            std::fill(grad_bias.data, grad_bias.data + grad_bias.length(), 0.f);
+            if (grad_output.dims == 2)
+            {
+                reduce_sum_rows(pool, grad_output.data,
+                                /*B*/ grad_output.shape[0], /*O*/ grad_output.shape[1],
+                                /*Xstr0*/ grad_output.strides[0], /*Xstr1*/ grad_output.strides[1],
+                                /*out*/ grad_bias.data);
+            }
+            else
+            {
+                // no batch
+                std::memcpy(grad_bias.data, grad_output.data, sizeof(float) * grad_bias.length());
+            }
 
-        Tensor forward(const Tensor &input) override;
-        Tensor backward(const Tensor &grad_output, float learning_rate) override;
+            if (deferUpdates)
+            {
+                if (!acc_weights.data)
+                {
+                    acc_weights = Tensor(weights.dims, pool, weights.shape);
+                    acc_bias = Tensor(bias.dims, pool, bias.shape);
+                }
+                vec_add(pool, acc_weights.data, acc_weights.data, grad_weights.data, weights.length());
+                vec_add(pool, acc_bias.data, acc_bias.data, grad_bias.data, bias.length());
+                return grad_input;
+            }
+
+            // SGD update
+            vec_axpy(pool, weights.data, -lr, grad_weights.data, weights.length());
+            vec_axpy(pool, bias.data, -lr, grad_bias.data, bias.length());
+
+            return grad_input;
+        }
+
+        void applyUpdates(float lr) override
+        {
+            if (!acc_weights.data)
+                return;
+            vec_axpy(pool, weights.data, -lr, acc_weights.data, weights.length());
+            vec_axpy(pool, bias.data, -lr, acc_bias.data, bias.length());
+            std::memset(acc_weights.data, 0, sizeof(float) * acc_weights.length());
+            std::memset(acc_bias.data, 0, sizeof(float) * acc_bias.length());
+        }
+
+        void gradients(std::vector<Tensor *> &out) override
+        {
+            if (!acc_weights.data)
+                return;
+            out.push_back(&acc_weights);
+            out.push_back(&acc_bias);
+        }
 
     private:
-        Tensor transpose(const Tensor &t);
+        Tensor acc_weights; // summed gradients while updates are deferred
+        Tensor acc_bias;
     };
 
     struct ReLu : public Layer
     {
-        Tensor last_input;
-        Tensor forward(const Tensor &input) override;
-        Tensor backward(const Tensor &grad_output, float) override;
+        std::vector<uint64_t> mask; // one bit per input element: x > 0
+
+        Tensor forward(const Tensor &input) override
+        {
+            const Tensor x = input.contiguous();
+            const int64_t n = int64_t(x.length());
+            mask.resize(size_t((n + 63) / 64));
+            vec_sign_mask(pool, mask.data(), x.data, n);
+
+            Tensor output = Tensor(input.dims, pool, input.shape);
+            vec_relu(pool, output.data, x.data, n);
+            return output;
+        }
+
+        Tensor backward(const Tensor &grad_output, float) override
+        {
+            const Tensor dy = grad_output.contiguous();
+            Tensor grad_input(dy.dims, pool, dy.shape);
+            vec_mask_backward(pool, grad_input.data, mask.data(), dy.data, 0.f, int64_t(dy.length()));
+
+            return grad_input;
+        }
     };
 
     struct Sigmoid : public Layer
     {
-        Tensor last_output;
-        Tensor forward(const Tensor &input) override;
-        Tensor backward(const Tensor &grad_output, float /*lr*/) override;
+        Tensor last_output; // store for backward (since σ'(x) = σ(x)(1-σ(x)))
+
+        void SetPool(ThreadPool *pool_) override
+        {
+            pool = pool_;
+            last_output.setPool(pool_);
+        }
+
+        Tensor forward(const Tensor &input) override
+        {
+            const Tensor x = input.contiguous();
+            last_output = Tensor(input.dims, pool, input.shape);
+            vec_sigmoid(pool, last_output.data, x.data, input.length());
+            return last_output;
+        }
+
+        Tensor backward(const Tensor &grad_output, float /*lr*/) override
+        {
+            Tensor grad_input = grad_output; // same shape
+
+            vec_sigmoid_backward(pool, grad_input.data, last_output.data, grad_input.data, grad_output.length());
+            return grad_input;
+        }
     };
 
     struct LeakyReLU : public Layer
     {
-        Tensor last_input;
+        std::vector<uint64_t> mask; // one bit per input element: x > 0
         float alpha;
-        LeakyReLU(float alpha_ = 0.01f);
-        Tensor forward(const Tensor &input) override;
-        Tensor backward(const Tensor &grad_output, float /*lr*/) override;
+
+        LeakyReLU(float alpha_ = 0.01f) : alpha(alpha_) {}
+
+        Tensor forward(const Tensor &input) override
+        {
+            const Tensor x = input.contiguous();
+            const int64_t n = int64_t(x.length());
+            mask.resize(size_t((n + 63) / 64));
+            vec_sign_mask(pool, mask.data(), x.data, n);
+
+            Tensor output = Tensor(input.dims, pool, input.shape);
+            vec_leaky_relu(pool, output.data, x.data, alpha, n);
+
+            return output;
+        }
+
+        Tensor backward(const Tensor &grad_output, float /*lr*/) override
+        {
+            const Tensor dy = grad_output.contiguous();
+            Tensor grad_input(dy.dims, pool, dy.shape);
+
+            vec_mask_backward(pool, grad_input.data, mask.data(), dy.data, alpha, int64_t(dy.length()));
+            return grad_input;
+        }
+    };
+
+    // Dense followed by ReLu, LeakyReLU or Sigmoid, run as one GEMM whose epilogue adds
+    // the bias and applies the activation. Backward derives the activation gradient from
+    // the saved output, so no pre-activation tensor is kept. Owns both wrapped layers.
+    struct DenseActivation : public Layer
+    {
+        Dense *dense;
+        Layer *activation;
+        Tensor last_output;
+
+        DenseActivation(Dense *dense_, Layer *activation_)
+            : dense(dense_), activation(activation_)
+        {
+            if (!fusable(activation_, &act, &alpha))
+                throw std::invalid_argument("DenseActivation: unsupported activation layer");
+        }
+
+        ~DenseActivation() override
+        {
+            delete dense;
+            delete activation;
+        }
+
+        static bool fusable(const Layer *layer, gemm::Epilogue::Activation *act = nullptr, float *alpha = nullptr)
+        {
+            gemm::Epilogue::Activation kind;
+            float slope = 0.f;
+            if (dynamic_cast<const ReLu *>(layer))
+                kind = gemm::Epilogue::ReLU;
+            else if (auto *leaky = dynamic_cast<const LeakyReLU *>(layer))
+            {
+                // Backward reads the sign of the output, which needs a positive slope.
+                if (leaky->alpha <= 0.f)
+                    return false;
+                kind = gemm::Epilogue::LeakyReLU;
+                slope = leaky->alpha;
+            }
+            else if (dynamic_cast<const Sigmoid *>(layer))
+                kind = gemm::Epilogue::Sigmoid;
+            else
+                return false;
+            if (act)
+                *act = kind;
+            if (alpha)
+                *alpha = slope;
+            return true;
+        }
+
+        void SetPool(ThreadPool *pool_) override
+        {
+            pool = pool_;
+            dense->SetPool(pool_);
+            activation->SetPool(pool_);
+            last_output.setPool(pool_);
+        }
+
+        void setDeferUpdates(bool defer) override
+        {
+            deferUpdates = defer;
+            dense->setDeferUpdates(defer);
+        }
+
+        void applyUpdates(float lr) override
+        {
+            dense->applyUpdates(lr);
+        }
+
+        void gradients(std::vector<Tensor *> &out) override
+        {
+            dense->gradients(out);
+        }
+
+        // The result is a view of the saved activation; it must not be written to
+        // before backward runs.
+        Tensor forward(const Tensor &input) override
+        {
+            batched = input.dims == 2;
+            last_output = dense->forward(batched ? input.view() : input.reshape({1, input.shape[0]}), act, alpha);
+            return batched ? last_output.view() : last_output.reshape({last_output.shape[1]});
+        }
+
+        Tensor backward(const Tensor &grad_output, float lr) override
+        {
+            const Tensor dy = batched ? grad_output.contiguous() : grad_output.reshape({1, grad_output.shape[0]});
+            dy.equalsSize(last_output);
+
+            Tensor dz(2, pool, last_output.shape);
+            const int64_t n = int64_t(dz.length());
+            switch (act)
+            {
+            case gemm::Epilogue::ReLU:
+                // y > 0 exactly where x > 0
+                vec_relu_backward(pool, dz.data, last_output.data, dy.data, n);
+                break;
+            case gemm::Epilogue::LeakyReLU:
+                vec_leaky_relu_backward(pool, dz.data, last_output.data, dy.data, alpha, n);
+                break;
+            default:
+                vec_sigmoid_backward(pool, dz.data, last_output.data, dy.data, n);
+                break;
+            }
+
+            Tensor grad_input = dense->backward(dz, lr);
+            return batched ? grad_input : grad_input.reshape({grad_input.shape[1]});
+        }
+
+    private:
+        gemm::Epilogue::Activation act = gemm::Epilogue::None;
+        float alpha = 0.f;
+        bool batched = true;
     };
 
     struct Sequential
     {
         std::vector<Layer *> layers;
-        void add(Layer *layer);
-        Tensor forward(const Tensor &input);
-        void backward(const Tensor &grad_output, float lr);
-        ~Sequential();
+        ThreadPool &pool;
+
+        // When set, add() merges a Dense followed by a supported activation into one
+        // DenseActivation layer. The added layer objects stay alive inside it.
+        bool fuse = true;
+
+        // Called by backward() with each layer's index as soon as that layer is done
+        // (last layer first), so its gradients can be shipped while earlier layers
+        // are still computing.
+        std::function<void(int)> afterLayerBackward;
+
+        Sequential(ThreadPool &p) : pool(p) {}
+
+        void add(Layer *layer)
+        {
+            layer->SetPool(&pool);
+            if (fuse && !layers.empty() && DenseActivation::fusable(layer))
+            {
+                if (auto *dense = dynamic_cast<Dense *>(layers.back()))
+                {
+                    layers.back() = new DenseActivation(dense, layer);
+                    layers.back()->SetPool(&pool);
+                    return;
+                }
+            }
+            layers.push_back(layer);
+        }
+
+        Tensor forward(const Tensor &input)
+        {
+            Tensor x = input.view();
+            for (auto layer : layers)
+                x = layer->forward(x);
+            return x;
+        }
+
+        // Returns the gradient with respect to the network input.
+        Tensor backward(const Tensor &grad_output, float lr)
+        {
+            Tensor grad = grad_output.view();
+            for (int i = int(layers.size()) - 1; i >= 0; i--)
+            {
+                grad = layers[i]->backward(grad, lr);
+                if (afterLayerBackward)
+                    afterLayerBackward(i);
+            }
+            return grad;
+        }
+
+        void setDeferUpdates(bool defer)
+        {
+            for (auto layer : layers)
+                layer->setDeferUpdates(defer);
+        }
+
+        void applyUpdates(float lr)
+        {
+            for (auto layer : layers)
+                layer->applyUpdates(lr);
+        }
+
+        ~Sequential()
+        {
+            for (auto l : layers)
+                delete l;
+        }
     };
 }
 
@@ -0,0 +1,339 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "./ThreadPool.hpp"
+#include "./ParallelFor.h"
+#include "./Ops_Simd.h"
+
+// Packed, cache-blocked SGEMM (Goto/BLIS layout).
+//   C[M x N] = A[M x K] * B[K x N], every operand addressed through (row, col) strides
+//   so transposed or sliced inputs are packed directly without a copy.
+// Loop nest: jc (NC columns, L3) -> pc (KC depth, L2/L1) -> tiles of MC x NR*jgroup -> MR x NR micro-kernel.
+namespace gemm
+{
+#if defined(__AVX__)
+    constexpr int MR = 6;  // 6x16 tile = 12 ymm accumulators
+    constexpr int NR = 16;
+#else
+    constexpr int MR = 4;  // 4x8 tile = 8 xmm accumulators
+    constexpr int NR = 8;
+#endif
+    constexpr int KC = 256;  // B micro-panel KC*NR floats stays in L1
+    constexpr int MC = 96;   // A block MC*KC floats stays in L2 (multiple of MR)
+    constexpr int NC = 4096; // B panel KC*NC floats stays in L3 (multiple of NR)
+
+    static_assert(MC % MR == 0, "MC must be a multiple of MR");
+    static_assert(NC % NR == 0, "NC must be a multiple of NR");
+
+    // Applied to each register tile as it is stored after the last depth block:
+    // C = act(A*B + bias[col]). Lets Dense fuse its bias and activation into the GEMM.
+    struct Epilogue
+    {
+        enum Activation
+        {
+            None,
+            ReLU,
+            LeakyReLU,
+            Sigmoid
+        };
+
+        const float *bias = nullptr; // [N], indexed by output column
+        Activation act = None;
+        float alpha = 0.f; // LeakyReLU slope
+
+        bool empty() const { return !bias && act == None; }
+
+        // Finishes one contiguous row segment in place; bias points at its first column.
+        void apply(float *row, const float *bias_, int n) const
+        {
+            if (bias_)
+                for (int j = 0; j < n; ++j)
+                    row[j] += bias_[j];
+            const simd::Kernels &k = simd::kernels();
+            switch (act)
+            {
+            case ReLU:
+                k.relu(row, row, n);
+                break;
+            case LeakyReLU:
+                k.leaky_relu(row, row, alpha, n);
+                break;
+            case Sigmoid:
+                k.sigmoid(row, row, n);
+                break;
+            default:
+                break;
+            }
+        }
+    };
+
+    // Packing and tile loops have few, heavy iterations whose cost we know up front.
+    template <class Fn>
+    inline void for_each_task(ThreadPool *pool, int64_t n, ParallelCost cost, const Fn &fn)
+    {
+        if (!pool || n <= 1)
+        {
+            fn(0, n);
+            return;
+        }
+        ParallelFor(*pool, 0, n, fn, cost);
+    }
+
+    // Per-thread packing buffers. A nested gemm on the same thread (e.g. a pool task
+    // run while waiting) falls back to its own storage instead of clobbering ours.
+    struct Scratch
+    {
+        std::vector<float> a, b;
+        bool busy = false;
+    };
+
+    class ScratchLease
+    {
+    public:
+        ScratchLease()
+        {
+            static thread_local Scratch tls;
+            s = tls.busy ? &local : &tls;
+            s->busy = true;
+        }
+        ~ScratchLease() { s->busy = false; }
+
+        float *a(size_t n)
+        {
+            if (s->a.size() < n)
+                s->a.resize(n);
+            return s->a.data();
+        }
+        float *b(size_t n)
+        {
+            if (s->b.size() < n)
+                s->b.resize(n);
+            return s->b.data();
+        }
+
+    private:
+        Scratch local;
+        Scratch *s;
+    };
+
+    // Pack rows [i0, i0+mc) x depth [p0, p0+kc) of A into MR-row slivers, k-major, zero padded.
+    inline void pack_a(int mc, int kc, const float *A, int As0, int As1, float *Ap)
+    {
+        for (int ir = 0; ir < mc; ir += MR)
+        {
+            const int mr = std::min(MR, mc - ir);
+            const float *a = A + int64_t(ir) * As0;
+            for (int p = 0; p < kc; ++p)
+            {
+                const float *ap = a + int64_t(p) * As1;
+                int i = 0;
+                for (; i < mr; ++i)
+                    Ap[i] = ap[int64_t(i) * As0];
+                for (; i < MR; ++i)
+                    Ap[i] = 0.f;
+                Ap += MR;
+            }
+        }
+    }
+
+    // Pack depth [p0, p0+kc) x columns [j0, j0+nc) of B into NR-column slivers, k-major, zero padded.
+    inline void pack_b(int kc, int nc, const float *B, int Bs0, int Bs1, float *Bp)
+    {
+        for (int jr = 0; jr < nc; jr += NR)
+        {
+            const int nr = std::min(NR, nc - jr);
+            const float *b = B + int64_t(jr) * Bs1;
+            for (int p = 0; p < kc; ++p)
+            {
+                const float *bp = b + int64_t(p) * Bs0;
+                int j = 0;
+                if (Bs1 == 1)
+                    for (; j < nr; ++j)
+                        Bp[j] = bp[j];
+                else
+                    for (; j < nr; ++j)
+                        Bp[j] = bp[int64_t(j) * Bs1];
+                for (; j < NR; ++j)
+                    Bp[j] = 0.f;
+                Bp += NR;
+            }
+        }
+    }
+
+#if defined(__GNUC__) || defined(__clang__)
+    // Native SIMD register type; the micro-kernel keeps MR x NR/VW of these live.
+    constexpr int VW = NR / 2;
+    typedef float vreg __attribute__((vector_size(VW * sizeof(float)), aligned(sizeof(float))));
+#endif
+
+    // MR x NR register tile: acc += Ap(kc x MR)^T * Bp(kc x NR), then C = acc (+ C if accumulate).
+    // With an epilogue (final depth block only) C = ep(acc (+ C)); bias points at the tile's first column.
+    inline void micro_kernel(int kc, const float *__restrict Ap, const float *__restrict Bp,
+                             float *C, int Cs0, int Cs1, int mr, int nr, bool accumulate,
+                             const Epilogue *ep = nullptr, const float *bias = nullptr)
+    {
+        alignas(64) float acc[MR][NR];
+#if defined(__GNUC__) || defined(__clang__)
+        vreg c[MR][2] = {};
+        for (int p = 0; p < kc; ++p)
+        {
+            const vreg b0 = *reinterpret_cast<const vreg *>(Bp + p * NR);
+            const vreg b1 = *reinterpret_cast<const vreg *>(Bp + p * NR + VW);
+            const float *a = Ap + p * MR;
+            for (int i = 0; i < MR; ++i)
+            {
+                c[i][0] += a[i] * b0;
+                c[i][1] += a[i] * b1;
+            }
+        }
+        for (int i = 0; i < MR; ++i)
+            for (int j = 0; j < VW; ++j)
+            {
+                acc[i][j] = c[i][0][j];
+                acc[i][j + VW] = c[i][1][j];
+            }
+#else
+        for (int i = 0; i < MR; ++i)
+            for (int j = 0; j < NR; ++j)
+                acc[i][j] = 0.f;
+        for (int p = 0; p < kc; ++p)
+        {
+            const float *a = Ap + p * MR;
+            const float *b = Bp + p * NR;
+            for (int i = 0; i < MR; ++i)
+            {
+                const float ai = a[i];
+                for (int j = 0; j < NR; ++j)
+                    acc[i][j] += ai * b[j];
+            }
+        }
+#endif
+
+        if (ep)
+        {
+            for (int i = 0; i < mr; ++i)
+            {
+                float *c = C + int64_t(i) * Cs0;
+                if (accumulate)
+                    for (int j = 0; j < nr; ++j)
+                        acc[i][j] += c[int64_t(j) * Cs1];
+                ep->apply(acc[i], bias, nr);
+                for (int j = 0; j < nr; ++j)
+                    c[int64_t(j) * Cs1] = acc[i][j];
+            }
+            return;
+        }
+
+        if (mr == MR && nr == NR && Cs1 == 1)
+        {
+            for (int i = 0; i < MR; ++i)
+            {
+                float *c = C + int64_t(i) * Cs0;
+                if (accumulate)
+                    for (int j = 0; j < NR; ++j)
+                        c[j] += acc[i][j];
+                else
+                    for (int j = 0; j < NR; ++j)
+                        c[j] = acc[i][j];
+            }
+            return;
+        }
+        for (int i = 0; i < mr; ++i)
+        {
+            float *c = C + int64_t(i) * Cs0;
+            for (int j = 0; j < nr; ++j)
+            {
+                float &dst = c[int64_t(j) * Cs1];
+                dst = accumulate ? dst + acc[i][j] : acc[i][j];
+            }
+        }
+    }
+
+    inline void sgemm(ThreadPool *pool, int M, int N, int K,
+                      const float *A, int As0, int As1,
+                      const float *B, int Bs0, int Bs1,
+                      float *C, int Cs0, int Cs1,
+                      const Epilogue &epilogue = Epilogue())
+    {
+        if (M <= 0 || N <= 0)
+            return;
+        const Epilogue *ep = epilogue.empty() ? nullptr : &epilogue;
+        if (K <= 0)
+        {
+            std::vector<float> row(N);
+            for (int i = 0; i < M; ++i)
+            {
+                std::fill(row.begin(), row.end(), 0.f);
+                if (ep)
+                    ep->apply(row.data(), ep->bias, N);
+                for (int j = 0; j < N; ++j)
+                    C[int64_t(i) * Cs0 + int64_t(j) * Cs1] = row[j];
+            }
+            return;
+        }
+
+        ScratchLease scratch;
+        const int Mpad = (M + MR - 1) / MR * MR;
+        const int icBlocks = (M + MC - 1) / MC;
+        const int threads = pool ? std::max<int>(1, int(pool->size())) : 1;
+
+        for (int jc = 0; jc < N; jc += NC)
+        {
+            const int nc = std::min(NC, N - jc);
+            const int ncPanels = (nc + NR - 1) / NR;
+
+            // Split the columns into enough groups that every thread gets a tile even when M is one block.
+            const int wantGroups = std::max(1, (threads * 2 + icBlocks - 1) / icBlocks);
+            const int panelsPerGroup = std::max(1, (ncPanels + wantGroups - 1) / wantGroups);
+            const int jGroups = (ncPanels + panelsPerGroup - 1) / panelsPerGroup;
+
+            for (int pc = 0; pc < K; pc += KC)
+            {
+                const int kc = std::min(KC, K - pc);
+                float *Bp = scratch.b(size_t(ncPanels) * NR * kc);
+                float *Ap = scratch.a(size_t(Mpad) * kc);
+                const float *Bsrc = B + int64_t(pc) * Bs0 + int64_t(jc) * Bs1;
+                const float *Asrc = A + int64_t(pc) * As1;
+
+                for_each_task(pool, ncPanels, ParallelCost::bytes(8.0 * kc * NR), [&](int64_t s, int64_t e)
+                              {
+                    for (int64_t jp = s; jp < e; ++jp) {
+                        const int j0 = int(jp) * NR;
+                        pack_b(kc, std::min(NR, nc - j0), Bsrc + int64_t(j0) * Bs1, Bs0, Bs1,
+                               Bp + size_t(jp) * NR * kc);
+                    } });
+                for_each_task(pool, Mpad / MR, ParallelCost::bytes(8.0 * kc * MR), [&](int64_t s, int64_t e)
+                              {
+                    for (int64_t ip = s; ip < e; ++ip) {
+                        const int i0 = int(ip) * MR;
+                        pack_a(std::min(MR, M - i0), kc, Asrc + int64_t(i0) * As0, As0, As1,
+                               Ap + size_t(ip) * MR * kc);
+                    } });
+
+                const bool accumulate = pc > 0;
+                const Epilogue *tileEp = pc + kc >= K ? ep : nullptr;
+                for_each_task(pool, int64_t(icBlocks) * jGroups,
+                              ParallelCost::flops(2.0 * std::min(MC, M) * kc * NR * panelsPerGroup), [&](int64_t s, int64_t e)
+                              {
+                    for (int64_t t = s; t < e; ++t) {
+                        const int ic = int(t / jGroups) * MC;
+                        const int mc = std::min(MC, M - ic);
+                        const int jp0 = int(t % jGroups) * panelsPerGroup;
+                        const int jp1 = std::min(ncPanels, jp0 + panelsPerGroup);
+                        for (int jp = jp0; jp < jp1; ++jp) {
+                            const int jr = jp * NR;
+                            const int nr = std::min(NR, nc - jr);
+                            const float* bp = Bp + size_t(jp) * NR * kc;
+                            for (int ir = 0; ir < mc; ir += MR) {
+                                micro_kernel(kc, Ap + size_t(ic + ir) * kc, bp,
+                                             C + int64_t(ic + ir) * Cs0 + int64_t(jc + jr) * Cs1, Cs0, Cs1,
+                                             std::min(MR, mc - ir), nr, accumulate,
+                                             tileEp, tileEp && tileEp->bias ? tileEp->bias + jc + jr : nullptr);
+                            }
+                        }
+                    } });
+            }
+        }
+    }
+}
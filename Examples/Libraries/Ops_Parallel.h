@@ -1,11 +1,16 @@
 #pragma once
+#include <algorithm>
 #include <cstdint>
 #include <functional>
 #include "./ThreadPool.hpp"
 #include "./ParallelFor.h"
+#include "./Ops_Gemm.h"
+#include "./Ops_Simd.h"
 
-inline void ForEachRange(ThreadPool *pool, int64_t begin, int64_t end,
-                         const std::function<void(int64_t, int64_t)> &fn)
+// Templated kernels take the callable by forwarding reference so it inlines into
+// the per-element loop; the std::function overloads are kept as thin wrappers.
+template <class Fn>
+inline void ForEachRange(ThreadPool *pool, int64_t begin, int64_t end, Fn &&fn)
 {
     if (end <= begin)
         return;
@@ -17,38 +22,164 @@ inline void ForEachRange(ThreadPool *pool, int64_t begin, int64_t end,
     ParallelFor(*pool, begin, end, fn);
 }
 
+// Same, with the grain chosen from a ParallelCost hint or a call-site GrainTuner.
+template <class Fn, class Grain>
+inline void ForEachRange(ThreadPool *pool, int64_t begin, int64_t end, Fn &&fn, Grain &&grain)
+{
+    if (end <= begin)
+        return;
+    if (!pool)
+    {
+        fn(begin, end);
+        return;
+    }
+    ParallelFor(*pool, begin, end, fn, std::forward<Grain>(grain));
+}
+
+inline void ForEachRange(ThreadPool *pool, int64_t begin, int64_t end,
+                         const std::function<void(int64_t, int64_t)> &fn)
+{
+    ForEachRange<const std::function<void(int64_t, int64_t)> &>(pool, begin, end, fn);
+}
+
+template <class Fn>
+inline void unary_map(ThreadPool *pool, float *dest, const float *src, int64_t num, Fn &&fn)
+{
+    static GrainTuner tuner; // one per callable type, i.e. per call site for lambdas
+    ForEachRange(pool, 0, num, [&](int64_t start, int64_t end)
+                 {
+        for (int64_t i = start; i < end; ++i) dest[i] = fn(src[i]); }, tuner);
+}
+
 inline void unary_map(ThreadPool *pool, float *dest, const float *src, int64_t num,
                       const std::function<float(float)> &fn)
 {
-    ForEachRange(pool, 0, num, [&](int64_t start, int64_t end)
+    unary_map<const std::function<float(float)> &>(pool, dest, src, num, fn);
+}
+
+template <class Fn>
+inline void binary_map(ThreadPool *pool, float *dst, const float *a, const float *b, int64_t n, Fn &&f)
+{
+    static GrainTuner tuner;
+    ForEachRange(pool, 0, n, [&](int64_t start, int64_t end)
                  {
-        for (int64_t i = start; i < end; ++i) dest[i] = fn(src[i]); });
+        for (int64_t i = start; i < end; ++i) dst[i] = f(a[i], b[i]); }, tuner);
 }
 
 inline void binary_map(ThreadPool *pool, float *dst, const float *a, const float *b, int64_t n,
                        const std::function<float(float, float)> &f)
 {
-    ForEachRange(pool, 0, n, [&](int64_t start, int64_t end)
-                 {
-        for (int64_t i = start; i < end; ++i) dst[i] = f(a[i], b[i]); });
+    binary_map<const std::function<float(float, float)> &>(pool, dst, a, b, n, f);
+}
+
+// Vectorized elementwise ops: each chunk runs the CPUID-selected simd kernel.
+inline void vec_add(ThreadPool *pool, float *dst, const float *a, const float *b, int64_t n)
+{
+    const auto &k = simd::kernels();
+    static GrainTuner tuner;
+    ForEachRange(pool, 0, n, [&](int64_t s, int64_t e)
+                 { k.add(dst + s, a + s, b + s, e - s); }, tuner);
+}
+
+inline void vec_sub(ThreadPool *pool, float *dst, const float *a, const float *b, int64_t n)
+{
+    const auto &k = simd::kernels();
+    static GrainTuner tuner;
+    ForEachRange(pool, 0, n, [&](int64_t s, int64_t e)
+                 { k.sub(dst + s, a + s, b + s, e - s); }, tuner);
+}
+
+inline void vec_mul(ThreadPool *pool, float *dst, const float *a, const float *b, int64_t n)
+{
+    const auto &k = simd::kernels();
+    static GrainTuner tuner;
+    ForEachRange(pool, 0, n, [&](int64_t s, int64_t e)
+                 { k.mul(dst + s, a + s, b + s, e - s); }, tuner);
+}
+
+inline void vec_axpy(ThreadPool *pool, float *y, float alpha, const float *x, int64_t n)
+{
+    const auto &k = simd::kernels();
+    static GrainTuner tuner;
+    ForEachRange(pool, 0, n, [&](int64_t s, int64_t e)
+                 { k.axpy(y + s, alpha, x + s, e - s); }, tuner);
+}
+
+inline void vec_relu(ThreadPool *pool, float *dst, const float *x, int64_t n)
+{
+    const auto &k = simd::kernels();
+    static GrainTuner tuner;
+    ForEachRange(pool, 0, n, [&](int64_t s, int64_t e)
+                 { k.relu(dst + s, x + s, e - s); }, tuner);
+}
+
+inline void vec_leaky_relu(ThreadPool *pool, float *dst, const float *x, float alpha, int64_t n)
+{
+    const auto &k = simd::kernels();
+    static GrainTuner tuner;
+    ForEachRange(pool, 0, n, [&](int64_t s, int64_t e)
+                 { k.leaky_relu(dst + s, x + s, alpha, e - s); }, tuner);
+}
+
+inline void vec_sigmoid(ThreadPool *pool, float *dst, const float *x, int64_t n)
+{
+    const auto &k = simd::kernels();
+    static GrainTuner tuner;
+    ForEachRange(pool, 0, n, [&](int64_t s, int64_t e)
+                 { k.sigmoid(dst + s, x + s, e - s); }, tuner);
+}
+
+inline void vec_relu_backward(ThreadPool *pool, float *dx, const float *x, const float *dy, int64_t n)
+{
+    const auto &k = simd::kernels();
+    static GrainTuner tuner;
+    ForEachRange(pool, 0, n, [&](int64_t s, int64_t e)
+                 { k.relu_backward(dx + s, x + s, dy + s, e - s); }, tuner);
+}
+
+inline void vec_leaky_relu_backward(ThreadPool *pool, float *dx, const float *x, const float *dy, float alpha, int64_t n)
+{
+    const auto &k = simd::kernels();
+    static GrainTuner tuner;
+    ForEachRange(pool, 0, n, [&](int64_t s, int64_t e)
+                 { k.leaky_relu_backward(dx + s, x + s, dy + s, alpha, e - s); }, tuner);
+}
+
+inline void vec_sigmoid_backward(ThreadPool *pool, float *dx, const float *y, const float *dy, int64_t n)
+{
+    const auto &k = simd::kernels();
+    static GrainTuner tuner;
+    ForEachRange(pool, 0, n, [&](int64_t s, int64_t e)
+                 { k.sigmoid_backward(dx + s, y + s, dy + s, e - s); }, tuner);
+}
+
+// Chunks are whole 64-element mask words so tasks never share a word.
+inline void vec_sign_mask(ThreadPool *pool, uint64_t *mask, const float *x, int64_t n)
+{
+    const auto &k = simd::kernels();
+    static GrainTuner tuner;
+    ForEachRange(pool, 0, (n + 63) / 64, [&](int64_t s, int64_t e)
+                 { k.sign_mask(mask + s, x + s * 64, std::min(e * 64, n) - s * 64); }, tuner);
+}
+
+inline void vec_mask_backward(ThreadPool *pool, float *dx, const uint64_t *mask, const float *dy, float neg_slope, int64_t n)
+{
+    const auto &k = simd::kernels();
+    static GrainTuner tuner;
+    ForEachRange(pool, 0, (n + 63) / 64, [&](int64_t s, int64_t e)
+                 { k.mask_backward(dx + s * 64, mask + s, dy + s * 64, neg_slope, std::min(e * 64, n) - s * 64); }, tuner);
 }
 
 inline void matmul_rows(ThreadPool *pool,
                         const float *A, int Ar, int Ac, int Astr0, int Astr1,
                         const float *B, int Bc, int Bstr0, int Bstr1,
-                        float *C, int Cstr0, int Cstr1)
+                        float *C, int Cstr0, int Cstr1,
+                        const gemm::Epilogue &epilogue = gemm::Epilogue())
 {
-    ForEachRange(pool, 0, Ar, [&](int64_t s, int64_t e)
-                 {
-        for (int i = int(s); i < int(e); ++i) {
-            const float* aRow = A + i * Astr0;
-            for (int j = 0; j < Bc; ++j) {
-                float sum = 0.f;
-                for (int k = 0; k < Ac; ++k)
-                    sum += aRow[k * Astr1] * B[k * Bstr0 + j * Bstr1];
-                C[i * Cstr0 + j * Cstr1] = sum;
-            }
-        } });
+    gemm::sgemm(pool, Ar, Bc, Ac,
+                A, Astr0, Astr1,
+                B, Bstr0, Bstr1,
+                C, Cstr0, Cstr1, epilogue);
 }
 
 inline void add_bias_broadcast(ThreadPool *pool,
@@ -60,7 +191,7 @@ inline void add_bias_broadcast(ThreadPool *pool,
         for (int i = int(s); i < int(e); ++i) {
             float* row = Y + i * Ystr0;
             for (int j = 0; j < O; ++j) row[j * Ystr1] += b[j];
-        } });
+        } }, ParallelCost::bytes(8.0 * O));
 }
 
 inline void reduce_sum_rows(ThreadPool *pool,
@@ -77,20 +208,20 @@ inline void reduce_sum_rows(ThreadPool *pool,
         }
         return;
     }
-    const int tasks = std::max(1, int(pool->size()) * 4);
-    std::vector<std::vector<float>> partial(tasks, std::vector<float>(O, 0.f));
+    const int tasks = std::max(1, std::min(B, int(pool->size()) * 4));
+    std::vector<float> partial(size_t(tasks) * O, 0.f);
     ForEachRange(pool, 0, tasks, [&](int64_t s, int64_t e)
                  {
         for (int t = int(s); t < int(e); ++t) {
             int i0 = int((int64_t(B) *  t    ) / tasks);
             int i1 = int((int64_t(B) * (t+1)) / tasks);
-            auto& acc = partial[t];
+            float* acc = partial.data() + size_t(t) * O;
             for (int i = i0; i < i1; ++i) {
                 const float* row = X + i * Xstr0;
                 for (int j = 0; j < O; ++j) acc[j] += row[j * Xstr1];
             }
-        } });
+        } }, ParallelCost::bytes(4.0 * O * B / tasks));
     for (int t = 0; t < tasks; ++t)
         for (int j = 0; j < O; ++j)
-            out[j] += partial[t][j];
+            out[j] += partial[size_t(t) * O + j];
 }
@@ -0,0 +1,650 @@
+#include "Ops_Simd.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define GNE_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace simd
+{
+    namespace
+    {
+        // ---------- scalar reference ----------
+
+        inline float sigmoid1(float a)
+        {
+            if (a >= 0.f)
+            {
+                float z = std::exp(-a);
+                return 1.f / (1.f + z);
+            }
+            float z = std::exp(a);
+            return z / (1.f + z);
+        }
+
+        void add_scalar(float *dst, const float *a, const float *b, int64_t n)
+        {
+            for (int64_t i = 0; i < n; ++i)
+                dst[i] = a[i] + b[i];
+        }
+        void sub_scalar(float *dst, const float *a, const float *b, int64_t n)
+        {
+            for (int64_t i = 0; i < n; ++i)
+                dst[i] = a[i] - b[i];
+        }
+        void mul_scalar(float *dst, const float *a, const float *b, int64_t n)
+        {
+            for (int64_t i = 0; i < n; ++i)
+                dst[i] = a[i] * b[i];
+        }
+        void axpy_scalar(float *y, float alpha, const float *x, int64_t n)
+        {
+            for (int64_t i = 0; i < n; ++i)
+                y[i] += alpha * x[i];
+        }
+        void relu_scalar(float *dst, const float *x, int64_t n)
+        {
+            for (int64_t i = 0; i < n; ++i)
+                dst[i] = x[i] > 0.f ? x[i] : 0.f;
+        }
+        void leaky_relu_scalar(float *dst, const float *x, float alpha, int64_t n)
+        {
+            for (int64_t i = 0; i < n; ++i)
+                dst[i] = x[i] > 0.f ? x[i] : alpha * x[i];
+        }
+        void sigmoid_scalar(float *dst, const float *x, int64_t n)
+        {
+            for (int64_t i = 0; i < n; ++i)
+                dst[i] = sigmoid1(x[i]);
+        }
+        void relu_backward_scalar(float *dx, const float *x, const float *dy, int64_t n)
+        {
+            for (int64_t i = 0; i < n; ++i)
+                dx[i] = x[i] > 0.f ? dy[i] : 0.f;
+        }
+        void leaky_relu_backward_scalar(float *dx, const float *x, const float *dy, float alpha, int64_t n)
+        {
+            for (int64_t i = 0; i < n; ++i)
+                dx[i] = dy[i] * (x[i] > 0.f ? 1.f : alpha);
+        }
+        void sigmoid_backward_scalar(float *dx, const float *y, const float *dy, int64_t n)
+        {
+            for (int64_t i = 0; i < n; ++i)
+                dx[i] = dy[i] * (y[i] * (1.f - y[i]));
+        }
+
+        void sign_mask_scalar(uint64_t *mask, const float *x, int64_t n)
+        {
+            for (int64_t i0 = 0; i0 < n; i0 += 64)
+            {
+                const int64_t m = n - i0 < 64 ? n - i0 : 64;
+                uint64_t bits = 0;
+                for (int64_t j = 0; j < m; ++j)
+                    bits |= uint64_t(x[i0 + j] > 0.f) << j;
+                mask[i0 >> 6] = bits;
+            }
+        }
+        // Elements [i, n); the SIMD versions finish their tails through this.
+        inline void mask_backward_tail(float *dx, const uint64_t *mask, const float *dy, float neg_slope, int64_t i, int64_t n)
+        {
+            for (; i < n; ++i)
+                dx[i] = dy[i] * ((mask[i >> 6] >> (i & 63)) & 1 ? 1.f : neg_slope);
+        }
+        void mask_backward_scalar(float *dx, const uint64_t *mask, const float *dy, float neg_slope, int64_t n)
+        {
+            mask_backward_tail(dx, mask, dy, neg_slope, 0, n);
+        }
+
+        // Element i hashes seed + i * golden ratio through the lowbias32 finaliser. The
+        // top bit picks the crossover parent; for mutation, bits 8..31 against a 24-bit
+        // threshold decide whether to perturb and a second hash gives two 16-bit uniforms,
+        // whose centred sum scaled to unit variance is the (triangular) noise.
+        constexpr uint32_t kGolden = 0x9E3779B9u;
+        constexpr uint32_t kMix1 = 0x7feb352du;
+        constexpr uint32_t kMix2 = 0x846ca68bu;
+        constexpr uint32_t kNoiseSalt = 0x68e31da4u;
+        constexpr float kNoiseScale = 2.44948974f / 65536.f; // sqrt(6) / 2^16
+
+        inline uint32_t mix32(uint32_t x)
+        {
+            x ^= x >> 16;
+            x *= kMix1;
+            x ^= x >> 15;
+            x *= kMix2;
+            return x ^ (x >> 16);
+        }
+        inline int32_t mutate_threshold(float rate)
+        {
+            if (!(rate > 0.f))
+                return 0;
+            return rate >= 1.f ? int32_t(1) << 24 : int32_t(rate * 16777216.f);
+        }
+        inline void crossover_tail(float *dst, const float *a, const float *b, uint32_t seed, int64_t i, int64_t n)
+        {
+            for (; i < n; ++i)
+                dst[i] = (mix32(seed + uint32_t(i) * kGolden) >> 31) ? a[i] : b[i];
+        }
+        inline void mutate_tail(float *w, int32_t threshold, float sigma, uint32_t seed, int64_t i, int64_t n)
+        {
+            for (; i < n; ++i)
+            {
+                const uint32_t h = mix32(seed + uint32_t(i) * kGolden);
+                const uint32_t r = mix32(h ^ kNoiseSalt);
+                const float noise = (float(int32_t(r & 0xffffu)) + float(int32_t(r >> 16)) - 65535.f) * kNoiseScale;
+                w[i] += int32_t(h >> 8) < threshold ? sigma * noise : 0.f;
+            }
+        }
+        void crossover_scalar(float *dst, const float *a, const float *b, uint32_t seed, int64_t n)
+        {
+            crossover_tail(dst, a, b, seed, 0, n);
+        }
+        void mutate_scalar(float *w, float rate, float sigma, uint32_t seed, int64_t n)
+        {
+            mutate_tail(w, mutate_threshold(rate), sigma, seed, 0, n);
+        }
+
+        const Kernels kScalar = {
+            Isa::Scalar, "scalar",
+            add_scalar, sub_scalar, mul_scalar, axpy_scalar,
+            relu_scalar, leaky_relu_scalar, sigmoid_scalar,
+            relu_backward_scalar, leaky_relu_backward_scalar, sigmoid_backward_scalar,
+            sign_mask_scalar, mask_backward_scalar,
+            crossover_scalar, mutate_scalar};
+
+#if GNE_SIMD_X86
+        // exp(x) for x <= 0 (Cephes expf): x = n*ln2 + r, exp(r) by a degree-5 polynomial,
+        // then scale by 2^n through the exponent bits. Relative error ~1e-7 over [-87, 0].
+        constexpr float kExpLo = -87.3365f;
+        constexpr float kLog2e = 1.44269504088896341f;
+        constexpr float kLn2Hi = 0.693359375f;
+        constexpr float kLn2Lo = -2.12194440e-4f;
+        constexpr float kP0 = 1.9875691500e-4f;
+        constexpr float kP1 = 1.3981999507e-3f;
+        constexpr float kP2 = 8.3334519073e-3f;
+        constexpr float kP3 = 4.1665795894e-2f;
+        constexpr float kP4 = 1.6666665459e-1f;
+        constexpr float kP5 = 5.0000001201e-1f;
+
+        // ---------- SSE4.2 ----------
+
+#define GNE_SSE __attribute__((target("sse4.2")))
+
+        GNE_SSE inline __m128 exp_neg_sse(__m128 x)
+        {
+            x = _mm_max_ps(x, _mm_set1_ps(kExpLo));
+            __m128 fx = _mm_round_ps(_mm_mul_ps(x, _mm_set1_ps(kLog2e)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+            __m128 r = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(kLn2Hi)));
+            r = _mm_sub_ps(r, _mm_mul_ps(fx, _mm_set1_ps(kLn2Lo)));
+            __m128 r2 = _mm_mul_ps(r, r);
+            __m128 y = _mm_set1_ps(kP0);
+            y = _mm_add_ps(_mm_mul_ps(y, r), _mm_set1_ps(kP1));
+            y = _mm_add_ps(_mm_mul_ps(y, r), _mm_set1_ps(kP2));
+            y = _mm_add_ps(_mm_mul_ps(y, r), _mm_set1_ps(kP3));
+            y = _mm_add_ps(_mm_mul_ps(y, r), _mm_set1_ps(kP4));
+            y = _mm_add_ps(_mm_mul_ps(y, r), _mm_set1_ps(kP5));
+            y = _mm_add_ps(_mm_mul_ps(y, r2), _mm_add_ps(r, _mm_set1_ps(1.f)));
+            __m128i e = _mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(fx), _mm_set1_epi32(127)), 23);
+            return _mm_mul_ps(y, _mm_castsi128_ps(e));
+        }
+
+        // sigmoid(x) = 1/(1+e) for x >= 0, e/(1+e) otherwise, with e = exp(-|x|).
+        GNE_SSE inline __m128 sigmoid_sse4(__m128 x)
+        {
+            __m128 ax = _mm_andnot_ps(_mm_set1_ps(-0.f), x);
+            __m128 e = exp_neg_sse(_mm_sub_ps(_mm_setzero_ps(), ax));
+            __m128 inv = _mm_div_ps(_mm_set1_ps(1.f), _mm_add_ps(_mm_set1_ps(1.f), e));
+            __m128 neg = _mm_cmplt_ps(x, _mm_setzero_ps());
+            return _mm_blendv_ps(inv, _mm_mul_ps(e, inv), neg);
+        }
+
+        GNE_SSE void add_sse(float *dst, const float *a, const float *b, int64_t n)
+        {
+            int64_t i = 0;
+            for (; i + 4 <= n; i += 4)
+                _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+            add_scalar(dst + i, a + i, b + i, n - i);
+        }
+        GNE_SSE void sub_sse(float *dst, const float *a, const float *b, int64_t n)
+        {
+            int64_t i = 0;
+            for (; i + 4 <= n; i += 4)
+                _mm_storeu_ps(dst + i, _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+            sub_scalar(dst + i, a + i, b + i, n - i);
+        }
+        GNE_SSE void mul_sse(float *dst, const float *a, const float *b, int64_t n)
+        {
+            int64_t i = 0;
+            for (; i + 4 <= n; i += 4)
+                _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+            mul_scalar(dst + i, a + i, b + i, n - i);
+        }
+        GNE_SSE void axpy_sse(float *y, float alpha, const float *x, int64_t n)
+        {
+            const __m128 va = _mm_set1_ps(alpha);
+            int64_t i = 0;
+            for (; i + 4 <= n; i += 4)
+                _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(va, _mm_loadu_ps(x + i))));
+            axpy_scalar(y + i, alpha, x + i, n - i);
+        }
+        GNE_SSE void relu_sse(float *dst, const float *x, int64_t n)
+        {
+            const __m128 z = _mm_setzero_ps();
+            int64_t i = 0;
+            for (; i + 4 <= n; i += 4)
+                _mm_storeu_ps(dst + i, _mm_max_ps(_mm_loadu_ps(x + i), z));
+            relu_scalar(dst + i, x + i, n - i);
+        }
+        GNE_SSE void leaky_relu_sse(float *dst, const float *x, float alpha, int64_t n)
+        {
+            const __m128 z = _mm_setzero_ps(), va = _mm_set1_ps(alpha);
+            int64_t i = 0;
+            for (; i + 4 <= n; i += 4)
+            {
+                __m128 v = _mm_loadu_ps(x + i);
+                _mm_storeu_ps(dst + i, _mm_blendv_ps(_mm_mul_ps(va, v), v, _mm_cmpgt_ps(v, z)));
+            }
+            leaky_relu_scalar(dst + i, x + i, alpha, n - i);
+        }
+        GNE_SSE void sigmoid_sse(float *dst, const float *x, int64_t n)
+        {
+            int64_t i = 0;
+            for (; i + 4 <= n; i += 4)
+                _mm_storeu_ps(dst + i, sigmoid_sse4(_mm_loadu_ps(x + i)));
+            sigmoid_scalar(dst + i, x + i, n - i);
+        }
+        GNE_SSE void relu_backward_sse(float *dx, const float *x, const float *dy, int64_t n)
+        {
+            const __m128 z = _mm_setzero_ps();
+            int64_t i = 0;
+            for (; i + 4 <= n; i += 4)
+                _mm_storeu_ps(dx + i, _mm_and_ps(_mm_cmpgt_ps(_mm_loadu_ps(x + i), z), _mm_loadu_ps(dy + i)));
+            relu_backward_scalar(dx + i, x + i, dy + i, n - i);
+        }
+        GNE_SSE void leaky_relu_backward_sse(float *dx, const float *x, const float *dy, float alpha, int64_t n)
+        {
+            const __m128 z = _mm_setzero_ps(), one = _mm_set1_ps(1.f), va = _mm_set1_ps(alpha);
+            int64_t i = 0;
+            for (; i + 4 <= n; i += 4)
+            {
+                __m128 slope = _mm_blendv_ps(va, one, _mm_cmpgt_ps(_mm_loadu_ps(x + i), z));
+                _mm_storeu_ps(dx + i, _mm_mul_ps(_mm_loadu_ps(dy + i), slope));
+            }
+            leaky_relu_backward_scalar(dx + i, x + i, dy + i, alpha, n - i);
+        }
+        GNE_SSE void sigmoid_backward_sse(float *dx, const float *y, const float *dy, int64_t n)
+        {
+            const __m128 one = _mm_set1_ps(1.f);
+            int64_t i = 0;
+            for (; i + 4 <= n; i += 4)
+            {
+                __m128 v = _mm_loadu_ps(y + i);
+                _mm_storeu_ps(dx + i, _mm_mul_ps(_mm_loadu_ps(dy + i), _mm_mul_ps(v, _mm_sub_ps(one, v))));
+            }
+            sigmoid_backward_scalar(dx + i, y + i, dy + i, n - i);
+        }
+
+        GNE_SSE void sign_mask_sse(uint64_t *mask, const float *x, int64_t n)
+        {
+            const __m128 z = _mm_setzero_ps();
+            int64_t i0 = 0;
+            for (; i0 + 64 <= n; i0 += 64)
+            {
+                uint64_t bits = 0;
+                for (int k = 0; k < 16; ++k)
+                    bits |= uint64_t(_mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(x + i0 + 4 * k), z))) << (4 * k);
+                mask[i0 >> 6] = bits;
+            }
+            sign_mask_scalar(mask + (i0 >> 6), x + i0, n - i0);
+        }
+        GNE_SSE void mask_backward_sse(float *dx, const uint64_t *mask, const float *dy, float neg_slope, int64_t n)
+        {
+            const __m128i sel = _mm_setr_epi32(1, 2, 4, 8);
+            const __m128 vs = _mm_set1_ps(neg_slope);
+            int64_t i = 0;
+            for (; i + 4 <= n; i += 4)
+            {
+                const int b = int((mask[i >> 6] >> (i & 63)) & 0xF);
+                const __m128i lanes = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(b), sel), sel);
+                const __m128 g = _mm_loadu_ps(dy + i);
+                _mm_storeu_ps(dx + i, _mm_blendv_ps(_mm_mul_ps(g, vs), g, _mm_castsi128_ps(lanes)));
+            }
+            mask_backward_tail(dx, mask, dy, neg_slope, i, n);
+        }
+
+        GNE_SSE inline __m128i mix32_sse(__m128i x)
+        {
+            x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+            x = _mm_mullo_epi32(x, _mm_set1_epi32(int(kMix1)));
+            x = _mm_xor_si128(x, _mm_srli_epi32(x, 15));
+            x = _mm_mullo_epi32(x, _mm_set1_epi32(int(kMix2)));
+            return _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+        }
+        // Hashes of elements i..i+3.
+        GNE_SSE inline __m128i hash4_sse(uint32_t seed, int64_t i)
+        {
+            const __m128i idx = _mm_add_epi32(_mm_set1_epi32(int(uint32_t(i))), _mm_setr_epi32(0, 1, 2, 3));
+            return mix32_sse(_mm_add_epi32(_mm_set1_epi32(int(seed)), _mm_mullo_epi32(idx, _mm_set1_epi32(int(kGolden)))));
+        }
+        GNE_SSE void crossover_sse(float *dst, const float *a, const float *b, uint32_t seed, int64_t n)
+        {
+            int64_t i = 0;
+            for (; i + 4 <= n; i += 4)
+            {
+                const __m128 pickA = _mm_castsi128_ps(hash4_sse(seed, i)); // blendv reads the top bit
+                _mm_storeu_ps(dst + i, _mm_blendv_ps(_mm_loadu_ps(b + i), _mm_loadu_ps(a + i), pickA));
+            }
+            crossover_tail(dst, a, b, seed, i, n);
+        }
+        GNE_SSE void mutate_sse(float *w, float rate, float sigma, uint32_t seed, int64_t n)
+        {
+            const int32_t threshold = mutate_threshold(rate);
+            const __m128i vt = _mm_set1_epi32(threshold), lo16 = _mm_set1_epi32(0xffff), salt = _mm_set1_epi32(int(kNoiseSalt));
+            const __m128 vs = _mm_set1_ps(sigma), centre = _mm_set1_ps(65535.f), scale = _mm_set1_ps(kNoiseScale);
+            int64_t i = 0;
+            for (; i + 4 <= n; i += 4)
+            {
+                const __m128i h = hash4_sse(seed, i);
+                const __m128i r = mix32_sse(_mm_xor_si128(h, salt));
+                const __m128 u = _mm_add_ps(_mm_cvtepi32_ps(_mm_and_si128(r, lo16)), _mm_cvtepi32_ps(_mm_srli_epi32(r, 16)));
+                const __m128 step = _mm_mul_ps(vs, _mm_mul_ps(_mm_sub_ps(u, centre), scale));
+                const __m128 hit = _mm_castsi128_ps(_mm_cmpgt_epi32(vt, _mm_srli_epi32(h, 8)));
+                _mm_storeu_ps(w + i, _mm_add_ps(_mm_loadu_ps(w + i), _mm_and_ps(hit, step)));
+            }
+            mutate_tail(w, threshold, sigma, seed, i, n);
+        }
+
+#undef GNE_SSE
+
+        const Kernels kSSE42 = {
+            Isa::SSE42, "sse4.2",
+            add_sse, sub_sse, mul_sse, axpy_sse,
+            relu_sse, leaky_relu_sse, sigmoid_sse,
+            relu_backward_sse, leaky_relu_backward_sse, sigmoid_backward_sse,
+            sign_mask_sse, mask_backward_sse,
+            crossover_sse, mutate_sse};
+
+        // ---------- AVX2 / FMA ----------
+
+#define GNE_AVX2 __attribute__((target("avx2,fma")))
+
+        GNE_AVX2 inline __m256 exp_neg_avx2(__m256 x)
+        {
+            x = _mm256_max_ps(x, _mm256_set1_ps(kExpLo));
+            __m256 fx = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(kLog2e)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+            __m256 r = _mm256_fnmadd_ps(fx, _mm256_set1_ps(kLn2Hi), x);
+            r = _mm256_fnmadd_ps(fx, _mm256_set1_ps(kLn2Lo), r);
+            __m256 r2 = _mm256_mul_ps(r, r);
+            __m256 y = _mm256_set1_ps(kP0);
+            y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(kP1));
+            y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(kP2));
+            y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(kP3));
+            y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(kP4));
+            y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(kP5));
+            y = _mm256_fmadd_ps(y, r2, _mm256_add_ps(r, _mm256_set1_ps(1.f)));
+            __m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(fx), _mm256_set1_epi32(127)), 23);
+            return _mm256_mul_ps(y, _mm256_castsi256_ps(e));
+        }
+
+        GNE_AVX2 inline __m256 sigmoid_avx(__m256 x)
+        {
+            __m256 ax = _mm256_andnot_ps(_mm256_set1_ps(-0.f), x);
+            __m256 e = exp_neg_avx2(_mm256_sub_ps(_mm256_setzero_ps(), ax));
+            __m256 inv = _mm256_div_ps(_mm256_set1_ps(1.f), _mm256_add_ps(_mm256_set1_ps(1.f), e));
+            __m256 neg = _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ);
+            return _mm256_blendv_ps(inv, _mm256_mul_ps(e, inv), neg);
+        }
+
+        GNE_AVX2 void add_avx2(float *dst, const float *a, const float *b, int64_t n)
+        {
+            int64_t i = 0;
+            for (; i + 8 <= n; i += 8)
+                _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+            add_scalar(dst + i, a + i, b + i, n - i);
+        }
+        GNE_AVX2 void sub_avx2(float *dst, const float *a, const float *b, int64_t n)
+        {
+            int64_t i = 0;
+            for (; i + 8 <= n; i += 8)
+                _mm256_storeu_ps(dst + i, _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+            sub_scalar(dst + i, a + i, b + i, n - i);
+        }
+        GNE_AVX2 void mul_avx2(float *dst, const float *a, const float *b, int64_t n)
+        {
+            int64_t i = 0;
+            for (; i + 8 <= n; i += 8)
+                _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+            mul_scalar(dst + i, a + i, b + i, n - i);
+        }
+        GNE_AVX2 void axpy_avx2(float *y, float alpha, const float *x, int64_t n)
+        {
+            const __m256 va = _mm256_set1_ps(alpha);
+            int64_t i = 0;
+            for (; i + 8 <= n; i += 8)
+                _mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+            axpy_scalar(y + i, alpha, x + i, n - i);
+        }
+        GNE_AVX2 void relu_avx2(float *dst, const float *x, int64_t n)
+        {
+            const __m256 z = _mm256_setzero_ps();
+            int64_t i = 0;
+            for (; i + 8 <= n; i += 8)
+                _mm256_storeu_ps(dst + i, _mm256_max_ps(_mm256_loadu_ps(x + i), z));
+            relu_scalar(dst + i, x + i, n - i);
+        }
+        GNE_AVX2 void leaky_relu_avx2(float *dst, const float *x, float alpha, int64_t n)
+        {
+            const __m256 z = _mm256_setzero_ps(), va = _mm256_set1_ps(alpha);
+            int64_t i = 0;
+            for (; i + 8 <= n; i += 8)
+            {
+                __m256 v = _mm256_loadu_ps(x + i);
+                _mm256_storeu_ps(dst + i, _mm256_blendv_ps(_mm256_mul_ps(va, v), v, _mm256_cmp_ps(v, z, _CMP_GT_OQ)));
+            }
+            leaky_relu_scalar(dst + i, x + i, alpha, n - i);
+        }
+        GNE_AVX2 void sigmoid_avx2(float *dst, const float *x, int64_t n)
+        {
+            int64_t i = 0;
+            for (; i + 8 <= n; i += 8)
+                _mm256_storeu_ps(dst + i, sigmoid_avx(_mm256_loadu_ps(x + i)));
+            sigmoid_scalar(dst + i, x + i, n - i);
+        }
+        GNE_AVX2 void relu_backward_avx2(float *dx, const float *x, const float *dy, int64_t n)
+        {
+            const __m256 z = _mm256_setzero_ps();
+            int64_t i = 0;
+            for (; i + 8 <= n; i += 8)
+                _mm256_storeu_ps(dx + i, _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(x + i), z, _CMP_GT_OQ), _mm256_loadu_ps(dy + i)));
+            relu_backward_scalar(dx + i, x + i, dy + i, n - i);
+        }
+        GNE_AVX2 void leaky_relu_backward_avx2(float *dx, const float *x, const float *dy, float alpha, int64_t n)
+        {
+            const __m256 z = _mm256_setzero_ps(), one = _mm256_set1_ps(1.f), va = _mm256_set1_ps(alpha);
+            int64_t i = 0;
+            for (; i + 8 <= n; i += 8)
+            {
+                __m256 slope = _mm256_blendv_ps(va, one, _mm256_cmp_ps(_mm256_loadu_ps(x + i), z, _CMP_GT_OQ));
+                _mm256_storeu_ps(dx + i, _mm256_mul_ps(_mm256_loadu_ps(dy + i), slope));
+            }
+            leaky_relu_backward_scalar(dx + i, x + i, dy + i, alpha, n - i);
+        }
+        GNE_AVX2 void sigmoid_backward_avx2(float *dx, const float *y, const float *dy, int64_t n)
+        {
+            const __m256 one = _mm256_set1_ps(1.f);
+            int64_t i = 0;
+            for (; i + 8 <= n; i += 8)
+            {
+                __m256 v = _mm256_loadu_ps(y + i);
+                _mm256_storeu_ps(dx + i, _mm256_mul_ps(_mm256_loadu_ps(dy + i), _mm256_mul_ps(v, _mm256_sub_ps(one, v))));
+            }
+            sigmoid_backward_scalar(dx + i, y + i, dy + i, n - i);
+        }
+
+        GNE_AVX2 void sign_mask_avx2(uint64_t *mask, const float *x, int64_t n)
+        {
+            const __m256 z = _mm256_setzero_ps();
+            int64_t i0 = 0;
+            for (; i0 + 64 <= n; i0 += 64)
+            {
+                uint64_t bits = 0;
+                for (int k = 0; k < 8; ++k)
+                    bits |= uint64_t(_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(x + i0 + 8 * k), z, _CMP_GT_OQ))) << (8 * k);
+                mask[i0 >> 6] = bits;
+            }
+            sign_mask_scalar(mask + (i0 >> 6), x + i0, n - i0);
+        }
+        GNE_AVX2 void mask_backward_avx2(float *dx, const uint64_t *mask, const float *dy, float neg_slope, int64_t n)
+        {
+            const __m256i sel = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+            const __m256 vs = _mm256_set1_ps(neg_slope);
+            int64_t i = 0;
+            for (; i + 8 <= n; i += 8)
+            {
+                const int b = int((mask[i >> 6] >> (i & 63)) & 0xFF);
+                const __m256i lanes = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(b), sel), sel);
+                const __m256 g = _mm256_loadu_ps(dy + i);
+                _mm256_storeu_ps(dx + i, _mm256_blendv_ps(_mm256_mul_ps(g, vs), g, _mm256_castsi256_ps(lanes)));
+            }
+            mask_backward_tail(dx, mask, dy, neg_slope, i, n);
+        }
+
+        GNE_AVX2 inline __m256i mix32_avx2(__m256i x)
+        {
+            x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+            x = _mm256_mullo_epi32(x, _mm256_set1_epi32(int(kMix1)));
+            x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 15));
+            x = _mm256_mullo_epi32(x, _mm256_set1_epi32(int(kMix2)));
+            return _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+        }
+        // Hashes of elements i..i+7.
+        GNE_AVX2 inline __m256i hash8_avx2(uint32_t seed, int64_t i)
+        {
+            const __m256i idx = _mm256_add_epi32(_mm256_set1_epi32(int(uint32_t(i))), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+            return mix32_avx2(_mm256_add_epi32(_mm256_set1_epi32(int(seed)), _mm256_mullo_epi32(idx, _mm256_set1_epi32(int(kGolden)))));
+        }
+        GNE_AVX2 void crossover_avx2(float *dst, const float *a, const float *b, uint32_t seed, int64_t n)
+        {
+            int64_t i = 0;
+            for (; i + 8 <= n; i += 8)
+            {
+                const __m256 pickA = _mm256_castsi256_ps(hash8_avx2(seed, i)); // blendv reads the top bit
+                _mm256_storeu_ps(dst + i, _mm256_blendv_ps(_mm256_loadu_ps(b + i), _mm256_loadu_ps(a + i), pickA));
+            }
+            crossover_tail(dst, a, b, seed, i, n);
+        }
+        GNE_AVX2 void mutate_avx2(float *w, float rate, float sigma, uint32_t seed, int64_t n)
+        {
+            const int32_t threshold = mutate_threshold(rate);
+            const __m256i vt = _mm256_set1_epi32(threshold), lo16 = _mm256_set1_epi32(0xffff), salt = _mm256_set1_epi32(int(kNoiseSalt));
+            const __m256 vs = _mm256_set1_ps(sigma), centre = _mm256_set1_ps(65535.f), scale = _mm256_set1_ps(kNoiseScale);
+            int64_t i = 0;
+            for (; i + 8 <= n; i += 8)
+            {
+                const __m256i h = hash8_avx2(seed, i);
+                const __m256i r = mix32_avx2(_mm256_xor_si256(h, salt));
+                const __m256 u = _mm256_add_ps(_mm256_cvtepi32_ps(_mm256_and_si256(r, lo16)), _mm256_cvtepi32_ps(_mm256_srli_epi32(r, 16)));
+                // mul then add, not fma, so the result matches the scalar and SSE paths
+                const __m256 step = _mm256_mul_ps(vs, _mm256_mul_ps(_mm256_sub_ps(u, centre), scale));
+                const __m256 hit = _mm256_castsi256_ps(_mm256_cmpgt_epi32(vt, _mm256_srli_epi32(h, 8)));
+                _mm256_storeu_ps(w + i, _mm256_add_ps(_mm256_loadu_ps(w + i), _mm256_and_ps(hit, step)));
+            }
+            mutate_tail(w, threshold, sigma, seed, i, n);
+        }
+
+#undef GNE_AVX2
+
+        const Kernels kAVX2 = {
+            Isa::AVX2, "avx2+fma",
+            add_avx2, sub_avx2, mul_avx2, axpy_avx2,
+            relu_avx2, leaky_relu_avx2, sigmoid_avx2,
+            relu_backward_avx2, leaky_relu_backward_avx2, sigmoid_backward_avx2,
+            sign_mask_avx2, mask_backward_avx2,
+            crossover_avx2, mutate_avx2};
+#endif // GNE_SIMD_X86
+
+        bool cpu_has(Isa isa)
+        {
+#if GNE_SIMD_X86
+            __builtin_cpu_init();
+            switch (isa)
+            {
+            case Isa::Scalar:
+                return true;
+            case Isa::SSE42:
+                return __builtin_cpu_supports("sse4.2");
+            case Isa::AVX2:
+                return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+            }
+            return false;
+#else
+            return isa == Isa::Scalar;
+#endif
+        }
+
+        const Kernels &resolve()
+        {
+            Isa cap = Isa::AVX2;
+            if (const char *env = std::getenv("GNE_SIMD"))
+            {
+                if (std::strcmp(env, "scalar") == 0)
+                    cap = Isa::Scalar;
+                else if (std::strcmp(env, "sse4.2") == 0)
+                    cap = Isa::SSE42;
+            }
+            for (Isa isa : {Isa::AVX2, Isa::SSE42})
+            {
+                if (int(isa) > int(cap))
+                    continue;
+                if (const Kernels *k = kernels_for(isa))
+                    return *k;
+            }
+            return kScalar;
+        }
+    } // namespace
+
+    const Kernels *kernels_for(Isa isa)
+    {
+        if (!cpu_has(isa))
+            return nullptr;
+        switch (isa)
+        {
+        case Isa::Scalar:
+            return &kScalar;
+#if GNE_SIMD_X86
+        case Isa::SSE42:
+            return &kSSE42;
+        case Isa::AVX2:
+            return &kAVX2;
+#else
+        default:
+            return nullptr;
+#endif
+        }
+        return nullptr;
+    }
+
+    const Kernels &kernels()
+    {
+        static const Kernels &k = resolve();
+        return k;
+    }
+
+    const char *isa_name(Isa isa)
+    {
+        switch (isa)
+        {
+        case Isa::Scalar:
+            return "scalar";
+        case Isa::SSE42:
+            return "sse4.2";
+        case Isa::AVX2:
+            return "avx2+fma";
+        }
+        return "?";
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+
+// Vectorized elementwise kernels with a runtime-selected instruction set.
+// The table is resolved once from CPUID, so one binary runs the AVX2/FMA path on
+// newer x86 boxes, SSE4.2 on older ones and plain C++ everywhere else.
+// Set GNE_SIMD=scalar|sse4.2|avx2 to force a lower path (e.g. for benchmarking).
+namespace simd
+{
+    enum class Isa
+    {
+        Scalar,
+        SSE42,
+        AVX2
+    };
+
+    struct Kernels
+    {
+        Isa isa;
+        const char *name;
+
+        // dst = a (op) b
+        void (*add)(float *dst, const float *a, const float *b, int64_t n);
+        void (*sub)(float *dst, const float *a, const float *b, int64_t n);
+        void (*mul)(float *dst, const float *a, const float *b, int64_t n);
+        // y += alpha * x   (SGD: w += -lr * dw)
+        void (*axpy)(float *y, float alpha, const float *x, int64_t n);
+
+        // activations, forward: dst = f(x)
+        void (*relu)(float *dst, const float *x, int64_t n);
+        void (*leaky_relu)(float *dst, const float *x, float alpha, int64_t n);
+        void (*sigmoid)(float *dst, const float *x, int64_t n);
+
+        // activations, backward: dx = dy * f'(.)
+        void (*relu_backward)(float *dx, const float *x, const float *dy, int64_t n);
+        void (*leaky_relu_backward)(float *dx, const float *x, const float *dy, float alpha, int64_t n);
+        void (*sigmoid_backward)(float *dx, const float *y, const float *dy, int64_t n); // y = sigmoid(x)
+
+        // 1-bit activation masks: bit i of mask[i / 64] is x[i] > 0; unused high bits are zero.
+        // mask_backward: dx = dy where the bit is set, neg_slope * dy elsewhere (0 for ReLU).
+        void (*sign_mask)(uint64_t *mask, const float *x, int64_t n);
+        void (*mask_backward)(float *dx, const uint64_t *mask, const float *dy, float neg_slope, int64_t n);
+
+        // Genetic operators. Element i draws its randomness from a hash of (seed, i), so
+        // the result depends only on the seed, never on the ISA or on threading.
+        // crossover: dst = a or b per element, each with probability 1/2.
+        // mutate: with probability rate, w += sigma * noise of zero mean and unit variance.
+        void (*crossover)(float *dst, const float *a, const float *b, uint32_t seed, int64_t n);
+        void (*mutate)(float *w, float rate, float sigma, uint32_t seed, int64_t n);
+    };
+
+    // Best kernel table supported by this CPU (and allowed by GNE_SIMD).
+    const Kernels &kernels();
+
+    // A specific table, or nullptr if this CPU/build cannot run it.
+    const Kernels *kernels_for(Isa isa);
+
+    const char *isa_name(Isa isa);
+}
@@ -1,12 +1,179 @@
-#include <future>
+#pragma once
 #include <algorithm>
-#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
 #include <functional>
-#include <./ThreadPool.hpp>
+#include <thread>
+#include "./ThreadPool.hpp"
 
+// Fork-join loop: [begin, end) is cut into chunks that are claimed from a shared
+// atomic counter. At most pool.size() helper tasks are forked, the calling thread
+// runs chunks too, and then it waits by running other pending pool tasks. No
+// futures or promises are allocated, and a ParallelFor nested inside a pool task
+// cannot deadlock the pool: a waiting worker keeps executing queued work.
+//
+// fn(s, e) is taken by forwarding reference so lambdas inline into the chunk loop;
+// helpers reference it and the join state on our stack, which is safe because we
+// do not return until every helper has finished.
+//
+// Grain size comes from one of:
+//   desiredTasks/minChunk  fixed split (the original behaviour),
+//   ParallelCost           caller's estimate of the cost of one iteration,
+//   GrainTuner             per-call-site estimate measured on previous calls.
+// With a cost, loops under ~kMinParallelNs run serially and heavier ones are split
+// into chunks of roughly kTargetChunkNs.
+
+// Estimated cost of one iteration of the loop body.
+struct ParallelCost
+{
+    double nsPerItem;
+
+    // Rough single-core throughputs; only the order of magnitude matters.
+    static ParallelCost flops(double flopsPerItem) { return {flopsPerItem * 0.1}; } // ~10 GFLOP/s
+    static ParallelCost bytes(double bytesPerItem) { return {bytesPerItem * 0.1}; } // ~10 GB/s
+};
+
+// Measured cost per iteration for one call site. Keep one as a function-local
+// static next to the loop; the first call times a short serial prefix, later
+// calls refine the estimate from the chunks the calling thread runs.
+class GrainTuner
+{
+public:
+    // Negative until the first measurement.
+    double nsPerItem() const { return mNsPerItem.load(std::memory_order_relaxed); }
+
+    void record(double ns, int64_t items)
+    {
+        if (items <= 0)
+            return;
+        const double sample = ns / double(items);
+        const double old = nsPerItem();
+        mNsPerItem.store(old < 0 ? sample : 0.75 * old + 0.25 * sample, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<double> mNsPerItem{-1.0};
+};
+
+namespace parallel_detail
+{
+    constexpr double kMinParallelNs = 30000;  // below this a fork costs more than it saves
+    constexpr double kTargetChunkNs = 15000;  // large enough to amortise a claim + wake-up
+    constexpr double kProbeNs = 5000;         // how long the tuner's serial probe runs
+    constexpr int kMaxChunksPerThread = 8;
+
+    using Clock = std::chrono::steady_clock;
+
+    inline double elapsedNs(Clock::time_point since)
+    {
+        return double(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - since).count());
+    }
+
+    inline int64_t chunksForCost(ThreadPool &pool, int64_t n, double nsPerItem)
+    {
+        const double total = double(n) * std::max(nsPerItem, 0.0);
+        if (total < kMinParallelNs || pool.size() == 0)
+            return 1;
+        const int64_t maxChunks = int64_t(pool.size()) * kMaxChunksPerThread;
+        return std::max<int64_t>(1, std::min<int64_t>({n, maxChunks, int64_t(total / kTargetChunkNs)}));
+    }
+
+    template <class Fn>
+    inline void forkJoin(ThreadPool &pool, int64_t begin, int64_t end, int64_t numChunks,
+                         Fn &fn, GrainTuner *tuner)
+    {
+        const int64_t N = end - begin;
+        if (numChunks <= 1 || pool.size() == 0)
+        {
+            if (!tuner)
+            {
+                fn(begin, end);
+                return;
+            }
+            auto t0 = Clock::now();
+            fn(begin, end);
+            tuner->record(elapsedNs(t0), N);
+            return;
+        }
+
+        const int64_t chunk = (N + numChunks - 1) / numChunks;
+        numChunks = (N + chunk - 1) / chunk;
+
+        struct Join
+        {
+            std::atomic<int64_t> next{0};
+            std::atomic<int> helpers{0};
+            std::atomic<bool> failed{false};
+            std::exception_ptr error;
+        } join;
+
+        auto runChunks = [&](double *timedNs, int64_t *timedItems)
+        {
+            for (int64_t c = join.next.fetch_add(1, std::memory_order_relaxed); c < numChunks;
+                 c = join.next.fetch_add(1, std::memory_order_relaxed))
+            {
+                if (join.failed.load(std::memory_order_relaxed))
+                    continue;
+                const int64_t s = begin + c * chunk;
+                const int64_t e = std::min<int64_t>(s + chunk, end);
+                try
+                {
+                    if (timedNs)
+                    {
+                        auto t0 = Clock::now();
+                        fn(s, e);
+                        *timedNs += elapsedNs(t0);
+                        *timedItems += e - s;
+                    }
+                    else
+                    {
+                        fn(s, e);
+                    }
+                }
+                catch (...)
+                {
+                    if (!join.failed.exchange(true))
+                        join.error = std::current_exception();
+                }
+            }
+        };
+
+        const int helpers = int(std::min<int64_t>(numChunks - 1, int64_t(pool.size())));
+        join.helpers.store(helpers, std::memory_order_relaxed);
+        for (int h = 0; h < helpers; ++h)
+        {
+            // Two references fit std::function's small buffer: no allocation for the callable.
+            pool.enqueue(std::function<void()>([&join, &runChunks]
+                                               {
+                runChunks(nullptr, nullptr);
+                join.helpers.fetch_sub(1, std::memory_order_release); }));
+        }
+
+        // Only the calling thread's chunks feed the tuner: no shared counters on the hot path.
+        double ns = 0;
+        int64_t items = 0;
+        runChunks(tuner ? &ns : nullptr, tuner ? &items : nullptr);
+
+        while (join.helpers.load(std::memory_order_acquire) > 0)
+        {
+            if (!pool.runPendingTask())
+                std::this_thread::yield();
+        }
+
+        if (tuner)
+            tuner->record(ns, items);
+        if (join.error)
+            std::rethrow_exception(join.error);
+    }
+}
+
+template <class Fn>
 inline void ParallelFor(ThreadPool &pool, int64_t begin, int64_t end,
-                        std::function<void(int64_t, int64_t)> fn,
-                        int desiredTasks = -1)
+                        Fn &&fn,
+                        int desiredTasks = -1,
+                        int64_t minChunk = 8192)
 {
     const int64_t N = end - begin;
     if (N <= 0)
@@ -16,26 +183,53 @@ inline void ParallelFor(ThreadPool &pool, int64_t begin, int64_t end,
     int numTasks = (desiredTasks > 0) ? desiredTasks : threads * 4;
     numTasks = std::max<int64_t>(1, std::min<int64_t>(numTasks, N));
 
-    const int64_t minChunk = 8192; // tweak if needed
     const int maxTasksByGrain = int((N + minChunk - 1) / minChunk);
     if (maxTasksByGrain > 0)
         numTasks = std::min(numTasks, maxTasksByGrain);
 
-    int64_t chunk = (N + numTasks - 1) / numTasks;
+    parallel_detail::forkJoin(pool, begin, end, numTasks, fn, nullptr);
+}
 
-    std::vector<std::future<void>> futures;
-    futures.reserve(numTasks);
+template <class Fn>
+inline void ParallelFor(ThreadPool &pool, int64_t begin, int64_t end, Fn &&fn, ParallelCost cost)
+{
+    if (end <= begin)
+        return;
+    parallel_detail::forkJoin(pool, begin, end, parallel_detail::chunksForCost(pool, end - begin, cost.nsPerItem), fn, nullptr);
+}
 
-    for (int t = 0; t < numTasks; ++t)
-    {
-        int64_t s = begin + t * chunk;
-        int64_t e = std::min<int64_t>(s + chunk, end);
-        if (s >= e)
-            break;
+template <class Fn>
+inline void ParallelFor(ThreadPool &pool, int64_t begin, int64_t end, Fn &&fn, GrainTuner &tuner)
+{
+    using namespace parallel_detail;
+    if (end <= begin)
+        return;
 
-        futures.push_back(pool.enqueue([=]
-                                       { fn(s, e); }));
+    if (tuner.nsPerItem() < 0)
+    {
+        // First call from this site: time a geometrically growing prefix on this thread.
+        auto t0 = Clock::now();
+        int64_t done = 0;
+        for (int64_t step = 1; begin < end; step *= 2)
+        {
+            const int64_t e = std::min(end, begin + step);
+            fn(begin, e);
+            done += e - begin;
+            begin = e;
+            if (elapsedNs(t0) >= kProbeNs)
+                break;
+        }
+        tuner.record(elapsedNs(t0), done);
+        if (begin >= end)
+            return;
     }
-    for (auto &future : futures)
-        future.get();
+    forkJoin(pool, begin, end, chunksForCost(pool, end - begin, tuner.nsPerItem()), fn, &tuner);
+}
+
+inline void ParallelFor(ThreadPool &pool, int64_t begin, int64_t end,
+                        const std::function<void(int64_t, int64_t)> &fn,
+                        int desiredTasks = -1,
+                        int64_t minChunk = 8192)
+{
+    ParallelFor<const std::function<void(int64_t, int64_t)> &>(pool, begin, end, fn, desiredTasks, minChunk);
 }
@@ -0,0 +1,148 @@
+#include "SpatialGrid.hpp"
+
+#include <limits>
+#include <stdexcept>
+
+#include "./ParallelFor.h"
+
+namespace sim
+{
+
+    SpatialGrid::SpatialGrid(float width, float height, float cellSize)
+        : cell_(cellSize), inv_(1.f / cellSize)
+    {
+        if (!(cellSize > 0.f) || !(width > 0.f) || !(height > 0.f))
+            throw std::invalid_argument("SpatialGrid needs a positive size and cell size");
+        cols_ = std::max(1, int(std::ceil(width / cellSize)));
+        rows_ = std::max(1, int(std::ceil(height / cellSize)));
+        cellStart_.assign(size_t(cols_) * rows_ + 1, 0);
+    }
+
+    void SpatialGrid::build(ThreadPool &pool, const float *x, const float *y, size_t n)
+    {
+        if (n > std::numeric_limits<uint32_t>::max())
+            throw std::length_error("SpatialGrid indexes at most 2^32 - 1 points");
+        const size_t cells = size_t(cols_) * rows_;
+        keys_.resize(n);
+        order_.resize(n);
+        xs_.resize(n);
+        ys_.resize(n);
+
+        // Each chunk histograms its own points, so counting needs no atomics, and later
+        // scatters them in index order, so the sort is stable. Every chunk costs a
+        // histogram of all cells, which the prefix pass below walks serially, so a grid
+        // with more cells than points gets a single chunk.
+        const int64_t chunks = std::max<int64_t>(
+            1, std::min({int64_t(std::max<size_t>(pool.size(), 1)), int64_t(n / 16384), int64_t(n / cells)}));
+        const size_t per = (n + size_t(chunks) - 1) / size_t(chunks);
+        counts_.assign(size_t(chunks) * cells, 0);
+
+        ParallelFor(pool, 0, chunks, [&](int64_t s, int64_t e)
+                    {
+            for (int64_t t = s; t < e; ++t)
+            {
+                uint32_t *hist = counts_.data() + size_t(t) * cells;
+                for (size_t i = size_t(t) * per, end = std::min(n, i + per); i < end; ++i)
+                {
+                    const uint32_t key = cellOf(x[i], y[i]);
+                    keys_[i] = key;
+                    ++hist[key];
+                }
+            } }, int(chunks), 1);
+
+        // Cell c starts after every smaller cell; within it, chunk t's points follow
+        // those of chunks 0..t-1. The histograms become each chunk's next free slot.
+        uint32_t run = 0;
+        for (size_t c = 0; c < cells; ++c)
+        {
+            cellStart_[c] = run;
+            for (int64_t t = 0; t < chunks; ++t)
+            {
+                uint32_t &slot = counts_[size_t(t) * cells + c];
+                const uint32_t count = slot;
+                slot = run;
+                run += count;
+            }
+        }
+        cellStart_[cells] = run;
+
+        ParallelFor(pool, 0, chunks, [&](int64_t s, int64_t e)
+                    {
+            for (int64_t t = s; t < e; ++t)
+            {
+                uint32_t *next = counts_.data() + size_t(t) * cells;
+                for (size_t i = size_t(t) * per, end = std::min(n, i + per); i < end; ++i)
+                {
+                    const uint32_t k = next[keys_[i]]++;
+                    order_[k] = uint32_t(i);
+                    xs_[k] = x[i];
+                    ys_[k] = y[i];
+                }
+            } }, int(chunks), 1);
+    }
+
+    size_t SpatialGrid::countWithin(float qx, float qy, float radius) const
+    {
+        size_t count = 0;
+        const float r2 = radius * radius;
+        scanRows(qx, qy, radius, [&](uint32_t k)
+                 {
+            const float dx = xs_[k] - qx, dy = ys_[k] - qy;
+            count += dx * dx + dy * dy <= r2; });
+        return count;
+    }
+
+    int64_t SpatialGrid::nearestSlot(float qx, float qy, float radius, int64_t excludeSlot) const
+    {
+        int64_t best = -1;
+        // Strictly closer than this; nextafter keeps points exactly on the radius.
+        float bestD2 = std::nextafter(radius * radius, std::numeric_limits<float>::infinity());
+        const int cx0 = cellCoord(qx - radius, cols_), cx1 = cellCoord(qx + radius, cols_);
+        const int cy0 = cellCoord(qy - radius, rows_), cy1 = cellCoord(qy + radius, rows_);
+        for (int cy = cy0; cy <= cy1; ++cy)
+        {
+            const int64_t end = cellStart_[size_t(cy) * cols_ + cx1 + 1];
+            for (int64_t k = cellStart_[size_t(cy) * cols_ + cx0]; k < end; ++k)
+            {
+                const float dx = xs_[size_t(k)] - qx, dy = ys_[size_t(k)] - qy;
+                const float d2 = dx * dx + dy * dy;
+                if (d2 < bestD2 && k != excludeSlot)
+                {
+                    best = k;
+                    bestD2 = d2;
+                }
+            }
+        }
+        return best;
+    }
+
+    int64_t SpatialGrid::nearest(float qx, float qy, float radius, int64_t exclude) const
+    {
+        int64_t best = -1;
+        float bestD2 = std::nextafter(radius * radius, std::numeric_limits<float>::infinity());
+        scanRows(qx, qy, radius, [&](uint32_t k)
+                 {
+            const float dx = xs_[k] - qx, dy = ys_[k] - qy;
+            const float d2 = dx * dx + dy * dy;
+            if (d2 < bestD2 && int64_t(order_[k]) != exclude)
+            {
+                best = order_[k];
+                bestD2 = d2;
+            } });
+        return best;
+    }
+
+    void SpatialGrid::nearestAll(ThreadPool &pool, const float *radius, int64_t *out) const
+    {
+        static GrainTuner tuner;
+        ParallelFor(pool, 0, int64_t(size()), [&](int64_t s, int64_t e)
+                    {
+            for (int64_t k = s; k < e; ++k)
+            {
+                const uint32_t i = order_[size_t(k)];
+                const int64_t slot = nearestSlot(xs_[size_t(k)], ys_[size_t(k)], radius[i], k);
+                out[i] = slot < 0 ? -1 : int64_t(order_[size_t(slot)]);
+            } }, tuner);
+    }
+
+} // namespace sim
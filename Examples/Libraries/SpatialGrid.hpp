@@ -0,0 +1,103 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "./ThreadPool.hpp"
+
+namespace sim
+{
+
+    // Uniform-grid index over 2D points for radius queries (sight, attack reach, mates).
+    //
+    // build() buckets the points by cell with a counting sort: count per cell, prefix
+    // sum, scatter. Cells are numbered row-major, so the cells a query touches in one
+    // grid row are adjacent in the sorted arrays and a query scans one contiguous run
+    // per row. Coordinates are copied in sorted order next to the indices, so the scan
+    // reads no memory outside those runs. Every buffer is kept between builds, so
+    // rebuilding each tick allocates nothing once the population stops growing.
+    //
+    // Pick the cell size near the usual query radius: a radius r query visits about
+    // (2r / cell + 1)^2 cells.
+    class SpatialGrid
+    {
+    public:
+        SpatialGrid(float width, float height, float cellSize);
+
+        // Points outside [0, width] x [0, height] are clamped into the border cells; a
+        // point with a NaN coordinate is filed in the first column or row and is never
+        // within any query's radius.
+        void build(ThreadPool &pool, const float *x, const float *y, size_t n);
+
+        size_t size() const { return order_.size(); }
+        int cols() const { return cols_; }
+        int rows() const { return rows_; }
+        float cellSize() const { return cell_; }
+
+        // Calls fn(index) for every point within radius of (qx, qy), itself included
+        // if (qx, qy) is one of the points. Indices are those passed to build().
+        template <class Fn>
+        void forEachWithin(float qx, float qy, float radius, Fn &&fn) const
+        {
+            const float r2 = radius * radius;
+            scanRows(qx, qy, radius, [&](uint32_t k)
+                     {
+                const float dx = xs_[k] - qx, dy = ys_[k] - qy;
+                if (dx * dx + dy * dy <= r2)
+                    fn(order_[k]); });
+        }
+
+        size_t countWithin(float qx, float qy, float radius) const;
+
+        // The closest point within radius other than `exclude`, or -1.
+        int64_t nearest(float qx, float qy, float radius, int64_t exclude = -1) const;
+
+        // For every built point i, the closest other point within radius[i] (or -1):
+        // e.g. what each blob sees given its SIGHT_RANGE. Runs on the pool in cell
+        // order, so neighbouring queries scan the same cells while they are cached.
+        void nearestAll(ThreadPool &pool, const float *radius, int64_t *out) const;
+
+    private:
+        int64_t nearestSlot(float qx, float qy, float radius, int64_t excludeSlot) const;
+
+        // Clamped to the grid, so stray points land in the border cells and queries
+        // from outside still scan them. NaN fails both comparisons and lands in cell 0
+        // (std::min/max would pass it through to an undefined int conversion).
+        int cellCoord(float v, int cells) const
+        {
+            const float c = std::floor(v * inv_);
+            return c >= 1.f ? (c < float(cells - 1) ? int(c) : cells - 1) : 0;
+        }
+        uint32_t cellOf(float x, float y) const
+        {
+            return uint32_t(cellCoord(y, rows_)) * uint32_t(cols_) + uint32_t(cellCoord(x, cols_));
+        }
+
+        // fn(k) for every sorted slot k in the cells the query's bounding box covers.
+        template <class Fn>
+        void scanRows(float qx, float qy, float radius, Fn &&fn) const
+        {
+            const int cx0 = cellCoord(qx - radius, cols_), cx1 = cellCoord(qx + radius, cols_);
+            const int cy0 = cellCoord(qy - radius, rows_), cy1 = cellCoord(qy + radius, rows_);
+            for (int cy = cy0; cy <= cy1; ++cy)
+            {
+                const uint32_t end = cellStart_[size_t(cy) * cols_ + cx1 + 1];
+                for (uint32_t k = cellStart_[size_t(cy) * cols_ + cx0]; k < end; ++k)
+                    fn(k);
+            }
+        }
+
+        float cell_;
+        float inv_;
+        int cols_;
+        int rows_;
+
+        std::vector<uint32_t> cellStart_; // [cells + 1]: sorted slots of cell c are [cellStart_[c], cellStart_[c+1])
+        std::vector<uint32_t> order_;     // point index in each sorted slot
+        std::vector<float> xs_, ys_;      // coordinates in sorted order
+        std::vector<uint32_t> keys_;      // cell of each point, by point index
+        std::vector<uint32_t> counts_;    // per-chunk histograms, then scatter offsets
+    };
+
+} // namespace sim
@@ -0,0 +1,193 @@
+#include "System_Benchmark.hpp"
+#include "Ops_Parallel.h"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace sys_bench
+{
+
+    namespace
+    {
+        using clock = std::chrono::steady_clock;
+
+        double seconds_since(clock::time_point t0)
+        {
+            return std::chrono::duration<double>(clock::now() - t0).count();
+        }
+
+        // 64-byte aligned float buffer. Not from TensorArena: the arena would keep the
+        // 64 MB triad buffers cached after calibration, and a node reports its free RAM
+        // to the master while it holds them.
+        struct Buffer
+        {
+            explicit Buffer(size_t n) : n(n), p(static_cast<float *>(::operator new(n * sizeof(float), std::align_val_t(64)))) {}
+            ~Buffer() { ::operator delete(p, std::align_val_t(64)); }
+            Buffer(const Buffer &) = delete;
+            Buffer &operator=(const Buffer &) = delete;
+            size_t n;
+            float *p;
+        };
+
+#if defined(_WIN32)
+        using sock_t = SOCKET;
+        constexpr sock_t kNoSocket = INVALID_SOCKET;
+        void close_sock(sock_t s) { closesocket(s); }
+#else
+        using sock_t = int;
+        constexpr sock_t kNoSocket = -1;
+        void close_sock(sock_t s) { ::close(s); }
+#endif
+    } // namespace
+
+    double measure_gemm_gflops(ThreadPool &pool, std::chrono::milliseconds budget)
+    {
+        // Square enough to reach the packed kernel's steady state, small enough for a short budget.
+        constexpr int M = 512, N = 512, K = 512;
+        Buffer A(size_t(M) * K), B(size_t(K) * N), C(size_t(M) * N);
+        std::fill(A.p, A.p + A.n, 0.5f);
+        std::fill(B.p, B.p + B.n, 0.25f);
+
+        auto run = [&]
+        { gemm::sgemm(&pool, M, N, K, A.p, K, 1, B.p, N, 1, C.p, N, 1); };
+        run(); // warm up packing buffers and the pool
+
+        double best = 1e30;
+        const auto start = clock::now();
+        do
+        {
+            const auto t0 = clock::now();
+            run();
+            best = std::min(best, seconds_since(t0));
+        } while (clock::now() - start < budget);
+        return 2.0 * M * N * K / best * 1e-9;
+    }
+
+    double measure_memory_bandwidth_gbs(ThreadPool &pool, std::chrono::milliseconds budget)
+    {
+        // Well past any last-level cache so this is DRAM bandwidth.
+        constexpr size_t n = size_t(16) << 20;
+        Buffer a(n), b(n), c(n);
+        const auto init = [&](int64_t s, int64_t e)
+        {
+            for (int64_t i = s; i < e; ++i)
+            {
+                a.p[i] = 0.f;
+                b.p[i] = 1.f;
+                c.p[i] = 2.f;
+            }
+        };
+        ForEachRange(&pool, 0, int64_t(n), init, ParallelCost::bytes(12.0));
+
+        const auto triad = [&]
+        {
+            ForEachRange(&pool, 0, int64_t(n), [&](int64_t s, int64_t e)
+                         {
+                for (int64_t i = s; i < e; ++i)
+                    a.p[i] = b.p[i] + 0.5f * c.p[i]; }, ParallelCost::bytes(12.0));
+        };
+        triad();
+
+        double best = 1e30;
+        const auto start = clock::now();
+        do
+        {
+            const auto t0 = clock::now();
+            triad();
+            best = std::min(best, seconds_since(t0));
+        } while (clock::now() - start < budget);
+        return 3.0 * sizeof(float) * n / best * 1e-9;
+    }
+
+    double measure_loopback_latency_us(int round_trips)
+    {
+        sock_t listener = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (listener == kNoSocket)
+            return 0.0;
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0; // any free port
+        socklen_t len = sizeof(addr);
+        if (::bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+            ::listen(listener, 1) != 0 ||
+            ::getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &len) != 0)
+        {
+            close_sock(listener);
+            return 0.0;
+        }
+
+        sock_t client = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (client == kNoSocket || ::connect(client, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+        {
+            if (client != kNoSocket)
+                close_sock(client);
+            close_sock(listener);
+            return 0.0;
+        }
+        sock_t server = ::accept(listener, nullptr, nullptr);
+        close_sock(listener);
+        if (server == kNoSocket)
+        {
+            close_sock(client);
+            return 0.0;
+        }
+        int one = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<char *>(&one), sizeof(one));
+        setsockopt(server, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<char *>(&one), sizeof(one));
+
+        // Echo one byte per round trip; a 0 byte tells the echo thread to stop.
+        std::thread echo([server]
+                         {
+            char b = 0;
+            while (::recv(server, &b, 1, 0) == 1 && b != 0)
+                if (::send(server, &b, 1, 0) != 1)
+                    break; });
+
+        std::vector<double> rtts;
+        rtts.reserve(size_t(std::max(0, round_trips)));
+        char b = 1;
+        for (int i = 0; i < round_trips; ++i)
+        {
+            const auto t0 = clock::now();
+            if (::send(client, &b, 1, 0) != 1 || ::recv(client, &b, 1, 0) != 1)
+                break;
+            rtts.push_back(seconds_since(t0) * 1e6);
+        }
+        b = 0;
+        ::send(client, &b, 1, 0);
+        echo.join();
+        close_sock(client);
+        close_sock(server);
+
+        if (rtts.empty())
+            return 0.0;
+        std::nth_element(rtts.begin(), rtts.begin() + rtts.size() / 2, rtts.end());
+        return rtts[rtts.size() / 2];
+    }
+
+    Calibration calibrate(ThreadPool &pool)
+    {
+        Calibration c;
+        c.gemm_gflops = measure_gemm_gflops(pool, std::chrono::milliseconds(250));
+        c.mem_bandwidth_gbs = measure_memory_bandwidth_gbs(pool, std::chrono::milliseconds(200));
+        c.loopback_latency_us = measure_loopback_latency_us(200);
+        return c;
+    }
+
+} // namespace sys_bench
@@ -0,0 +1,27 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+class ThreadPool;
+
+namespace sys_bench
+{
+
+    // Short on-connect calibration so the master can weigh nodes by what they
+    // actually sustain rather than by core count.
+    struct Calibration
+    {
+        double gemm_gflops = 0.0;          // packed sgemm on Dense-sized shapes, all threads
+        double mem_bandwidth_gbs = 0.0;    // streaming triad a = b + s*c, all threads
+        double loopback_latency_us = 0.0;  // median TCP round trip over 127.0.0.1; 0 if unavailable
+    };
+
+    // Each measurement repeats until its time budget is spent and keeps the best run.
+    double measure_gemm_gflops(ThreadPool &pool, std::chrono::milliseconds budget);
+    double measure_memory_bandwidth_gbs(ThreadPool &pool, std::chrono::milliseconds budget);
+    double measure_loopback_latency_us(int round_trips);
+
+    // All three, about half a second in total.
+    Calibration calibrate(ThreadPool &pool);
+
+} // namespace sys_bench
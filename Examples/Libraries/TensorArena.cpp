@@ -0,0 +1,125 @@
+#include "TensorArena.hpp"
+
+#include <atomic>
+#include <new>
+
+namespace NeuralNetwork
+{
+    namespace
+    {
+        constexpr std::align_val_t kAlign{64};
+
+        std::atomic<std::uint64_t> g_allocatedBytes{0};
+        std::atomic<std::uint64_t> g_reusedBytes{0};
+        std::atomic<std::uint64_t> g_allocations{0};
+        std::atomic<std::uint64_t> g_reuses{0};
+        std::atomic<std::size_t> g_cacheLimit{std::size_t(512) << 20};
+    }
+
+    TensorArena::Cache::~Cache()
+    {
+        for (auto &list : freeLists)
+            for (void *p : list)
+                ::operator delete(p, kAlign);
+    }
+
+    TensorArena::Cache &TensorArena::local()
+    {
+        static thread_local Cache cache;
+        return cache;
+    }
+
+    int TensorArena::sizeClass(std::size_t bytes)
+    {
+        int shift = kMinShift;
+        while ((std::size_t(1) << shift) < bytes)
+            ++shift;
+        return shift - kMinShift;
+    }
+
+    void *TensorArena::allocate(std::size_t bytes)
+    {
+        if (bytes == 0)
+            return nullptr;
+        const int c = sizeClass(bytes);
+        const std::size_t blockBytes = std::size_t(1) << (c + kMinShift);
+        if (c < kClasses)
+        {
+            Cache &cache = local();
+            auto &list = cache.freeLists[c];
+            if (!list.empty())
+            {
+                void *p = list.back();
+                list.pop_back();
+                cache.cached -= blockBytes;
+                g_reusedBytes.fetch_add(blockBytes, std::memory_order_relaxed);
+                g_reuses.fetch_add(1, std::memory_order_relaxed);
+                return p;
+            }
+        }
+        g_allocatedBytes.fetch_add(blockBytes, std::memory_order_relaxed);
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+        return ::operator new(blockBytes, kAlign);
+    }
+
+    void TensorArena::deallocate(void *p, std::size_t bytes)
+    {
+        if (!p)
+            return;
+        const int c = sizeClass(bytes);
+        const std::size_t blockBytes = std::size_t(1) << (c + kMinShift);
+        Cache &cache = local();
+        if (c >= kClasses || cache.cached + blockBytes > g_cacheLimit.load(std::memory_order_relaxed))
+        {
+            ::operator delete(p, kAlign);
+            return;
+        }
+        cache.freeLists[c].push_back(p);
+        cache.cached += blockBytes;
+    }
+
+    TensorArena::Stats TensorArena::stats()
+    {
+        Stats s;
+        s.allocatedBytes = g_allocatedBytes.load(std::memory_order_relaxed);
+        s.reusedBytes = g_reusedBytes.load(std::memory_order_relaxed);
+        s.allocations = g_allocations.load(std::memory_order_relaxed);
+        s.reuses = g_reuses.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    void TensorArena::resetStats()
+    {
+        g_allocatedBytes.store(0, std::memory_order_relaxed);
+        g_reusedBytes.store(0, std::memory_order_relaxed);
+        g_allocations.store(0, std::memory_order_relaxed);
+        g_reuses.store(0, std::memory_order_relaxed);
+    }
+
+    std::size_t TensorArena::cachedBytes()
+    {
+        return local().cached;
+    }
+
+    std::size_t TensorArena::cacheLimit()
+    {
+        return g_cacheLimit.load(std::memory_order_relaxed);
+    }
+
+    void TensorArena::setCacheLimit(std::size_t bytes)
+    {
+        g_cacheLimit.store(bytes, std::memory_order_relaxed);
+    }
+
+    void TensorArena::trim()
+    {
+        Cache &cache = local();
+        for (auto &list : cache.freeLists)
+        {
+            for (void *p : list)
+                ::operator delete(p, kAlign);
+            list.clear();
+        }
+        cache.cached = 0;
+    }
+}
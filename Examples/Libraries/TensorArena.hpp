@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace NeuralNetwork
+{
+    // Per-thread caching allocator for tensor buffers.
+    //
+    // Blocks are rounded up to power-of-two size classes (64 B minimum, 64 B aligned)
+    // and recycled through per-class free lists, so once a training step has run, the
+    // next step's temporaries come from the cache instead of the system allocator.
+    // A block may be released on a different thread than it was allocated on; it then
+    // joins that thread's cache. Each thread caches at most cacheLimit() bytes.
+    //
+    // Counters are process-wide. To measure one step:
+    //     TensorArena::resetStats();
+    //     net.forward(x); net.backward(g, lr);
+    //     auto s = TensorArena::stats();   // s.allocatedBytes == 0 in steady state
+    class TensorArena
+    {
+    public:
+        struct Stats
+        {
+            std::uint64_t allocatedBytes = 0; // bytes fetched from the system allocator
+            std::uint64_t reusedBytes = 0;    // bytes served from a free list
+            std::uint64_t allocations = 0;
+            std::uint64_t reuses = 0;
+        };
+
+        static void *allocate(std::size_t bytes);
+        static void deallocate(void *p, std::size_t bytes);
+
+        static Stats stats();
+        static void resetStats();
+
+        // Bytes currently cached by the calling thread, and the per-thread cap.
+        static std::size_t cachedBytes();
+        static std::size_t cacheLimit();
+        static void setCacheLimit(std::size_t bytes);
+
+        // Return the calling thread's cached blocks to the system.
+        static void trim();
+
+    private:
+        static constexpr int kMinShift = 6; // 64 B
+        static constexpr int kClasses = 40; // up to 2^45 B
+
+        struct Cache
+        {
+            std::vector<void *> freeLists[kClasses];
+            std::size_t cached = 0;
+            ~Cache();
+        };
+
+        static Cache &local();
+        static int sizeClass(std::size_t bytes);
+    };
+}
+
@@ -1,100 +1,171 @@
-#pragma once
-#include <vector>
-#include <thread>
-#include <mutex>
-#include <condition_variable>
-#include <queue>
-#include <functional>
-#include <future>
-
-class ThreadPool
+#include "ThreadPool.hpp"
+
+thread_local ThreadPool *ThreadPool::tlsPool = nullptr;
+thread_local size_t ThreadPool::tlsIndex = 0;
+
+void ThreadPool::start(size_t numThreads)
 {
-public:
-    explicit ThreadPool(size_t numThreads)
+    mWorkers.reserve(numThreads);
+    for (size_t i = 0; i < numThreads; ++i)
     {
-        start(numThreads);
+        mWorkers.emplace_back(std::make_unique<Worker>());
+        mWorkers.back()->rng = uint32_t(i * 2654435761u + 1);
     }
+    // Start threads only after every deque exists; workers steal from each other.
+    for (size_t i = 0; i < numThreads; ++i)
+        mWorkers[i]->thread = std::thread([this, i]
+                                          { workerLoop(i); });
+}
 
-    ~ThreadPool()
+void ThreadPool::stop() noexcept
+{
     {
-        stop();
+        std::unique_lock<std::mutex> lock(mEventMutex);
+        mStopping.store(true);
     }
 
-    size_t size()
+    mEventVar.notify_all();
+
+    for (auto &w : mWorkers)
+        if (w->thread.joinable())
+            w->thread.join();
+}
+
+void ThreadPool::push(Task *task)
+{
+    if (tlsPool == this)
     {
-        return mThreads.size();
+        mWorkers[tlsIndex]->deque.push(task);
     }
-
-    void enqueue(std::function<void()> task)
+    else
     {
-        {
-            std::unique_lock<std::mutex> lock(mEventMutex);
-            mTasks.push(std::move(task));
-        }
-        mEventVar.notify_one();
+        std::lock_guard<std::mutex> lock(mInjectMutex);
+        mInjected.push_back(task);
+        mInjectedCount.fetch_add(1, std::memory_order_relaxed);
     }
+    wakeOne();
+}
 
-    template <class F, class... Args>
-    auto enqueue(F &&f, Args &&...args) -> std::future<std::invoke_result_t<F, Args...>>
+void ThreadPool::wakeOne()
+{
+    // Pairs with the fence in workerLoop: either the sleeper sees our task in
+    // hasWork(), or we see it registered as a sleeper and notify it.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (mSleepers.load(std::memory_order_relaxed) == 0)
+        return;
     {
-        using RetType = std::invoke_result_t<F, Args...>;
-
-        auto task = std::make_shared<std::packaged_task<RetType()>>(
-            std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+        std::lock_guard<std::mutex> lock(mEventMutex);
+    }
+    mEventVar.notify_one();
+}
 
-        std::future<RetType> future = task->get_future();
+ThreadPool::Task *ThreadPool::popInjected()
+{
+    if (mInjectedCount.load(std::memory_order_relaxed) == 0)
+        return nullptr;
+    std::lock_guard<std::mutex> lock(mInjectMutex);
+    if (mInjected.empty())
+        return nullptr;
+    Task *t = mInjected.front();
+    mInjected.pop_front();
+    mInjectedCount.fetch_sub(1, std::memory_order_relaxed);
+    return t;
+}
+
+ThreadPool::Task *ThreadPool::findTask(size_t self)
+{
+    Task *t = nullptr;
+    Worker &me = *mWorkers[self];
+    if (me.deque.pop(t))
+        return t;
+    if ((t = popInjected()))
+        return t;
+
+    const size_t n = mWorkers.size();
+    if (n > 1)
+    {
+        // xorshift32 picks the first victim; then sweep everyone else once.
+        me.rng ^= me.rng << 13;
+        me.rng ^= me.rng >> 17;
+        me.rng ^= me.rng << 5;
+        const size_t first = me.rng % n;
+        for (size_t k = 0; k < n; ++k)
         {
-            std::unique_lock<std::mutex> lock(mEventMutex);
-            mTasks.emplace([task]()
-                           { (*task)(); });
+            const size_t v = (first + k) % n;
+            if (v != self && mWorkers[v]->deque.steal(t))
+                return t;
         }
-        mEventVar.notify_one();
-        return future;
     }
+    return nullptr;
+}
 
-private:
-    std::vector<std::thread> mThreads;
-    std::condition_variable mEventVar;
-    std::mutex mEventMutex;
-    bool mStopping = false;
-
-    std::queue<std::function<void()>> mTasks;
+bool ThreadPool::runPendingTask()
+{
+    Task *task = nullptr;
+    if (tlsPool == this)
+    {
+        task = findTask(tlsIndex);
+    }
+    else if (!(task = popInjected()))
+    {
+        for (auto &w : mWorkers)
+            if (w->deque.steal(task))
+                break;
+    }
+    if (!task)
+        return false;
+    task->fn();
+    delete task;
+    return true;
+}
+
+bool ThreadPool::hasWork() const
+{
+    if (mInjectedCount.load(std::memory_order_seq_cst) > 0)
+        return true;
+    for (const auto &w : mWorkers)
+        if (!w->deque.empty())
+            return true;
+    return false;
+}
+
+void ThreadPool::workerLoop(size_t index)
+{
+    tlsPool = this;
+    tlsIndex = index;
 
-    void start(size_t numThreads)
+    while (true)
     {
-        for (size_t i = 0; i < numThreads; ++i)
+        Task *task = findTask(index);
+        if (!task)
         {
-            mThreads.emplace_back([=]
-                                  {
-                while (true) {
-                    std::function<void()> task;
-
-                    {
-                        std::unique_lock<std::mutex> lock(mEventMutex);
-                        mEventVar.wait(lock, [=] { return mStopping || !mTasks.empty(); });
-
-                        if (mStopping && mTasks.empty())
-                            break;
-
-                        task = std::move(mTasks.front());
-                        mTasks.pop();
-                    }
+            // A short spin catches the next ParallelFor wave without a futex round-trip.
+            for (int spin = 0; spin < 64 && !task; ++spin)
+            {
+                std::this_thread::yield();
+                task = findTask(index);
+            }
+        }
 
-                    task(); 
-                } });
+        if (task)
+        {
+            task->fn();
+            delete task;
+            continue;
         }
-    }
 
-    void stop() noexcept
-    {
+        mSleepers.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
         {
             std::unique_lock<std::mutex> lock(mEventMutex);
-            mStopping = true;
+            mEventVar.wait(lock, [this]
+                           { return mStopping.load() || hasWork(); });
         }
+        mSleepers.fetch_sub(1, std::memory_order_relaxed);
 
-        mEventVar.notify_all();
-
-        for (std::thread &thread : mThreads)
-            thread.join();
+        if (mStopping.load() && !hasWork())
+            break;
     }
-};
+
+    tlsPool = nullptr;
+}
@@ -1,13 +1,21 @@
 #pragma once
 
+#include <atomic>
 #include <vector>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
-#include <queue>
+#include <deque>
 #include <functional>
 #include <future>
+#include <memory>
 
+#include "./WorkStealingDeque.hpp"
+
+// Work-stealing pool: every worker owns a Chase-Lev deque. Tasks enqueued from a
+// worker go to its own deque (popped LIFO for locality); tasks from outside the
+// pool go to a global injection queue. Idle workers drain the injection queue and
+// then steal FIFO from the other deques before going to sleep.
 class ThreadPool
 {
 public:
@@ -21,13 +29,44 @@ public:
     template <class F, class... Args>
     auto enqueue(F &&f, Args &&...args) -> std::future<std::invoke_result_t<F, Args...>>;
 
+    // Runs one pending task on the calling thread, if any is available. Lets a
+    // thread that waits on pool work help instead of blocking (see ParallelFor).
+    bool runPendingTask();
+
 private:
-    std::vector<std::thread> mThreads;
+    struct Task
+    {
+        std::function<void()> fn;
+    };
+
+    struct Worker
+    {
+        WorkStealingDeque<Task *> deque;
+        std::thread thread;
+        uint32_t rng = 0; // victim selection
+    };
+
+    std::vector<std::unique_ptr<Worker>> mWorkers;
+
+    std::mutex mInjectMutex;
+    std::deque<Task *> mInjected;
+    std::atomic<size_t> mInjectedCount{0};
+
     std::condition_variable mEventVar;
     std::mutex mEventMutex;
-    bool mStopping = false;
+    std::atomic<int> mSleepers{0};
+    std::atomic<bool> mStopping{false};
+
+    // Worker index of the current thread in the pool that owns it, if any.
+    static thread_local ThreadPool *tlsPool;
+    static thread_local size_t tlsIndex;
 
-    std::queue<std::function<void()>> mTasks;
+    void push(Task *task);
+    Task *findTask(size_t self);
+    Task *popInjected();
+    bool hasWork() const;
+    void wakeOne();
+    void workerLoop(size_t index);
 
     void start(size_t numThreads);
     void stop() noexcept;
@@ -35,7 +74,7 @@ private:
 
 inline size_t ThreadPool::size()
 {
-    return mThreads.size();
+    return mWorkers.size();
 }
 
 inline ThreadPool::ThreadPool(size_t numThreads)
@@ -50,11 +89,7 @@ inline ThreadPool::~ThreadPool()
 
 inline void ThreadPool::enqueue(std::function<void()> task)
 {
-    {
-        std::unique_lock<std::mutex> lock(mEventMutex);
-        mTasks.push(std::move(task));
-    }
-    mEventVar.notify_one();
+    push(new Task{std::move(task)});
 }
 
 template <class F, class... Args>
@@ -66,49 +101,7 @@ auto ThreadPool::enqueue(F &&f, Args &&...args) -> std::future<std::invoke_resul
         std::bind(std::forward<F>(f), std::forward<Args>(args)...));
 
     std::future<RetType> future = task->get_future();
-    {
-        std::unique_lock<std::mutex> lock(mEventMutex);
-        mTasks.emplace([task]()
-                       { (*task)(); });
-    }
-    mEventVar.notify_one();
+    push(new Task{[task]()
+                  { (*task)(); }});
     return future;
 }
-
-inline void ThreadPool::start(size_t numThreads)
-{
-    for (size_t i = 0; i < numThreads; ++i)
-    {
-        mThreads.emplace_back([=]
-                              {
-            while (true) {
-                std::function<void()> task;
-
-                {
-                    std::unique_lock<std::mutex> lock(mEventMutex);
-                    mEventVar.wait(lock, [=] { return mStopping || !mTasks.empty(); });
-
-                    if (mStopping && mTasks.empty())
-                        break;
-
-                    task = std::move(mTasks.front());
-                    mTasks.pop();
-                }
-
-                task();
-            } });
-    }
-}
-
-inline void ThreadPool::stop() noexcept
-{
-    {
-        std::unique_lock<std::mutex> lock(mEventMutex);
-        mStopping = true;
-    }
-
-    mEventVar.notify_all();
-
-    for (std::thread &thread : mThreads)
-        thread.join();
-}
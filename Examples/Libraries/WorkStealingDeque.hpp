@@ -0,0 +1,116 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Chase-Lev work-stealing deque (Le, Pop, Cohen, Zappa Nardelli, PPoPP'13 C11 version).
+// The owning thread pushes and pops at the bottom (LIFO); any other thread may
+// steal from the top (FIFO). T must be trivially copyable (we store task pointers).
+template <class T>
+class WorkStealingDeque
+{
+public:
+    explicit WorkStealingDeque(int64_t capacity = 256)
+        : mArray(new Array(capacity)) {}
+
+    ~WorkStealingDeque() { delete mArray.load(std::memory_order_relaxed); }
+
+    WorkStealingDeque(const WorkStealingDeque &) = delete;
+    WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+    // Owner only.
+    void push(T x)
+    {
+        int64_t b = mBottom.load(std::memory_order_relaxed);
+        int64_t t = mTop.load(std::memory_order_acquire);
+        Array *a = mArray.load(std::memory_order_relaxed);
+        if (b - t > a->capacity - 1)
+        {
+            // Thieves may still be reading the old array; retire it until we're destroyed.
+            Array *grown = a->grow(b, t);
+            mRetired.emplace_back(a);
+            mArray.store(grown, std::memory_order_release);
+            a = grown;
+        }
+        a->put(b, x);
+        std::atomic_thread_fence(std::memory_order_release);
+        mBottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // Owner only.
+    bool pop(T &out)
+    {
+        int64_t b = mBottom.load(std::memory_order_relaxed) - 1;
+        Array *a = mArray.load(std::memory_order_relaxed);
+        mBottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = mTop.load(std::memory_order_relaxed);
+
+        if (t > b)
+        {
+            mBottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        out = a->get(b);
+        if (t == b)
+        {
+            // Last element: race the thieves for it.
+            bool won = mTop.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            mBottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // Any thread. Fails if empty or if it lost a race with another thief/the owner.
+    bool steal(T &out)
+    {
+        int64_t t = mTop.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = mBottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return false;
+
+        Array *a = mArray.load(std::memory_order_acquire);
+        T x = a->get(t);
+        if (!mTop.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return false;
+        out = x;
+        return true;
+    }
+
+    bool empty() const
+    {
+        int64_t b = mBottom.load(std::memory_order_seq_cst);
+        int64_t t = mTop.load(std::memory_order_seq_cst);
+        return b <= t;
+    }
+
+private:
+    struct Array
+    {
+        int64_t capacity;
+        int64_t mask;
+        std::unique_ptr<std::atomic<T>[]> slots;
+
+        explicit Array(int64_t cap)
+            : capacity(cap), mask(cap - 1), slots(new std::atomic<T>[size_t(cap)]) {}
+
+        T get(int64_t i) const { return slots[size_t(i & mask)].load(std::memory_order_relaxed); }
+        void put(int64_t i, T x) { slots[size_t(i & mask)].store(x, std::memory_order_relaxed); }
+
+        Array *grow(int64_t b, int64_t t) const
+        {
+            Array *a = new Array(capacity * 2);
+            for (int64_t i = t; i < b; ++i)
+                a->put(i, get(i));
+            return a;
+        }
+    };
+
+    alignas(64) std::atomic<int64_t> mTop{0};
+    alignas(64) std::atomic<int64_t> mBottom{0};
+    alignas(64) std::atomic<Array *> mArray;
+    std::vector<std::unique_ptr<Array>> mRetired;
+};
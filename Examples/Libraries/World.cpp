@@ -0,0 +1,159 @@
+#include "World.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <random>
+
+#include "./ParallelFor.h"
+
+namespace sim
+{
+
+    namespace
+    {
+        // Moves the kept entries of one column to the front; keep is increasing.
+        template <class T>
+        void compactColumn(std::vector<T> &column, const std::vector<uint32_t> &keep)
+        {
+            for (size_t j = 0; j < keep.size(); ++j)
+                column[j] = column[keep[j]];
+            column.resize(keep.size());
+        }
+
+        // One tick of blobs [s, e). Branch-free so the loop vectorises: compass steps are
+        // arithmetic and the clamps are selects (which GCC only if-converts under
+        // -fno-trapping-math, see CMakeLists.txt). The restrict pointers, as parameters
+        // rather than lambda captures, tell it that the columns do not overlap.
+        size_t tickRange(const WorldConfig c, float *__restrict px, float *__restrict py, uint8_t *__restrict pf,
+                         float *__restrict ph, float *__restrict pfood, const float *__restrict pspeed,
+                         const int8_t *__restrict pturn, const float *__restrict pthrottle, int64_t s, int64_t e)
+        {
+            size_t dead = 0;
+            for (int64_t i = s; i < e; ++i)
+            {
+                // Dead blobs stay frozen until removeDead(): no turn, move, graze or heal.
+                // live scales every change to zero instead of selecting the old values,
+                // which GCC would turn into branches; food and health stay in range, so
+                // the clamps leave a dead blob's exactly as they were.
+                const float live = ph[i] > 0.f ? 1.f : 0.f;
+                const int f = (pf[i] + (pturn[i] & -int(live > 0.f))) & 3;
+                pf[i] = uint8_t(f);
+                const float dist = pspeed[i] * pthrottle[i] * live;
+                const float dx = float(int(f == East) - int(f == West));
+                const float dy = float(int(f == North) - int(f == South));
+                px[i] = std::min(std::max(px[i] + dx * dist, 0.f), c.width);
+                py[i] = std::min(std::max(py[i] + dy * dist, 0.f), c.height);
+
+                const float cost = c.basalBurn + c.moveCost * dist - c.grazeRate * (1.f - pthrottle[i]);
+                const float fed = pfood[i] - live * cost;
+                const float h = ph[i] + live * (fed < 0.f ? fed : c.healRate);
+                pfood[i] = std::min(std::max(fed, 0.f), c.maxFood);
+                ph[i] = std::min(h, c.maxHealth);
+                dead += h <= 0.f;
+            }
+            return dead;
+        }
+    }
+
+    World::World(ThreadPool &pool, WorldConfig config)
+        : pool_(pool), config_(config)
+    {
+    }
+
+    void World::reserve(size_t n)
+    {
+        for (auto *c : {&x, &y, &health, &food, &speed, &sight, &attack, &looks, &intelligence, &throttle})
+            c->reserve(n);
+        facing.reserve(n);
+        turn.reserve(n);
+    }
+
+    size_t World::spawn(const Traits &t, float px, float py, Facing f)
+    {
+        x.push_back(std::clamp(px, 0.f, config_.width));
+        y.push_back(std::clamp(py, 0.f, config_.height));
+        facing.push_back(f);
+        health.push_back(config_.maxHealth);
+        food.push_back(config_.maxFood);
+        speed.push_back(t.speed);
+        sight.push_back(t.sight);
+        attack.push_back(t.attack);
+        looks.push_back(t.looks);
+        intelligence.push_back(t.intelligence);
+        turn.push_back(0);
+        throttle.push_back(0.f);
+        return size() - 1;
+    }
+
+    void World::spawnRandom(size_t n, uint64_t seed)
+    {
+        std::mt19937_64 rng(seed);
+        std::uniform_real_distribution<float> unit(0.f, 1.f);
+        reserve(size() + n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            Traits t;
+            t.speed = 0.5f + 1.5f * unit(rng);
+            t.sight = 4.f + 28.f * unit(rng);
+            t.attack = 0.5f + 4.5f * unit(rng);
+            t.looks = unit(rng);
+            t.intelligence = unit(rng);
+            const float px = config_.width * unit(rng), py = config_.height * unit(rng);
+            spawn(t, px, py, Facing(rng() & 3));
+        }
+    }
+
+    size_t World::spawnChild(size_t a, size_t b, uint64_t seed)
+    {
+        const Traits ta = traits(a), tb = traits(b);
+        const uint64_t pick = std::mt19937_64(seed)();
+        Traits t;
+        t.speed = pick & 1 ? ta.speed : tb.speed;
+        t.sight = pick & 2 ? ta.sight : tb.sight;
+        t.attack = pick & 4 ? ta.attack : tb.attack;
+        t.looks = pick & 8 ? ta.looks : tb.looks;
+        t.intelligence = pick & 16 ? ta.intelligence : tb.intelligence;
+        return spawn(t, x[a], y[a], Facing(facing[a]));
+    }
+
+    Traits World::traits(size_t i) const
+    {
+        Traits t;
+        t.speed = speed[i];
+        t.sight = sight[i];
+        t.attack = attack[i];
+        t.looks = looks[i];
+        t.intelligence = intelligence[i];
+        return t;
+    }
+
+    size_t World::tick()
+    {
+        std::atomic<size_t> dead{0};
+        ParallelFor(pool_, 0, int64_t(size()), [&](int64_t s, int64_t e)
+                    {
+            const size_t chunkDead = tickRange(config_, x.data(), y.data(), facing.data(), health.data(), food.data(),
+                                               speed.data(), turn.data(), throttle.data(), s, e);
+            dead.fetch_add(chunkDead, std::memory_order_relaxed); }, ParallelCost::bytes(32.0));
+
+        ++ticks_;
+        return dead.load();
+    }
+
+    void World::removeDead()
+    {
+        std::vector<uint32_t> keep;
+        keep.reserve(size());
+        for (size_t i = 0; i < size(); ++i)
+            if (health[i] > 0.f)
+                keep.push_back(uint32_t(i));
+        if (keep.size() == size())
+            return;
+
+        for (auto *c : {&x, &y, &health, &food, &speed, &sight, &attack, &looks, &intelligence, &throttle})
+            compactColumn(*c, keep);
+        compactColumn(facing, keep);
+        compactColumn(turn, keep);
+    }
+
+} // namespace sim
@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "./ThreadPool.hpp"
+
+// The blob world, stored data-oriented: one contiguous column per attribute instead
+// of one Blob object per creature. A tick is a single pass over the columns that
+// the compiler vectorises and the pool splits across cores, and code that only
+// reads positions never pulls health or traits through the cache.
+namespace sim
+{
+
+    enum Facing : uint8_t
+    {
+        North, // +y
+        East,  // +x
+        South,
+        West
+    };
+
+    // The heritable characteristics a Blob's GENOME holds.
+    struct Traits
+    {
+        float speed = 1.f;        // distance per tick at full throttle
+        float sight = 8.f;        // how far the blob can see
+        float attack = 1.f;       // health taken per hit
+        float looks = 0.5f;       // [0, 1]
+        float intelligence = 0.5f; // [0, 1]
+    };
+
+    struct WorldConfig
+    {
+        float width = 4096.f;
+        float height = 4096.f;
+        float maxHealth = 100.f;
+        float maxFood = 100.f;
+        float basalBurn = 0.05f; // food spent per tick just living
+        float moveCost = 0.1f;   // food per unit of distance moved
+        float grazeRate = 0.2f;  // food found per tick at rest, scaled by (1 - throttle)
+        float healRate = 0.1f;   // health regained per tick while fed
+    };
+
+    class World
+    {
+    public:
+        // Column i of every vector is blob i.
+        std::vector<float> x, y; // in [0, width] x [0, height]
+        std::vector<uint8_t> facing;
+        std::vector<float> health, food;
+
+        std::vector<float> speed, sight, attack, looks, intelligence;
+
+        // What each blob does on the next tick, written by whatever controls it.
+        std::vector<int8_t> turn;     // -1 turn left, 0 keep going, +1 turn right
+        std::vector<float> throttle; // fraction of speed to move, [0, 1]
+
+        explicit World(ThreadPool &pool, WorldConfig config = {});
+
+        size_t size() const { return x.size(); }
+        const WorldConfig &config() const { return config_; }
+        uint64_t ticks() const { return ticks_; }
+        ThreadPool &pool() { return pool_; }
+
+        void reserve(size_t n);
+
+        // Full health and food, standing still. Returns the new blob's index.
+        size_t spawn(const Traits &traits, float x, float y, Facing facing = North);
+        // n blobs with random traits, positions and facings.
+        void spawnRandom(size_t n, uint64_t seed);
+        // A child of a and b next to a, each trait taken from one parent or the other.
+        size_t spawnChild(size_t a, size_t b, uint64_t seed);
+
+        Traits traits(size_t i) const;
+
+        // Advances every blob one step: turn, move, pay for living and moving, graze,
+        // then heal if fed or lose the food deficit from health if not. Returns how
+        // many blobs are dead (health <= 0) afterwards; they keep their slots, frozen,
+        // until removeDead(), so indices stay valid and the dead stay dead.
+        size_t tick();
+
+        // Drops dead blobs, keeping the survivors in order.
+        void removeDead();
+
+    private:
+        ThreadPool &pool_;
+        WorldConfig config_;
+        uint64_t ticks_ = 0;
+    };
+
+} // namespace sim
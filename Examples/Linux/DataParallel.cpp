@@ -0,0 +1,90 @@
+#include <iostream>
+#include <string>
+#include "./DemoModel.hpp"
+#include "./network/RingAllReduce.hpp"
+#include "./network/net/Logger.hpp"
+
+// Trains the demo model data-parallel: every rank holds the whole model and a slice of
+// each batch, and the ranks sum their gradients over a ring before each step, which
+// gives the same update as one node training on the full batch. The ring closes on
+// itself, e.g. for three nodes:
+//   dataparallel 0 3 5700 <B-ip>:5700 fp16  # on node A, prints the loss
+//   dataparallel 1 3 5700 <C-ip>:5700       # on node B
+//   dataparallel 2 3 5700 <A-ip>:5700       # on node C
+// Rank 0's optional codec (none, fp16, bf16, int8, topk[:ratio]) compresses the
+// gradients on the wire; the other ranks adopt it when the ring forms.
+
+using namespace NeuralNetwork;
+
+int main(int argc, char **argv)
+{
+    if (argc < 4)
+    {
+        std::cerr << "usage: dataparallel <rank> <num_ranks> <listen_port> [next_ip:port] [codec]\n";
+        return 1;
+    }
+    const int rank = std::stoi(argv[1]);
+    const int numRanks = std::stoi(argv[2]);
+    const uint16_t port = static_cast<uint16_t>(std::stoi(argv[3]));
+    const std::string next = argc > 4 ? argv[4] : "";
+    if (rank < 0 || rank >= numRanks || (numRanks > 1 && next.empty()))
+    {
+        std::cerr << "bad rank arguments\n";
+        return 1;
+    }
+    dist::GradCodec codec;
+    if (argc > 5)
+    {
+        const std::string arg = argv[5];
+        const size_t colon = arg.find(':');
+        if (!dist::codecFromName(arg.substr(0, colon), codec.codec))
+        {
+            std::cerr << "unknown codec '" << arg << "'\n";
+            return 1;
+        }
+        if (colon != std::string::npos)
+            codec.topkRatio = std::stof(arg.substr(colon + 1));
+    }
+
+    ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    Sequential net(pool);
+    for (int b = 0; b < demo::kBlocks; ++b)
+        demo::addBlock(net, b);
+
+    dist::RingAllReduce ring(rank, numRanks);
+    if (!ring.connect(port, next) || !ring.agreeCodec(codec))
+        return 2;
+    dist::GradientAllReducer reducer(net, ring, /*average*/ false, codec);
+
+    Tensor X, Y;
+    demo::makeDataset(&pool, X, Y);
+    const int begin = rank * demo::kBatch / numRanks, end = (rank + 1) * demo::kBatch / numRanks;
+    const Tensor Xs = X.sliceRows(begin, end), Ys = Y.sliceRows(begin, end);
+
+    for (int step = 0; step <= 200; ++step)
+    {
+        // d/dy of the squared error summed over this rank's rows, over the global
+        // batch: the ring's sum of these is the full-batch gradient.
+        Tensor g = net.forward(Xs) - Ys;
+        const float scale = 2.f / float(demo::kBatch);
+        float loss = 0.f;
+        for (uint64_t i = 0; i < g.length(); ++i)
+        {
+            loss += g.data[i] * g.data[i];
+            g.data[i] *= scale;
+        }
+        net.backward(g, demo::kLearningRate);
+        if (!reducer.finish())
+            return 3;
+        net.applyUpdates(demo::kLearningRate);
+
+        if (step % 20 == 0)
+        {
+            if (!ring.allReduce(&loss, 1, false))
+                return 3;
+            if (rank == 0)
+                LOG_INFO("step %d loss %.5f", step, loss / demo::kBatch);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cmath>
+#include <random>
+#include <vector>
+#include "../Libraries/NeuralNetwork.hpp"
+
+// The MLP the pipeline examples train: block b is Dense + ReLU (Dense + Sigmoid for
+// the head), and blocks are the unit the partitioner assigns to nodes.
+namespace demo
+{
+
+    constexpr int kIn = 32, kHidden = 128, kBlocks = 9, kBatch = 256, kMicroBatches = 8;
+    constexpr float kLearningRate = 0.2f;
+    constexpr uint32_t kTrainSteps = 400; // for the master-driven job (Node)
+
+    inline std::vector<int> widths()
+    {
+        std::vector<int> w(kBlocks + 1, kHidden);
+        w.front() = kIn;
+        w.back() = 1;
+        return w;
+    }
+
+    // Appends block b to net and returns its Dense layer (owned by net).
+    inline NeuralNetwork::Dense *addBlock(NeuralNetwork::Sequential &net, int b)
+    {
+        const bool head = b == kBlocks - 1;
+        const int fanIn = b == 0 ? kIn : kHidden;
+        auto *dense = new NeuralNetwork::Dense(fanIn, head ? 1 : kHidden);
+        // He-uniform scale; Dense's default +-0.05 vanishes through a stack this deep.
+        const float scale = std::sqrt(6.f / fanIn) / 0.05f;
+        for (uint64_t i = 0; i < dense->weights.length(); ++i)
+            dense->weights.data[i] *= scale;
+        net.add(dense);
+        if (head)
+            net.add(new NeuralNetwork::Sigmoid());
+        else
+            net.add(new NeuralNetwork::ReLu());
+        return dense;
+    }
+
+    // Fixed synthetic task: is a signed sum of the inputs positive.
+    inline void makeDataset(ThreadPool *pool, NeuralNetwork::Tensor &X, NeuralNetwork::Tensor &Y)
+    {
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<float> dist(-1.f, 1.f);
+        X = NeuralNetwork::Tensor(2, pool, {kBatch, kIn});
+        Y = NeuralNetwork::Tensor(2, pool, {kBatch, 1});
+        for (int i = 0; i < kBatch; ++i)
+        {
+            float s = 0.f;
+            for (int j = 0; j < kIn; ++j)
+            {
+                X.data[i * kIn + j] = dist(rng);
+                s += X.data[i * kIn + j] * (j % 3 == 0 ? 1.f : -0.5f);
+            }
+            Y.data[i] = s > 0.f ? 1.f : 0.f;
+        }
+    }
+
+} // namespace demo
@@ -0,0 +1,53 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "./DemoModel.hpp"
+#include "../Libraries/Evolution.hpp"
+#include "./network/net/Logger.hpp"
+
+// Evolves small networks on the demo task instead of training one: every individual
+// is scored on the whole dataset, and the population breeds from the fittest.
+//   evolve [population] [generations]
+
+using namespace NeuralNetwork;
+
+int main(int argc, char **argv)
+{
+    const size_t size = argc > 1 ? std::stoul(argv[1]) : 2000;
+    const int generations = argc > 2 ? std::stoi(argv[2]) : 100;
+
+    ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    Tensor X, Y;
+    demo::makeDataset(&pool, X, Y);
+
+    evo::Topology topology;
+    topology.widths = {demo::kIn, 16, 1};
+    evo::Population population(pool, topology, size);
+    LOG_INFO("population %zu, genome %zu floats", population.size(), population.genomeLength());
+
+    // Negative mean squared error over the dataset.
+    const auto fitness = [&](Sequential &brain, size_t)
+    {
+        const Tensor out = brain.forward(X);
+        float sse = 0.f;
+        for (int i = 0; i < demo::kBatch; ++i)
+        {
+            const float d = out.data[i] - Y.data[i];
+            sse += d * d;
+        }
+        return -sse / demo::kBatch;
+    };
+
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int g = 0; g <= generations; ++g)
+    {
+        population.evaluate(fitness);
+        if (g % 10 == 0)
+            LOG_INFO("generation %d best mse %.5f", g, -population.fitness()[population.best()]);
+        if (g < generations)
+            population.nextGeneration();
+    }
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    LOG_INFO("%.1f generations/s, %.0f individuals/s", (generations + 1) / secs, (generations + 1) * size / secs);
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "./DemoModel.hpp"
+#include "./network/IslandMigrator.hpp"
+#include "./network/net/Logger.hpp"
+
+// Island-model neuroevolution on the demo task: every node evolves its own population
+// and every few generations sends its best genomes to another island. Islands never
+// wait for each other, so they can run at different speeds. List every island's
+// address in island order, the same list on every node, e.g. for three nodes:
+//   islands 0 5800 ring <A-ip>:5800 <B-ip>:5800 <C-ip>:5800   # on node A
+//   islands 1 5800 ring <A-ip>:5800 <B-ip>:5800 <C-ip>:5800   # on node B
+//   islands 2 5800 ring <A-ip>:5800 <B-ip>:5800 <C-ip>:5800   # on node C
+// Use random instead of ring to send each batch of migrants to a random island.
+
+using namespace NeuralNetwork;
+
+int main(int argc, char **argv)
+{
+    if (argc < 5)
+    {
+        std::cerr << "usage: islands <island> <listen_port> <ring|random> <island0_ip:port> [island1_ip:port ...]\n";
+        return 1;
+    }
+    const int island = std::stoi(argv[1]);
+    const uint16_t port = static_cast<uint16_t>(std::stoi(argv[2]));
+    const std::string mode = argv[3];
+    const std::vector<std::string> addrs(argv + 4, argv + argc);
+    if (island < 0 || island >= int(addrs.size()) || (mode != "ring" && mode != "random"))
+    {
+        std::cerr << "bad island arguments\n";
+        return 1;
+    }
+    const size_t size = 2000;
+    const int generations = 100;
+
+    dist::MigrationConfig mcfg;
+    mcfg.topology = mode == "ring" ? dist::MigrationTopology::Ring : dist::MigrationTopology::Random;
+    mcfg.seed = 7;
+    dist::IslandMigrator migrator(island, addrs, mcfg);
+    if (!migrator.connect(port))
+        return 2;
+
+    ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    Tensor X, Y;
+    demo::makeDataset(&pool, X, Y);
+
+    evo::Topology topology;
+    topology.widths = {demo::kIn, 16, 1};
+    evo::Population population(pool, topology, size, {}, uint64_t(island) + 1);
+
+    // Negative mean squared error over the dataset, the same on every island.
+    const auto fitness = [&](Sequential &brain, size_t)
+    {
+        const Tensor out = brain.forward(X);
+        float sse = 0.f;
+        for (int i = 0; i < demo::kBatch; ++i)
+        {
+            const float d = out.data[i] - Y.data[i];
+            sse += d * d;
+        }
+        return -sse / demo::kBatch;
+    };
+
+    const auto t0 = std::chrono::steady_clock::now();
+    size_t immigrants = 0;
+    bool alone = false;
+    for (int g = 0; g <= generations; ++g)
+    {
+        population.evaluate(fitness);
+        if (!migrator.emigrate(population) && !alone)
+        {
+            LOG_WARN("no islands left to migrate to, evolving alone");
+            alone = true;
+        }
+        immigrants += migrator.immigrate(population);
+        if (g % 10 == 0)
+            LOG_INFO("island %d generation %d best mse %.5f (%zu immigrants so far)", island, g,
+                     -population.fitness()[population.best()], immigrants);
+        if (g < generations)
+            population.nextGeneration();
+    }
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    LOG_INFO("island %d: %.0f individuals/s, %llu migrants sent, %llu received", island,
+             (generations + 1) * size / secs, (unsigned long long)migrator.sent(),
+             (unsigned long long)migrator.received());
+    return 0;
+}
@@ -1,7 +1,9 @@
+#include "./DemoModel.hpp"
 #include "./network/MasterServer.hpp"
 #include "./network/net/Logger.hpp"
 
 #include <csignal>
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <thread>
@@ -23,6 +25,7 @@ void onSig(int) { g_stop.store(true); }
 int main(int argc, char **argv)
 {
     uint16_t port = 5050;
+    size_t expectedNodes = 8;
     if (argc > 1)
     {
         try
@@ -34,16 +37,19 @@ int main(int argc, char **argv)
             std::cerr << "Invalid port '" << argv[1] << "', using default 5050\n";
         }
     }
+    if (argc > 2)
+        expectedNodes = std::max(1, std::atoi(argv[2]));
 
     dist::MasterConfig cfg;
     cfg.bindAddress = "0.0.0.0"; // listen on all interfaces
     cfg.port = port;
-    cfg.maxNodes = 8; // <= accepts up to 8 concurrent node connections
+    cfg.maxNodes = std::max<size_t>(8, expectedNodes); // <= accepts up to 8 concurrent node connections
     cfg.listenBacklog = 8;
     cfg.heartbeatInterval = std::chrono::milliseconds(2000);
     cfg.heartbeatTimeout = std::chrono::milliseconds(6000);
 
     dist::MasterServer master(cfg);
+    master.set_layer_costs(ModelPartitioner::dense_layer_costs(demo::widths(), demo::kBatch));
     if (!master.start())
     {
         LOG_ERROR("Failed to start master on %s:%u", cfg.bindAddress.c_str(), unsigned(cfg.port));
@@ -61,6 +67,7 @@ int main(int argc, char **argv)
              cfg.bindAddress.c_str(), unsigned(cfg.port), cfg.maxNodes);
 
     size_t lastCount = 0;
+    bool configured = false;
     while (!g_stop.load())
     {
         auto snap = master.nodes();
@@ -74,6 +81,16 @@ int main(int argc, char **argv)
                 LOG_INFO("Reached max nodes (%zu). New connections will be rejected until a slot frees.", lastCount);
             }
         }
+        // Partition once the expected nodes are in and have all reported their resources.
+        if (!configured && snap.size() >= expectedNodes &&
+            std::all_of(snap.begin(), snap.end(), [](const auto &kv)
+                        { return kv.second.threads > 0; }))
+        {
+            master.compute_and_send_configs(master.get_total_layers_from_model(), master.get_bytes_per_layer());
+            configured = true;
+        }
+        if (master.jobFinished())
+            break;
         std::this_thread::sleep_for(std::chrono::milliseconds(500));
     }
 
@@ -1,40 +1,253 @@
+#include <algorithm>
 #include <iostream>
+#include <map>
+#include <set>
+#include "./DemoModel.hpp"
 #include "./network/NodeClient.hpp"
+#include "./network/PipelineStage.hpp"
 #include "./network/net/Logger.hpp"
 
+// Joins a master and trains whichever blocks of the demo model it is assigned as one
+// pipeline stage. When the master repartitions (a node died or fell behind) the node
+// tears its stage down, hands over the blocks it no longer owns, collects the ones it
+// gained and rejoins the new pipeline, until the master says SHUTDOWN.
+//   node <master_host> <master_port> [pipeline_port]
+
+using namespace NeuralNetwork;
+
+namespace
+{
+    constexpr uint32_t kStatsEvery = 10;      // batches between STAGE_STATS reports
+    constexpr uint32_t kCheckpointEvery = 25; // batches between WEIGHTS checkpoints
+
+    // A block's parameters between generations. The tensors move out of its Dense when
+    // a generation ends and back into the next one's; WEIGHTS are sent from and received
+    // into them, so they are never copied.
+    struct LayerParams
+    {
+        Tensor w, b;
+    };
+    using HeldLayers = std::map<int, LayerParams>;
+
+    LayerParams takeFromDense(Dense &d)
+    {
+        LayerParams p;
+        p.w = std::move(d.weights);
+        p.b = std::move(d.bias);
+        return p;
+    }
+
+    void toDense(LayerParams &&p, Dense &d)
+    {
+        if (p.w.dims != 2 || p.w.shape[0] != d.weights.shape[0] || p.w.shape[1] != d.weights.shape[1])
+        {
+            LOG_WARN("Layer shape mismatch, keeping fresh weights");
+            return;
+        }
+        ThreadPool *pool = d.weights.pool;
+        d.weights = std::move(p.w);
+        d.bias = std::move(p.b);
+        d.weights.setPool(pool);
+        d.bias.setPool(pool);
+    }
+
+    enum class Next
+    {
+        Config,
+        Shutdown,
+        Lost
+    };
+
+    // Waits for the next CONFIG (into cfg) or SHUTDOWN; stray WEIGHTS are stale relays.
+    Next waitForConfig(NodeClient &client, NodeConfig &cfg)
+    {
+        for (;;)
+        {
+            Inbound msg;
+            if (!client.waitMessage(msg, std::chrono::seconds(1)))
+            {
+                if (client.masterLost())
+                    return Next::Lost;
+                continue;
+            }
+            if (msg.type == dist::MsgType::SHUTDOWN)
+                return Next::Shutdown;
+            if (msg.type == dist::MsgType::CONFIG)
+            {
+                cfg = NodeClient::configFromJson(json::parse(msg.payload.begin(), msg.payload.end()));
+                return Next::Config;
+            }
+        }
+    }
+
+    // Runs one partition generation, then waits for the next CONFIG (into cfg).
+    Next runGeneration(NodeClient &client, NodeConfig &cfg, HeldLayers &held, uint16_t port, ThreadPool &pool)
+    {
+        // Hand over blocks that moved to another node; the master relays them.
+        const std::set<int> mine(cfg.layers.begin(), cfg.layers.end());
+        for (auto it = held.begin(); it != held.end();)
+        {
+            if (mine.count(it->first))
+            {
+                ++it;
+                continue;
+            }
+            client.sendLayer(cfg.generation, it->first, cfg.step, it->second.w, it->second.b);
+            it = held.erase(it);
+        }
+        if (cfg.layers.empty())
+        {
+            LOG_INFO("Generation %u: idle", cfg.generation);
+            return waitForConfig(client, cfg);
+        }
+
+        // Collect the blocks this node gained. If an owner vanished before handing
+        // over, the block restarts from fresh weights rather than stalling the job.
+        std::set<int> missing(cfg.await_layers.begin(), cfg.await_layers.end());
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+        while (!missing.empty())
+        {
+            Inbound msg;
+            if (!client.waitMessage(msg, std::chrono::milliseconds(500)))
+            {
+                if (client.masterLost())
+                    return Next::Lost;
+                if (std::chrono::steady_clock::now() > deadline)
+                {
+                    LOG_WARN("Generation %u: %zu layers never arrived, starting them fresh", cfg.generation, missing.size());
+                    break;
+                }
+                continue;
+            }
+            if (msg.type == dist::MsgType::SHUTDOWN)
+                return Next::Shutdown;
+            if (msg.type == dist::MsgType::CONFIG)
+            {
+                cfg = NodeClient::configFromJson(json::parse(msg.payload.begin(), msg.payload.end()));
+                return Next::Config;
+            }
+            if (msg.type != dist::MsgType::WEIGHTS)
+                continue;
+            const dist::LayerWeightsHeader &h = msg.layer.header;
+            if (h.generation != cfg.generation || !missing.count(int(h.layer)))
+                continue;
+            held[int(h.layer)] = LayerParams{std::move(msg.layer.weights), std::move(msg.layer.bias)};
+            missing.erase(int(h.layer));
+        }
+
+        LOG_INFO("Generation %u: stage %d, layers %d..%d, from step %u", cfg.generation, cfg.node_index,
+                 cfg.layers.front(), cfg.layers.back(), cfg.step);
+        Sequential net(pool);
+        std::vector<Dense *> dense;
+        for (int l : cfg.layers)
+        {
+            Dense *d = demo::addBlock(net, l);
+            if (auto it = held.find(l); it != held.end())
+            {
+                toDense(std::move(it->second), *d);
+                held.erase(it);
+            }
+            dense.push_back(d);
+        }
+
+        uint32_t step = cfg.step;
+        bool finished = false;
+        {
+            dist::PipelineStage pipe(net, cfg.is_first, cfg.is_last);
+            dist::PipelineStage::Stats reported;
+            auto checkpoint = [&]
+            {
+                for (size_t i = 0; i < dense.size(); ++i)
+                    client.sendLayer(cfg.generation, cfg.layers[i], step, dense[i]->weights, dense[i]->bias);
+            };
+            auto afterBatch = [&]
+            {
+                ++step;
+                if (step % kStatsEvery == 0)
+                {
+                    const auto now = pipe.stats();
+                    const uint64_t batches = now.batches - reported.batches;
+                    if (batches > 0)
+                    {
+                        const float spb = float((now.computeSeconds - reported.computeSeconds) / batches);
+                        client.send(dist::MsgType::STAGE_STATS,
+                                    dist::encodeStageStats({cfg.generation, step, spb, 0}));
+                    }
+                    reported = now;
+                }
+                if (step % kCheckpointEvery == 0)
+                    checkpoint();
+            };
+
+            if (!pipe.connect(port, cfg.next_node_addr))
+                LOG_ERROR("Generation %u: could not join the pipeline; waiting for a new split", cfg.generation);
+            else if (cfg.is_first)
+            {
+                Tensor X, Y;
+                demo::makeDataset(&pool, X, Y);
+                while (step < demo::kTrainSteps && !client.interrupted())
+                {
+                    float loss = 0.f;
+                    if (!pipe.trainBatch(X, Y, demo::kMicroBatches, demo::kLearningRate, loss))
+                        break;
+                    if (step % 20 == 0)
+                        LOG_INFO("step %u loss %.5f", step, loss);
+                    afterBatch();
+                }
+                finished = step >= demo::kTrainSteps;
+                pipe.shutdown();
+            }
+            else
+                pipe.serve(afterBatch);
+
+            if (finished)
+            {
+                checkpoint();
+                client.send(dist::MsgType::STAGE_STATS, dist::encodeStageStats({cfg.generation, step, 0.f, 1}));
+            }
+        }
+
+        for (size_t i = 0; i < dense.size(); ++i)
+            held[cfg.layers[i]] = takeFromDense(*dense[i]);
+        return waitForConfig(client, cfg);
+    }
+}
+
 int main(int argc, char **argv)
 {
     if (argc < 3)
     {
-        std::cerr << "usage: node <master_host> <master_port>\n";
+        std::cerr << "usage: node <master_host> <master_port> [pipeline_port]\n";
         return 1;
     }
     const std::string host = argv[1];
     const uint16_t port = static_cast<uint16_t>(std::stoi(argv[2]));
+    const uint16_t pipelinePort = argc > 3 ? static_cast<uint16_t>(std::stoi(argv[3])) : dist::kDefaultPipelinePort;
 
     NodeClient client(host, port);
+    client.setPipelinePort(pipelinePort);
     if (!client.connect())
         return 2;
 
     NodeConfig cfg;
     if (!client.sendSpecsAndAwaitConfig(cfg))
         return 3;
+    client.startControlLoop();
 
-    // Demo: allocate arrays according to config (replace with your NN allocs)
-    // ... e.g., std::vector<float> activations(cfg.array_size / sizeof(float));
-
-    // Demo output:
-    std::cout << "Node index: " << cfg.node_index
-              << " first=" << cfg.is_first
-              << " last=" << cfg.is_last
-              << " next=" << cfg.next_node_addr
-              << " layers=[";
-    for (size_t i = 0; i < cfg.layers.size(); ++i)
+    ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    HeldLayers held;
+    for (;;)
     {
-        std::cout << cfg.layers[i] << (i + 1 < cfg.layers.size() ? "," : "");
+        switch (runGeneration(client, cfg, held, pipelinePort, pool))
+        {
+        case Next::Config:
+            continue;
+        case Next::Shutdown:
+            LOG_INFO("Master ended the job");
+            return 0;
+        case Next::Lost:
+            LOG_ERROR("Lost the master");
+            return 4;
+        }
     }
-    std::cout << "] array_bytes=" << cfg.array_size << "\n";
-
-    // ... proceed to initialize local NeuralNetwork slice based on layers ...
-    return 0;
 }
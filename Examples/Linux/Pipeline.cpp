@@ -0,0 +1,59 @@
+#include <iostream>
+#include <string>
+#include "./DemoModel.hpp"
+#include "./network/PipelineStage.hpp"
+#include "./network/net/Logger.hpp"
+
+// Runs one stage of a pipeline-parallel MLP. Start the stages from last to first
+// (any order works; dialling retries), e.g. for three nodes:
+//   pipeline 2 3 5600                     # on node C
+//   pipeline 1 3 5600 <C-ip>:5600         # on node B
+//   pipeline 0 3 5600 <B-ip>:5600         # on node A, trains and prints the loss
+// The demo model is 8 Dense+ReLU blocks and a Dense+Sigmoid head, split evenly.
+
+using namespace NeuralNetwork;
+
+int main(int argc, char **argv)
+{
+    if (argc < 4)
+    {
+        std::cerr << "usage: pipeline <stage> <num_stages> <listen_port> [next_ip:port]\n";
+        return 1;
+    }
+    const int stage = std::stoi(argv[1]);
+    const int numStages = std::stoi(argv[2]);
+    const uint16_t port = static_cast<uint16_t>(std::stoi(argv[3]));
+    const std::string next = argc > 4 ? argv[4] : "";
+    const bool isFirst = stage == 0, isLast = stage == numStages - 1;
+    if (stage < 0 || stage >= numStages || (!isLast && next.empty()))
+    {
+        std::cerr << "bad stage arguments\n";
+        return 1;
+    }
+
+    ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    Sequential net(pool);
+    for (int b = stage * demo::kBlocks / numStages; b < (stage + 1) * demo::kBlocks / numStages; ++b)
+        demo::addBlock(net, b);
+
+    dist::PipelineStage pipe(net, isFirst, isLast);
+    if (!pipe.connect(port, next))
+        return 2;
+
+    if (!isFirst)
+        return pipe.serve() ? 0 : 3;
+
+    Tensor X, Y;
+    demo::makeDataset(&pool, X, Y);
+
+    for (int step = 0; step <= 200; ++step)
+    {
+        float loss = 0.f;
+        if (!pipe.trainBatch(X, Y, demo::kMicroBatches, demo::kLearningRate, loss))
+            return 3;
+        if (step % 20 == 0)
+            LOG_INFO("step %d loss %.5f", step, loss);
+    }
+    pipe.shutdown();
+    return 0;
+}
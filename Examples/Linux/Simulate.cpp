@@ -0,0 +1,45 @@
+#include <chrono>
+#include <string>
+#include "../Libraries/ParallelFor.h"
+#include "../Libraries/World.hpp"
+#include "./network/net/Logger.hpp"
+
+// Runs the blob world with blobs wandering at random and reports the tick rate.
+//   simulate [blobs] [ticks]
+
+int main(int argc, char **argv)
+{
+    const size_t blobs = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    const int ticks = argc > 2 ? std::stoi(argv[2]) : 200;
+
+    ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    sim::World world(pool);
+    world.spawnRandom(blobs, 42);
+    LOG_INFO("%zu blobs on %zu threads", world.size(), pool.size());
+
+    double tickSecs = 0.0;
+    for (int t = 0; t < ticks; ++t)
+    {
+        // Wander: a hash of (blob, tick) picks the turn and the throttle.
+        ParallelFor(pool, 0, int64_t(world.size()), [&](int64_t s, int64_t e)
+                    {
+            for (int64_t i = s; i < e; ++i)
+            {
+                uint32_t h = uint32_t(i) * 0x9E3779B9u ^ uint32_t(t) * 0x85EBCA6Bu;
+                h = (h ^ (h >> 16)) * 0x7feb352du;
+                h ^= h >> 15;
+                world.turn[i] = int8_t(int(h % 3) - 1);
+                world.throttle[i] = float(h >> 24) * (1.f / 255.f);
+            } }, ParallelCost::bytes(8.0));
+
+        const auto t0 = std::chrono::steady_clock::now();
+        const size_t dead = world.tick();
+        tickSecs += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        if (dead)
+            world.removeDead();
+        if (t % 50 == 0)
+            LOG_INFO("tick %d: %zu alive", t, world.size());
+    }
+    LOG_INFO("tick: %.2f ms, %.2f ns per blob", tickSecs * 1e3 / ticks, tickSecs * 1e9 / ticks / double(blobs));
+    return 0;
+}
@@ -0,0 +1,279 @@
+#include "./GradientCodec.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+namespace dist
+{
+
+    namespace
+    {
+        struct NamedCodec
+        {
+            Codec codec;
+            const char *name;
+        };
+        constexpr NamedCodec kCodecs[] = {
+            {Codec::None, "none"},
+            {Codec::FP16, "fp16"},
+            {Codec::BF16, "bf16"},
+            {Codec::Int8, "int8"},
+            {Codec::TopK, "topk"},
+        };
+
+        uint32_t floatBits(float f)
+        {
+            uint32_t x;
+            std::memcpy(&x, &f, 4);
+            return x;
+        }
+
+        float bitsFloat(uint32_t x)
+        {
+            float f;
+            std::memcpy(&f, &x, 4);
+            return f;
+        }
+    }
+
+    const char *codecName(Codec c)
+    {
+        for (const NamedCodec &n : kCodecs)
+            if (n.codec == c)
+                return n.name;
+        return "unknown";
+    }
+
+    bool codecFromName(const std::string &name, Codec &out)
+    {
+        for (const NamedCodec &n : kCodecs)
+            if (name == n.name)
+            {
+                out = n.codec;
+                return true;
+            }
+        return false;
+    }
+
+    nlohmann::json gradCodecToJson(const GradCodec &c)
+    {
+        nlohmann::json j;
+        j["grad_codec"] = codecName(c.codec);
+        j["topk_ratio"] = c.topkRatio;
+        return j;
+    }
+
+    GradCodec gradCodecFromJson(const nlohmann::json &j)
+    {
+        GradCodec c;
+        const std::string name = j.value("grad_codec", std::string("none"));
+        if (!codecFromName(name, c.codec))
+            throw std::runtime_error("Unknown gradient codec '" + name + "'");
+        c.topkRatio = j.value("topk_ratio", c.topkRatio);
+        if (!(c.topkRatio > 0.f && c.topkRatio <= 1.f))
+            throw std::runtime_error("topk_ratio must be in (0, 1]");
+        return c;
+    }
+
+    // ---------- dense codecs ----------
+
+    uint16_t floatToHalf(float f)
+    {
+        const uint32_t x = floatBits(f);
+        const uint32_t sign = (x >> 16) & 0x8000u;
+        uint32_t mant = x & 0x7fffffu;
+        const uint32_t fexp = (x >> 23) & 0xffu;
+        if (fexp == 0xffu) // inf / nan
+            return uint16_t(sign | 0x7c00u | (mant ? 0x200u : 0u));
+        const int exp = int(fexp) - 127 + 15;
+        if (exp >= 31)
+            return uint16_t(sign | 0x7c00u);
+        if (exp <= 0)
+        {
+            // Subnormal half: shift the full significand down, rounding to nearest even.
+            if (exp < -10)
+                return uint16_t(sign);
+            mant |= 0x800000u;
+            const int shift = 14 - exp;
+            uint32_t half = mant >> shift;
+            const uint32_t rem = mant & ((1u << shift) - 1u), mid = 1u << (shift - 1);
+            if (rem > mid || (rem == mid && (half & 1u)))
+                ++half;
+            return uint16_t(sign | half);
+        }
+        uint32_t half = (uint32_t(exp) << 10) | (mant >> 13);
+        const uint32_t rem = mant & 0x1fffu;
+        if (rem > 0x1000u || (rem == 0x1000u && (half & 1u)))
+            ++half; // a carry out of the mantissa bumps the exponent, up to inf
+        return uint16_t(sign | half);
+    }
+
+    float halfToFloat(uint16_t h)
+    {
+        const uint32_t sign = uint32_t(h & 0x8000u) << 16;
+        const uint32_t exp = (h >> 10) & 0x1fu, mant = h & 0x3ffu;
+        if (exp == 0)
+        {
+            const float v = std::ldexp(float(mant), -24);
+            return sign ? -v : v;
+        }
+        if (exp == 31)
+            return bitsFloat(sign | 0x7f800000u | (mant << 13));
+        return bitsFloat(sign | ((exp - 15 + 127) << 23) | (mant << 13));
+    }
+
+    uint16_t floatToBf16(float f)
+    {
+        const uint32_t x = floatBits(f);
+        if ((x & 0x7fffffffu) > 0x7f800000u) // nan: keep it quiet
+            return uint16_t((x >> 16) | 0x40u);
+        return uint16_t((x + 0x7fffu + ((x >> 16) & 1u)) >> 16);
+    }
+
+    float bf16ToFloat(uint16_t h)
+    {
+        return bitsFloat(uint32_t(h) << 16);
+    }
+
+    size_t encodedBytes(Codec c, size_t count)
+    {
+        switch (c)
+        {
+        case Codec::FP16:
+        case Codec::BF16:
+            return 2 * count;
+        case Codec::Int8:
+            return sizeof(float) + count;
+        case Codec::None:
+            return sizeof(float) * count;
+        default:
+            throw std::invalid_argument("not a dense codec");
+        }
+    }
+
+    void encodeValues(Codec c, const float *in, size_t count, uint8_t *out)
+    {
+        switch (c)
+        {
+        case Codec::FP16:
+        case Codec::BF16:
+        {
+            uint16_t *o = reinterpret_cast<uint16_t *>(out);
+            for (size_t i = 0; i < count; ++i)
+                o[i] = c == Codec::FP16 ? floatToHalf(in[i]) : floatToBf16(in[i]);
+            break;
+        }
+        case Codec::Int8:
+        {
+            // The scale comes from the finite values only: one inf would make it inf and
+            // decode every value as 0 * inf. Infinities saturate to +-127 steps and NaN
+            // is sent as 0, so a chunk never decodes to a non-finite value.
+            float maxAbs = 0.f;
+            for (size_t i = 0; i < count; ++i)
+            {
+                const float a = std::fabs(in[i]);
+                if (a <= std::numeric_limits<float>::max())
+                    maxAbs = std::max(maxAbs, a);
+            }
+            const float scale = maxAbs / 127.f;
+            const float inv = scale > 0.f ? 1.f / scale : 0.f;
+            std::memcpy(out, &scale, sizeof(scale));
+            int8_t *q = reinterpret_cast<int8_t *>(out + sizeof(scale));
+            for (size_t i = 0; i < count; ++i)
+            {
+                const float v = std::isinf(in[i]) ? std::copysign(127.f, in[i]) : in[i] * inv;
+                // NaN in, or 0 * inf when a subnormal scale overflows inv.
+                q[i] = std::isnan(v) ? 0 : int8_t(std::lrint(std::clamp(v, -127.f, 127.f)));
+            }
+            break;
+        }
+        case Codec::None:
+            std::memcpy(out, in, sizeof(float) * count);
+            break;
+        default:
+            throw std::invalid_argument("not a dense codec");
+        }
+    }
+
+    void decodeValues(Codec c, const uint8_t *in, size_t count, float *out)
+    {
+        switch (c)
+        {
+        case Codec::FP16:
+        case Codec::BF16:
+        {
+            const uint16_t *h = reinterpret_cast<const uint16_t *>(in);
+            for (size_t i = 0; i < count; ++i)
+                out[i] = c == Codec::FP16 ? halfToFloat(h[i]) : bf16ToFloat(h[i]);
+            break;
+        }
+        case Codec::Int8:
+        {
+            float scale;
+            std::memcpy(&scale, in, sizeof(scale));
+            const int8_t *q = reinterpret_cast<const int8_t *>(in + sizeof(scale));
+            for (size_t i = 0; i < count; ++i)
+                out[i] = float(q[i]) * scale;
+            break;
+        }
+        case Codec::None:
+            std::memcpy(out, in, sizeof(float) * count);
+            break;
+        default:
+            throw std::invalid_argument("not a dense codec");
+        }
+    }
+
+    // ---------- TopK ----------
+
+    void encodeTopK(float *residual, size_t count, size_t k, std::vector<uint8_t> &out)
+    {
+        k = std::min(k, count);
+        std::vector<uint32_t> idx(count);
+        std::iota(idx.begin(), idx.end(), 0u);
+        if (k < count)
+            std::nth_element(idx.begin(), idx.begin() + std::ptrdiff_t(k), idx.end(), [&](uint32_t a, uint32_t b)
+                             { return std::fabs(residual[a]) > std::fabs(residual[b]); });
+        idx.resize(k);
+        std::sort(idx.begin(), idx.end()); // sequential scatter on the receiving side
+
+        const uint32_t n = uint32_t(k);
+        out.resize(sizeof(n) + k * (sizeof(uint32_t) + sizeof(float)));
+        std::memcpy(out.data(), &n, sizeof(n));
+        uint8_t *ip = out.data() + sizeof(n);
+        uint8_t *vp = ip + k * sizeof(uint32_t);
+        std::memcpy(ip, idx.data(), k * sizeof(uint32_t));
+        for (size_t i = 0; i < k; ++i)
+        {
+            std::memcpy(vp + i * sizeof(float), &residual[idx[i]], sizeof(float));
+            residual[idx[i]] = 0.f;
+        }
+    }
+
+    void addTopK(const uint8_t *in, size_t len, float *dst, size_t count)
+    {
+        uint32_t n = 0;
+        if (len < sizeof(n))
+            throw std::runtime_error("TopK message too short");
+        std::memcpy(&n, in, sizeof(n));
+        if (len != sizeof(n) + size_t(n) * (sizeof(uint32_t) + sizeof(float)))
+            throw std::runtime_error("TopK message size mismatch");
+        const uint8_t *ip = in + sizeof(n);
+        const uint8_t *vp = ip + size_t(n) * sizeof(uint32_t);
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            uint32_t at;
+            float v;
+            std::memcpy(&at, ip + i * sizeof(uint32_t), sizeof(at));
+            std::memcpy(&v, vp + i * sizeof(float), sizeof(v));
+            if (at >= count)
+                throw std::runtime_error("TopK index out of range");
+            dst[at] += v;
+        }
+    }
+
+} // namespace dist
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../../Libraries/Third_Party/json.hpp"
+
+namespace dist
+{
+
+    // Lossy encodings for gradients on the wire. The dense codecs cut each value to
+    // 16 or 8 bits; TopK sends only the largest entries of each tensor and keeps the
+    // rest locally as a residual that is added back before the next selection (error
+    // feedback), so nothing is dropped for good, only delayed.
+    enum class Codec : uint8_t
+    {
+        None,
+        FP16, // IEEE half, round to nearest even
+        BF16, // top half of a float, round to nearest even
+        Int8, // one float scale per chunk, then max|x| / 127 steps; inf saturates, NaN sends 0
+        TopK, // (index, value) pairs of the largest |x|
+    };
+
+    // What a job uses; agreed on once per job through a CONFIG message.
+    struct GradCodec
+    {
+        Codec codec = Codec::None;
+        float topkRatio = 0.01f; // fraction of each tensor TopK sends
+    };
+
+    const char *codecName(Codec c);
+    // False for an unknown name ("none", "fp16", "bf16", "int8", "topk").
+    bool codecFromName(const std::string &name, Codec &out);
+
+    nlohmann::json gradCodecToJson(const GradCodec &c);
+    GradCodec gradCodecFromJson(const nlohmann::json &j); // throws on an unknown codec
+
+    // ---------- dense codecs (FP16, BF16, Int8) ----------
+
+    size_t encodedBytes(Codec c, size_t count);
+    void encodeValues(Codec c, const float *in, size_t count, uint8_t *out);
+    void decodeValues(Codec c, const uint8_t *in, size_t count, float *out);
+
+    uint16_t floatToHalf(float f);
+    float halfToFloat(uint16_t h);
+    uint16_t floatToBf16(float f);
+    float bf16ToFloat(uint16_t h);
+
+    // ---------- TopK ----------
+
+    // Moves the k largest-magnitude entries of residual (the gradient plus what was
+    // held back before) into out as [u32 n][u32 index * n][f32 value * n] and zeroes
+    // them in residual, which keeps the remainder for the next step.
+    void encodeTopK(float *residual, size_t count, size_t k, std::vector<uint8_t> &out);
+    // dst[index] += value for every pair in an encodeTopK message; throws if it is malformed.
+    void addTopK(const uint8_t *in, size_t len, float *dst, size_t count);
+
+} // namespace dist
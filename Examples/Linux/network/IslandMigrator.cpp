@@ -0,0 +1,227 @@
+#include "./IslandMigrator.hpp"
+#include "./net/Socket.hpp"
+#include "./net/Logger.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace dist
+{
+
+    IslandMigrator::IslandMigrator(int island, std::vector<std::string> islands, MigrationConfig cfg)
+        : island_(island), islands_(std::move(islands)), cfg_(cfg), rng_(cfg.seed ^ (uint64_t(island) << 32))
+    {
+        if (island_ < 0 || island_ >= int(islands_.size()))
+            throw std::invalid_argument("island index out of range");
+        if (cfg_.interval == 0)
+            throw std::invalid_argument("migration interval must be at least one generation");
+    }
+
+    IslandMigrator::~IslandMigrator()
+    {
+        close();
+    }
+
+    std::vector<int> IslandMigrator::destinations() const
+    {
+        const int n = islands();
+        if (cfg_.topology == MigrationTopology::Ring)
+            return {(island_ + 1) % n};
+        std::vector<int> all;
+        for (int i = 0; i < n; ++i)
+            if (i != island_)
+                all.push_back(i);
+        return all;
+    }
+
+    bool IslandMigrator::connect(uint16_t listenPort, std::chrono::milliseconds timeout)
+    {
+        const int n = islands();
+        if (n <= 1)
+            return true;
+
+        // Listen first so the other islands' dials land in the backlog while we dial.
+        const size_t incoming = cfg_.topology == MigrationTopology::Ring ? 1 : size_t(n - 1);
+        socket_t listener = listenTcpIPv4(listenPort, int(incoming));
+        if (listener == INVALID_SOCKET)
+            return false;
+
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        out_.resize(size_t(n));
+        for (int d : destinations())
+        {
+            std::string host, peerIp;
+            uint16_t port = 0;
+            if (!splitHostPort(islands_[size_t(d)], host, port))
+            {
+                LOG_ERROR("Bad address '%s' for island %d", islands_[size_t(d)].c_str(), d);
+                closesocket(listener);
+                return false;
+            }
+            socket_t s = INVALID_SOCKET;
+            while ((s = dialTcpIPv4(host, port, peerIp, false)) == INVALID_SOCKET)
+            {
+                if (std::chrono::steady_clock::now() > deadline)
+                {
+                    LOG_ERROR("Island %d at %s did not come up", d, islands_[size_t(d)].c_str());
+                    closesocket(listener);
+                    return false;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(250));
+            }
+            out_[size_t(d)] = std::make_unique<Connection>(s, peerIp);
+            out_[size_t(d)]->startWriter();
+        }
+
+        while (in_.size() < incoming)
+        {
+            std::string peerIp;
+            const socket_t s = waitReadable(listener, timeout) ? acceptTcp(listener, peerIp) : INVALID_SOCKET;
+            if (s == INVALID_SOCKET)
+            {
+                LOG_ERROR("Islands: accept failed after %zu of %zu links", in_.size(), incoming);
+                closesocket(listener);
+                return false;
+            }
+            in_.push_back(std::make_unique<Connection>(s, peerIp));
+        }
+        closesocket(listener);
+
+        for (auto &c : in_)
+            receivers_.emplace_back(&IslandMigrator::receiverLoop, this, std::ref(*c));
+        LOG_INFO("Island %d/%d linked (%s migration, %zu out, %zu in)", island_, n,
+                 cfg_.topology == MigrationTopology::Ring ? "ring" : "random", destinations().size(), in_.size());
+        return true;
+    }
+
+    void IslandMigrator::close()
+    {
+        closing_ = true;
+        // Writers send what is still queued before they stop.
+        out_.clear();
+        for (auto &c : in_)
+            ::shutdown(c->raw(), SHUT_RDWR);
+        for (auto &t : receivers_)
+            t.join();
+        receivers_.clear();
+        in_.clear();
+    }
+
+    uint64_t IslandMigrator::received() const
+    {
+        std::lock_guard<std::mutex> lk(inboxMu_);
+        return received_;
+    }
+
+    bool IslandMigrator::emigrate(const evo::Population &population)
+    {
+        if (islands() <= 1)
+            return true;
+        if (population.generation() < lastSent_ + cfg_.interval)
+            return true;
+        lastSent_ = population.generation();
+
+        const size_t count = std::min(cfg_.migrants, population.size());
+        const size_t length = population.genomeLength();
+        const std::vector<size_t> ranking = population.ranking();
+        std::vector<float> fitness(count), genomes(count * length);
+        for (size_t m = 0; m < count; ++m)
+        {
+            fitness[m] = population.fitness()[ranking[m]];
+            const float *g = population.genome(ranking[m]);
+            std::copy(g, g + length, genomes.data() + m * length);
+        }
+        const MigrantsHeader h{uint32_t(island_), uint32_t(population.generation()), uint32_t(count),
+                               uint32_t(length)};
+        const std::vector<uint8_t> payload = encodeMigrants(h, fitness.data(), genomes.data());
+
+        // A failed post means the island went away: drop it and try another.
+        for (;;)
+        {
+            std::vector<int> live;
+            for (size_t d = 0; d < out_.size(); ++d)
+                if (out_[d])
+                    live.push_back(int(d));
+            if (live.empty())
+                return false;
+            const int d = live[std::uniform_int_distribution<size_t>(0, live.size() - 1)(rng_)];
+            if (out_[size_t(d)]->post(MsgType::MIGRANTS, payload))
+            {
+                sent_ += count;
+                return true;
+            }
+            LOG_WARN("Island %d: island %d is gone, no more migrants for it", island_, d);
+            out_[size_t(d)].reset();
+        }
+    }
+
+    size_t IslandMigrator::immigrate(evo::Population &population)
+    {
+        std::deque<Batch> arrived;
+        {
+            std::lock_guard<std::mutex> lk(inboxMu_);
+            arrived.swap(inbox_);
+        }
+        if (arrived.empty())
+            return 0;
+
+        const size_t size = population.size();
+        const size_t length = population.genomeLength();
+        const size_t elites = population.config().elites;
+        const size_t room = size > elites ? size - elites : 0;
+        const std::vector<size_t> ranking = population.ranking();
+
+        // Newest first: with more migrants than room, the latest arrivals win.
+        size_t taken = 0;
+        for (auto it = arrived.rbegin(); it != arrived.rend() && taken < room; ++it)
+        {
+            const size_t count = it->fitness.size();
+            if (it->genomes.size() != count * length)
+            {
+                LOG_WARN("Island %d: migrants from island %u have another genome length", island_, it->island);
+                continue;
+            }
+            for (size_t m = 0; m < count && taken < room; ++m, ++taken)
+            {
+                const size_t slot = ranking[size - 1 - taken];
+                std::copy(it->genomes.data() + m * length, it->genomes.data() + (m + 1) * length,
+                          population.genome(slot));
+                population.setFitness(slot, it->fitness[m]);
+            }
+        }
+        return taken;
+    }
+
+    void IslandMigrator::receiverLoop(Connection &conn)
+    {
+        MsgType type{};
+        std::vector<uint8_t> payload;
+        while (conn.recvMessage(type, payload))
+        {
+            if (type != MsgType::MIGRANTS)
+            {
+                LOG_WARN("Island %d: unexpected message %d from %s", island_, int(type), conn.peerIp().c_str());
+                continue;
+            }
+            try
+            {
+                const float *fitness = nullptr, *genomes = nullptr;
+                const MigrantsHeader h = decodeMigrants(payload, fitness, genomes);
+                Batch b{h.island, std::vector<float>(fitness, fitness + h.count),
+                        std::vector<float>(genomes, genomes + size_t(h.count) * h.genomeLength)};
+                std::lock_guard<std::mutex> lk(inboxMu_);
+                inbox_.push_back(std::move(b));
+                if (inbox_.size() > cfg_.maxPending)
+                    inbox_.pop_front();
+                received_ += h.count;
+            }
+            catch (const std::exception &e)
+            {
+                LOG_WARN("Island %d: bad MIGRANTS from %s: %s", island_, conn.peerIp().c_str(), e.what());
+            }
+        }
+        if (!closing_)
+            LOG_INFO("Island %d: link from %s closed", island_, conn.peerIp().c_str());
+    }
+
+} // namespace dist
@@ -0,0 +1,107 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "./net/Connection.hpp"
+#include "./net/Protocol.hpp"
+#include "../../Libraries/Evolution.hpp"
+
+namespace dist
+{
+
+    // Where an island's emigrants go: always the next island (i + 1 mod n), or a fresh
+    // random other island every time.
+    enum class MigrationTopology
+    {
+        Ring,
+        Random
+    };
+
+    struct MigrationConfig
+    {
+        MigrationTopology topology = MigrationTopology::Ring;
+        uint32_t interval = 10; // generations between emigrations
+        size_t migrants = 2;    // the island's fittest individuals sent each time
+        size_t maxPending = 16; // arrived batches kept for immigrate(); older ones are dropped
+        uint64_t seed = 1;      // random destinations
+    };
+
+    // Island-model GA over the framed protocol: every island evolves its own
+    // evo::Population and now and then sends its best genomes to another island, which
+    // swaps them in for its worst. Nothing is synchronous. Emigrants are queued on a
+    // connection's writer thread and a receiver thread per incoming link files arriving
+    // batches in an inbox, so an island never waits on another: a slow or departed
+    // island just stops contributing migrants, and throughput grows with the islands.
+    //
+    // Per generation: population.evaluate(), then emigrate() and immigrate(), then
+    // population.nextGeneration(). Migrants keep the fitness their island gave them,
+    // so every island must score with the same fitness function.
+    class IslandMigrator
+    {
+    public:
+        // islands[i] is island i's "ip:port", this island's own entry included.
+        IslandMigrator(int island, std::vector<std::string> islands, MigrationConfig cfg = {});
+        ~IslandMigrator();
+
+        IslandMigrator(const IslandMigrator &) = delete;
+        IslandMigrator &operator=(const IslandMigrator &) = delete;
+
+        // Listen on listenPort, dial the islands this one sends to (retrying until
+        // timeout, they may still be starting) and accept the ones that send here: one
+        // each way on a ring, every other island when destinations are random.
+        bool connect(uint16_t listenPort, std::chrono::milliseconds timeout = std::chrono::seconds(30));
+
+        // Once every cfg.interval generations of population: queues its cfg.migrants
+        // fittest genomes for one destination and returns. False if no destination is
+        // left; islands that went away are dropped.
+        bool emigrate(const evo::Population &population);
+
+        // Replaces population's least fit individuals with the migrants that have
+        // arrived since the last call, genomes and fitness both, never its elites.
+        // Returns how many were taken; 0 without waiting if none have arrived.
+        size_t immigrate(evo::Population &population);
+
+        void close();
+
+        int island() const { return island_; }
+        int islands() const { return int(islands_.size()); }
+        uint64_t sent() const { return sent_; }
+        uint64_t received() const;
+
+    private:
+        struct Batch
+        {
+            uint32_t island;
+            std::vector<float> fitness;
+            std::vector<float> genomes; // [fitness.size(), genomeLength]
+        };
+
+        std::vector<int> destinations() const;
+        void receiverLoop(Connection &conn);
+
+        int island_;
+        std::vector<std::string> islands_;
+        MigrationConfig cfg_;
+        std::mt19937_64 rng_;
+        uint64_t lastSent_ = 0; // generation of the last emigration
+        uint64_t sent_ = 0;
+
+        std::vector<std::unique_ptr<Connection>> out_; // by island, null if not a destination
+        std::vector<std::unique_ptr<Connection>> in_;
+        std::vector<std::thread> receivers_;
+        std::atomic<bool> closing_{false};
+
+        mutable std::mutex inboxMu_;
+        std::deque<Batch> inbox_;
+        uint64_t received_ = 0;
+    };
+
+} // namespace dist
@@ -4,6 +4,7 @@
 #include <sstream>
 #include <iomanip>
 #include <cstring>
+#include <algorithm>
 
 #if defined(_WIN32)
 #pragma comment(lib, "ws2_32.lib")
@@ -48,8 +49,7 @@ namespace dist
 
     MasterServer::MasterServer(const MasterConfig &cfg)
         : cfg_(cfg),
-          registry_(),
-          pool_(std::max(2u, std::thread::hardware_concurrency())) // or reuse your project’s default ctor
+          registry_()
     {
         registry_.setMax(cfg_.maxNodes);
     }
@@ -117,11 +117,18 @@ namespace dist
             return true;
         stopping_.store(false);
 
+        if (!loop_.valid())
+        {
+            LOG_ERROR("Could not create the event loop");
+            return false;
+        }
         if (!setupListener())
             return false;
+        setNonBlocking(listener_);
+        loop_.add(listener_);
 
         running_.store(true);
-        acceptThread_ = std::thread(&MasterServer::acceptLoop, this);
+        ioThread_ = std::thread(&MasterServer::ioLoop, this);
         heartbeatThread_ = std::thread(&MasterServer::heartbeatLoop, this);
         return true;
     }
@@ -131,29 +138,84 @@ namespace dist
         if (!running_.load())
             return;
         stopping_.store(true);
+        loop_.wakeup();
 
-        teardownListener(); // unblocks accept
-
-        if (acceptThread_.joinable())
-            acceptThread_.join();
+        if (ioThread_.joinable())
+            ioThread_.join();
         if (heartbeatThread_.joinable())
             heartbeatThread_.join();
+        loop_.remove(listener_);
+        teardownListener();
 
-        // Close remaining connections in registry snapshot
-        for (auto &[id, info] : registry_.snapshot())
+        // The IO thread is gone: give queued output (e.g. a final SHUTDOWN) a moment to
+        // reach the kernel, then close every connection.
+        std::unordered_map<socket_t, std::shared_ptr<Peer>> peers;
         {
-            (void)id;
-            (void)info; // actual Connection instances are owned per-connection loops
-            // The connection loops close their sockets on exit.
+            std::lock_guard<std::mutex> lk(peersMu_);
+            peers.swap(peers_);
+        }
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        for (auto &[id, peer] : peers)
+        {
+            std::lock_guard<std::mutex> lk(peer->outMu);
+            while (!peer->closed && !peer->out.empty() && std::chrono::steady_clock::now() < deadline)
+            {
+                if (!flushLocked(*peer))
+                    break;
+                if (!peer->out.empty())
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            loop_.remove(id);
+            if (!peer->closed)
+            {
+                ::shutdown(id, SHUT_RDWR);
+                ::close(id);
+                peer->closed = true;
+            }
         }
 
         running_.store(false);
         LOG_INFO("Master stopped");
     }
 
-    void MasterServer::acceptLoop()
+    void MasterServer::ioLoop()
     {
+        std::vector<EventLoop::Event> events;
         while (!stopping_.load())
+        {
+            if (!loop_.wait(events, 500))
+            {
+                LOG_ERROR("Event loop wait failed");
+                break;
+            }
+            for (const EventLoop::Event &ev : events)
+            {
+                if (ev.fd == listener_)
+                {
+                    acceptPending();
+                    continue;
+                }
+                std::shared_ptr<Peer> peer = findPeer(ev.fd);
+                if (!peer)
+                    continue;
+                bool ok = true;
+                if (ev.readable || ev.hangup)
+                    ok = readFrom(*peer);
+                if (ok && ev.writable)
+                {
+                    std::lock_guard<std::mutex> lk(peer->outMu);
+                    ok = !peer->closed && flushLocked(*peer);
+                }
+                if (!ok)
+                    closePeer(peer);
+            }
+        }
+        LOG_INFO("IO loop exited");
+    }
+
+    void MasterServer::acceptPending()
+    {
+        for (;;)
         {
             sockaddr_in peerAddr{};
             socklen_t len = sizeof(peerAddr);
@@ -161,9 +223,9 @@ namespace dist
             socket_t s = ::accept(listener_, (sockaddr *)&peerAddr, &len);
             if (s == INVALID_SOCKET)
             {
-                if (!stopping_.load())
-                    LOG_WARN("accept() failed or interrupted");
-                break;
+                if (!wouldBlock())
+                    LOG_WARN("accept() failed");
+                return;
             }
 
             // Limit concurrent nodes
@@ -177,6 +239,7 @@ namespace dist
             // TCP_NODELAY helps small heartbeats
             int one = 1;
             setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<char *>(&one), sizeof(one));
+            setNonBlocking(s);
 
             std::string ip = ipFromSockaddr(peerAddr);
             LOG_INFO("Accepted connection from %s", ip.c_str());
@@ -188,82 +251,284 @@ namespace dist
             info.lastSeen = std::chrono::steady_clock::now();
             registry_.insert(s, info);
 
-            auto conn = std::make_shared<Connection>(s, ip);
-            // Spawn a blocking connection loop; dispatch message handling into ThreadPool
-            std::thread(&MasterServer::connectionLoop, this, conn).detach();
+            auto peer = std::make_shared<Peer>();
+            peer->fd = s;
+            peer->ip = ip;
+            {
+                std::lock_guard<std::mutex> lk(peersMu_);
+                peers_[s] = peer;
+            }
+            if (!loop_.add(s))
+            {
+                LOG_ERROR("Could not watch connection from %s", ip.c_str());
+                closePeer(peer);
+            }
         }
-        LOG_INFO("Accept loop exited");
     }
 
-    void MasterServer::connectionLoop(std::shared_ptr<Connection> conn)
+    std::shared_ptr<MasterServer::Peer> MasterServer::findPeer(socket_t id)
     {
-        auto id = conn->raw();
-        for (;;)
+        std::lock_guard<std::mutex> lk(peersMu_);
+        auto it = peers_.find(id);
+        return it == peers_.end() ? nullptr : it->second;
+    }
+
+    bool MasterServer::readFrom(Peer &p)
+    {
+        size_t budget = kReadBudget; // bound one connection's turn; level triggering brings us back
+        while (budget > 0)
         {
-            if (stopping_.load())
-                break;
-            MsgType type;
-            std::vector<uint8_t> payload;
-            if (!conn->recvMessage(type, payload))
+            // Large payloads land in their own buffer; headers and small frames are
+            // batched through the shared read buffer.
+            const bool direct = p.headLen == sizeof(p.head) && p.body.size() - p.bodyLen >= readBuf_.size();
+            uint8_t *dst = direct ? p.body.data() + p.bodyLen : readBuf_.data();
+            const size_t want = std::min(budget, direct ? p.body.size() - p.bodyLen : readBuf_.size());
+#if defined(_WIN32)
+            const int n = ::recv(p.fd, reinterpret_cast<char *>(dst), int(want), 0);
+#else
+            const ssize_t n = ::recv(p.fd, dst, want, 0);
+#endif
+            if (n == 0)
             {
-                LOG_WARN("Connection %s closed or errored", conn->peerIp().c_str());
-                registry_.markDead(id);
-                registry_.erase(id);
-                conn->close();
-                return;
+                LOG_WARN("Connection %s closed", p.ip.c_str());
+                return false;
+            }
+            if (n < 0)
+            {
+                if (wouldBlock())
+                    return true;
+                LOG_WARN("Connection %s errored", p.ip.c_str());
+                return false;
+            }
+            budget -= size_t(n);
+            if (direct)
+            {
+                p.bodyLen += size_t(n);
+                if (p.bodyLen == p.body.size() && !dispatch(p))
+                    return false;
             }
+            else if (!consume(p, readBuf_.data(), size_t(n)))
+                return false;
+            if (size_t(n) < want)
+                return true;
+        }
+        return true;
+    }
 
-            // Hand off processing to the thread pool to avoid heavy work in the IO loop:
-            pool_.enqueue([this, id, type, payload = std::move(payload)]() mutable
-                          {
-            switch (type) {
-                case MsgType::RESOURCE_REPORT: {
-                    try {
-                        auto rpt = decodeResourceReport(payload);
-                        registry_.update(id, [&](NodeInfo& n){
-                            n.ramBytes = rpt.ramBytes;
-                            n.threads  = rpt.threads;
-                            n.lastSeen = std::chrono::steady_clock::now();
-                            n.alive    = true;
-                        });
-                        LOG_INFO("Node[%d] resource report: RAM=%llu bytes, threads=%u",
-                                 int(id), (unsigned long long)rpt.ramBytes, (unsigned)rpt.threads);
-                    } catch (const std::exception& e) {
-                        LOG_ERROR("Bad RESOURCE_REPORT from node[%d]: %s", int(id), e.what());
-                    }
-                } break;
-
-                case MsgType::PONG: {
+    bool MasterServer::consume(Peer &p, const uint8_t *data, size_t n)
+    {
+        while (n > 0)
+        {
+            if (p.headLen < sizeof(p.head))
+            {
+                const size_t k = std::min(sizeof(p.head) - p.headLen, n);
+                std::memcpy(p.head + p.headLen, data, k);
+                p.headLen += k;
+                data += k;
+                n -= k;
+                if (p.headLen < sizeof(p.head))
+                    return true;
+                uint32_t lenN;
+                std::memcpy(&lenN, p.head, 4);
+                const uint32_t len = netToHost32(lenN);
+                if (len == 0)
+                {
+                    LOG_WARN("Received zero-length frame from %s", p.ip.c_str());
+                    return false;
+                }
+                p.body.resize(len - 1);
+                p.bodyLen = 0;
+                if (p.body.empty() && !dispatch(p))
+                    return false;
+                continue;
+            }
+            const size_t k = std::min(p.body.size() - p.bodyLen, n);
+            std::memcpy(p.body.data() + p.bodyLen, data, k);
+            p.bodyLen += k;
+            data += k;
+            n -= k;
+            if (p.bodyLen == p.body.size() && !dispatch(p))
+                return false;
+        }
+        return true;
+    }
+
+    bool MasterServer::dispatch(Peer &p)
+    {
+        MsgType type = static_cast<MsgType>(p.head[4]);
+        std::vector<uint8_t> payload;
+        payload.swap(p.body);
+        p.headLen = 0;
+        p.bodyLen = 0;
+        if (type == MsgType::CHUNK)
+        {
+            try
+            {
+                if (!appendChunk(p.partial, payload.data(), payload.size(), type))
+                    return true;
+            }
+            catch (const std::exception &e)
+            {
+                LOG_WARN("Bad CHUNK from %s: %s", p.ip.c_str(), e.what());
+                return false;
+            }
+            payload.swap(p.partial);
+            p.partial.clear();
+        }
+        handleMessage(p.fd, type, payload);
+        return true;
+    }
+
+    void MasterServer::handleMessage(socket_t id, MsgType type, std::vector<uint8_t> &payload)
+    {
+        switch (type) {
+            case MsgType::RESOURCE_REPORT: {
+                try {
+                    auto rpt = decodeResourceReport(payload);
                     registry_.update(id, [&](NodeInfo& n){
+                        n.ramBytes = rpt.ramBytes;
+                        n.threads  = rpt.threads;
                         n.lastSeen = std::chrono::steady_clock::now();
                         n.alive    = true;
                     });
-                    LOG_DEBUG("PONG from node[%d]", int(id));
-                } break;
-
-                case MsgType::PING: {
-                    // If workers ping, reply with PONG
-                    // We don't assume this path, but handle it for symmetry.
-                    // Find the connection by id and reply (best-effort).
-                    // (Connection object lifetime is owned by conn loop; reply from IO thread preferred.
-                    //  For simplicity here, we let the IO thread send after pool returns a flag — but to keep it
-                    //  simple and thread-safe we skip immediate reply. Optional.)
-                } break;
-
-                case MsgType::SHUTDOWN:
-                    // Worker is going down.
-                    registry_.markDead(id);
-                    LOG_INFO("Node[%d] requested shutdown", int(id));
-                    break;
+                    LOG_INFO("Node[%d] resource report: RAM=%llu bytes, threads=%u",
+                             int(id), (unsigned long long)rpt.ramBytes, (unsigned)rpt.threads);
+                } catch (const std::exception& e) {
+                    LOG_ERROR("Bad RESOURCE_REPORT from node[%d]: %s", int(id), e.what());
+                }
+            } break;
 
-                default:
-                    LOG_WARN("Unknown message type %u from node[%d]", (unsigned)type, int(id));
-                    break;
-            } });
+            case MsgType::RESOURCE_REPORT_EX: {
+                try {
+                    auto rpt = decodeCalibratedReport(payload);
+                    registry_.update(id, [&](NodeInfo& n){
+                        n.ramBytes = rpt.ramBytes;
+                        n.threads  = rpt.threads;
+                        n.gemmGflops = rpt.gemmGflops;
+                        n.memBandwidthGBs = rpt.memBandwidthGBs;
+                        n.loopbackLatencyUs = rpt.loopbackLatencyUs;
+                        n.pipelinePort = uint16_t(rpt.pipelinePort);
+                        n.lastSeen = std::chrono::steady_clock::now();
+                        n.alive    = true;
+                    });
+                    LOG_INFO("Node[%d] resource report: RAM=%llu bytes, threads=%u, %.1f GFLOP/s, %.1f GB/s, loopback %.1f us",
+                             int(id), (unsigned long long)rpt.ramBytes, (unsigned)rpt.threads,
+                             rpt.gemmGflops, rpt.memBandwidthGBs, rpt.loopbackLatencyUs);
+                } catch (const std::exception& e) {
+                    LOG_ERROR("Bad RESOURCE_REPORT_EX from node[%d]: %s", int(id), e.what());
+                }
+            } break;
+
+            case MsgType::WEIGHTS: {
+                try {
+                    onLayerWeights(id, payload);
+                } catch (const std::exception& e) {
+                    LOG_ERROR("Bad WEIGHTS from node[%d]: %s", int(id), e.what());
+                }
+            } break;
+
+            case MsgType::STAGE_STATS: {
+                try {
+                    onStageStats(id, decodeStageStats(payload));
+                } catch (const std::exception& e) {
+                    LOG_ERROR("Bad STAGE_STATS from node[%d]: %s", int(id), e.what());
+                }
+            } break;
+
+            case MsgType::PONG: {
+                registry_.update(id, [&](NodeInfo& n){
+                    n.lastSeen = std::chrono::steady_clock::now();
+                    n.alive    = true;
+                });
+                LOG_DEBUG("PONG from node[%d]", int(id));
+            } break;
+
+            case MsgType::PING: {
+                // If workers ping, reply with PONG; sends only queue, so this is safe on the IO thread.
+                sendTo(id, MsgType::PONG, {});
+            } break;
+
+            case MsgType::SHUTDOWN:
+                // Worker is going down.
+                registry_.markDead(id);
+                LOG_INFO("Node[%d] requested shutdown", int(id));
+                break;
+
+            default:
+                LOG_WARN("Unknown message type %u from node[%d]", (unsigned)type, int(id));
+                break;
         }
+    }
 
+    void MasterServer::closePeer(const std::shared_ptr<Peer> &peer)
+    {
+        const socket_t id = peer->fd;
+        loop_.remove(id);
+        {
+            std::lock_guard<std::mutex> lk(peersMu_);
+            peers_.erase(id);
+        }
+        {
+            // Senders holding this peer see closed and never touch the (reusable) fd.
+            std::lock_guard<std::mutex> lk(peer->outMu);
+            if (peer->closed)
+                return;
+            peer->closed = true;
+            ::shutdown(id, SHUT_RDWR);
+            ::close(id);
+        }
+        registry_.markDead(id);
         registry_.erase(id);
-        conn->close();
+        onNodeLost(id);
+    }
+
+    void MasterServer::disconnect(socket_t id)
+    {
+        if (auto peer = findPeer(id))
+        {
+            std::lock_guard<std::mutex> lk(peer->outMu);
+            if (!peer->closed)
+                ::shutdown(id, SHUT_RDWR); // the IO thread sees the hang-up and closes
+        }
+    }
+
+    bool MasterServer::flushLocked(Peer &p)
+    {
+        IoSlice slices[OutboundQueue::kMaxSlices];
+        while (!p.out.empty())
+        {
+            const size_t count = p.out.gather(slices, OutboundQueue::kMaxSlices);
+            const long n = sendSlices(p.fd, slices, count);
+            if (n < 0)
+                return false;
+            if (n == 0)
+                break;
+            p.out.consume(size_t(n));
+        }
+        const bool pending = !p.out.empty();
+        if (pending != p.wantWrite)
+        {
+            loop_.setWriteInterest(p.fd, pending);
+            p.wantWrite = pending;
+        }
+        return true;
+    }
+
+    bool MasterServer::sendTo(socket_t id, MsgType type, const std::vector<uint8_t> &payload)
+    {
+        std::shared_ptr<Peer> peer = findPeer(id);
+        if (!peer)
+            return false;
+        std::lock_guard<std::mutex> lk(peer->outMu);
+        if (peer->closed)
+            return false;
+        peer->out.push(type, payload);
+        if (!flushLocked(*peer))
+        {
+            ::shutdown(id, SHUT_RDWR);
+            return false;
+        }
+        return true;
     }
 
     void MasterServer::heartbeatLoop()
@@ -277,23 +542,7 @@ namespace dist
             for (auto &[id, info] : registry_.snapshot())
             {
                 (void)info;
-                // Best-effort send: create a new lightweight Connection wrapper around raw socket? We can’t duplicate.
-                // We will send using a tiny lambda that uses raw send. Since Connection is owned by IO thread,
-                // we do a one-off frame send here (it’s safe to write from another thread on TCP as long as app-level
-                // framing is used; to be conservative, production code would add a per-connection send mutex).
-                // For simplicity, we opportunistically send and ignore short races.
-
-                uint32_t len = hostToNet32(1);
-                uint8_t frame[5];
-                std::memcpy(frame, &len, 4);
-                frame[4] = static_cast<uint8_t>(MsgType::PING);
-
-#if defined(_WIN32)
-                int n = ::send(id, reinterpret_cast<const char *>(frame), 5, 0);
-#else
-                ssize_t n = ::send(id, frame, 5, MSG_NOSIGNAL);
-#endif
-                if (n != 5)
+                if (!sendTo(id, MsgType::PING, {}))
                 {
                     LOG_WARN("Failed to send PING to node[%d]", int(id));
                 }
@@ -307,9 +556,9 @@ namespace dist
                 if (elapsed > cfg_.heartbeatTimeout)
                 {
                     LOG_WARN("Node[%d] timed out (%lld ms) — removing", int(id), (long long)elapsed.count());
-                    registry_.erase(id);
-                    ::shutdown(id, SHUT_RDWR);
-                    ::close(id);
+                    // The IO thread sees the hang-up, closes the socket and repartitions.
+                    registry_.markDead(id);
+                    disconnect(id);
                 }
             }
 
@@ -327,16 +576,16 @@ namespace dist
 namespace dist
 {
 
-    void MasterServer::on_client_connect(Connection c)
+    void MasterServer::on_client_connect(Connection &c)
     {
         (void)c;
         LOG_INFO("on_client_connect hook invoked (placeholder).");
     }
 
-    void MasterServer::on_client_connected(Connection c)
+    void MasterServer::on_client_connected(Connection &c)
     {
         // For compatibility, call the same hook.
-        on_client_connect(std::move(c));
+        on_client_connect(c);
     }
 
     void MasterServer::on_message(Connection &c, const std::string &payload)
@@ -351,9 +600,9 @@ namespace dist
         auto snap = registry_.snapshot();
         LOG_INFO("Resource summary for %zu nodes:", snap.size());
         std::ostringstream oss;
-        oss << "\n+--------+---------------+-------------+---------+\n";
-        oss << "| socket | ip            | RAM(bytes)  | threads |\n";
-        oss << "+--------+---------------+-------------+---------+\n";
+        oss << "\n+--------+---------------+-------------+---------+--------+--------+\n";
+        oss << "| socket | ip            | RAM(bytes)  | threads | GFLOPS | GB/s   |\n";
+        oss << "+--------+---------------+-------------+---------+--------+--------+\n";
         for (auto &kv : snap)
         {
             auto id = kv.first;
@@ -362,9 +611,11 @@ namespace dist
                 << " | " << std::setw(13) << n.ip
                 << " | " << std::setw(11) << n.ramBytes
                 << " | " << std::setw(7) << n.threads
+                << " | " << std::setw(6) << std::fixed << std::setprecision(1) << n.gemmGflops
+                << " | " << std::setw(6) << n.memBandwidthGBs
                 << " |\n";
         }
-        oss << "+--------+---------------+-------------+---------+\n";
+        oss << "+--------+---------------+-------------+---------+--------+--------+\n";
         LOG_INFO("%s", oss.str().c_str());
     }
 
@@ -380,9 +631,249 @@ namespace dist
 
     void MasterServer::compute_and_send_configs(int total_layers, std::uint64_t bytes_per_layer)
     {
-        (void)total_layers;
-        (void)bytes_per_layer;
-        LOG_WARN("compute_and_send_configs is a placeholder; integrate your partitioner if needed.");
+        std::vector<LayerCost> costs = layerCosts_;
+        if (costs.empty())
+        {
+            // Uniform layers: cost proportional to size.
+            LayerCost uniform;
+            uniform.flops = double(bytes_per_layer);
+            uniform.bytes = bytes_per_layer;
+            costs.assign(std::max(0, total_layers), uniform);
+        }
+
+        std::lock_guard<std::mutex> lk(jobMu_);
+        jobCosts_ = std::move(costs);
+        jobActive_ = true;
+        jobFinished_.store(false);
+        repartitionLocked("initial");
+    }
+
+    std::vector<NodeCompute> MasterServer::liveNodesLocked(std::vector<socket_t> &ids) const
+    {
+        // Chain order is by IP so reruns with the same cluster give the same pipeline.
+        auto snap = registry_.snapshot();
+        snap.erase(std::remove_if(snap.begin(), snap.end(), [](const auto &kv)
+                                  { return !kv.second.alive || kv.second.threads == 0; }),
+                   snap.end());
+        std::sort(snap.begin(), snap.end(), [](const auto &a, const auto &b)
+                  { return a.second.ip != b.second.ip ? a.second.ip < b.second.ip : a.first < b.first; });
+
+        std::vector<NodeCompute> nodes;
+        ids.clear();
+        for (const auto &[id, info] : snap)
+        {
+            const uint16_t port = info.pipelinePort ? info.pipelinePort : kDefaultPipelinePort;
+            NodeCompute n{info.ip + ":" + std::to_string(port), info.ramBytes / (1024ull * 1024ull),
+                          info.threads, info.gemmGflops, info.memBandwidthGBs};
+            // Throughput seen while training beats the connect-time calibration; it
+            // already includes memory stalls, so drop the bandwidth bound.
+            if (auto it = measuredGflops_.find(id); it != measuredGflops_.end())
+            {
+                n.gflops = it->second;
+                n.mem_gbs = 0.0;
+            }
+            nodes.push_back(n);
+            ids.push_back(id);
+        }
+        return nodes;
+    }
+
+    void MasterServer::repartitionLocked(const char *reason)
+    {
+        std::vector<socket_t> ids;
+        const std::vector<NodeCompute> nodes = liveNodesLocked(ids);
+        std::vector<NodeAssignment> plan;
+        try
+        {
+            plan = ModelPartitioner::partition_by_capacity(nodes, jobCosts_);
+        }
+        catch (const std::exception &e)
+        {
+            LOG_ERROR("Partitioning failed: %s", e.what());
+            return;
+        }
+        if (plan.empty())
+        {
+            LOG_ERROR("Repartition (%s): no live nodes", reason);
+            return;
+        }
+
+        ++generation_;
+        generationStartStep_ = jobStep_;
+        stageSeconds_.clear();
+        pendingRelay_.clear();
+        LOG_INFO("Repartition (%s): generation %u over %zu nodes from step %u",
+                 reason, generation_, plan.size(), jobStep_);
+
+        // Nodes left out of the chain still get a CONFIG (no layers) so they stop waiting.
+        std::vector<NodeAssignment> perNode(ids.size());
+        std::vector<int> stageOf(ids.size(), -1);
+        for (size_t s = 0; s < plan.size(); ++s)
+        {
+            perNode[plan[s].node_index] = plan[s];
+            stageOf[plan[s].node_index] = int(s);
+        }
+        const std::unordered_set<socket_t> live(ids.begin(), ids.end());
+
+        std::vector<StagePlan> newPlan;
+        std::unordered_map<int, socket_t> newOwner;
+        std::vector<std::vector<int>> fromCheckpoint(ids.size());
+        for (size_t i = 0; i < ids.size(); ++i)
+        {
+            const NodeAssignment &a = perNode[i];
+            // A layer moving off a live node is uploaded by that node and relayed; one
+            // whose owner is gone comes from its checkpoint; one with neither starts fresh.
+            std::vector<int> await;
+            for (int l : a.layers)
+            {
+                newOwner[l] = ids[i];
+                auto old = owner_.find(l);
+                if (old != owner_.end() && old->second == ids[i])
+                    continue;
+                if (old != owner_.end() && live.count(old->second))
+                {
+                    await.push_back(l);
+                    pendingRelay_.insert(l);
+                }
+                else if (checkpoints_.count(l))
+                {
+                    await.push_back(l);
+                    fromCheckpoint[i].push_back(l);
+                }
+            }
+
+            nlohmann::json j = ModelPartitioner::to_config_json(a, stageOf[i]);
+            j["generation"] = generation_;
+            j["step"] = jobStep_;
+            j["await_layers"] = await;
+            const std::string text = j.dump();
+            if (a.layers.empty())
+                LOG_INFO("Node[%d] %s: no layers", int(ids[i]), nodes[i].addr.c_str());
+            else
+            {
+                LOG_INFO("Node[%d] %s: stage %d, layers %d..%d, %llu bytes, est %.2f ms/step", int(ids[i]),
+                         nodes[i].addr.c_str(), stageOf[i], a.layers.front(), a.layers.back(),
+                         (unsigned long long)a.array_bytes, a.est_seconds * 1e3);
+                newPlan.push_back(StagePlan{ids[i], a});
+            }
+            if (!sendTo(ids[i], MsgType::CONFIG, std::vector<uint8_t>(text.begin(), text.end())))
+                LOG_WARN("Failed to send CONFIG to node[%d]", int(ids[i]));
+        }
+
+        for (size_t i = 0; i < ids.size(); ++i)
+        {
+            for (int l : fromCheckpoint[i])
+            {
+                std::vector<uint8_t> payload = checkpoints_[l].second;
+                setLayerWeightsGeneration(payload, generation_);
+                if (!sendTo(ids[i], MsgType::WEIGHTS, payload))
+                    LOG_WARN("Failed to send layer %d to node[%d]", l, int(ids[i]));
+            }
+        }
+
+        owner_ = std::move(newOwner);
+        plan_ = std::move(newPlan);
+    }
+
+    void MasterServer::onNodeLost(socket_t id)
+    {
+        std::lock_guard<std::mutex> lk(jobMu_);
+        measuredGflops_.erase(id);
+        if (!jobActive_)
+            return;
+        const bool inPlan = std::any_of(plan_.begin(), plan_.end(), [&](const StagePlan &s)
+                                        { return s.id == id; });
+        if (inPlan)
+            repartitionLocked("node lost");
+    }
+
+    void MasterServer::onLayerWeights(socket_t id, std::vector<uint8_t> &payload)
+    {
+        const float *w = nullptr, *b = nullptr;
+        const LayerWeightsHeader h = decodeLayerWeights(payload, w, b);
+        const int layer = int(h.layer);
+
+        std::lock_guard<std::mutex> lk(jobMu_);
+        auto &ckpt = checkpoints_[layer];
+        if (ckpt.second.empty() || h.step >= ckpt.first)
+            ckpt = {h.step, payload};
+
+        auto owner = owner_.find(layer);
+        if (pendingRelay_.count(layer) && owner != owner_.end() && owner->second != id)
+        {
+            setLayerWeightsGeneration(payload, generation_);
+            if (!sendTo(owner->second, MsgType::WEIGHTS, payload))
+                LOG_WARN("Failed to relay layer %d to node[%d]", layer, int(owner->second));
+            pendingRelay_.erase(layer);
+            LOG_DEBUG("Relayed layer %d: node[%d] -> node[%d]", layer, int(id), int(owner->second));
+        }
+    }
+
+    void MasterServer::onStageStats(socket_t id, const StageStatsPayload &stats)
+    {
+        std::lock_guard<std::mutex> lk(jobMu_);
+        if (!jobActive_)
+            return;
+        if (stats.done)
+        {
+            LOG_INFO("Training finished at step %u; shutting nodes down", stats.step);
+            jobActive_ = false;
+            jobFinished_.store(true);
+            for (const auto &kv : registry_.snapshot())
+                sendTo(kv.first, MsgType::SHUTDOWN, {});
+            return;
+        }
+        if (stats.generation != generation_ || stats.secondsPerBatch <= 0.f)
+            return;
+        auto me = std::find_if(plan_.begin(), plan_.end(), [&](const StagePlan &s)
+                               { return s.id == id; });
+        if (me == plan_.end())
+            return;
+        if (me == plan_.begin())
+            jobStep_ = std::max(jobStep_, stats.step);
+
+        double flops = 0.0;
+        for (int l : me->a.layers)
+            flops += jobCosts_[l].flops;
+        stageSeconds_[id] = stats.secondsPerBatch;
+        measuredGflops_[id] = flops / stats.secondsPerBatch * 1e-9;
+
+        if (stageSeconds_.size() < plan_.size() || jobStep_ < generationStartStep_ + cfg_.rebalanceMinSteps)
+            return;
+
+        // Compare the current split's slowest stage with the best split under the
+        // speeds we just measured.
+        std::vector<socket_t> ids;
+        const std::vector<NodeCompute> nodes = liveNodesLocked(ids);
+        double current = 0.0;
+        for (const StagePlan &s : plan_)
+        {
+            const size_t i = size_t(std::find(ids.begin(), ids.end(), s.id) - ids.begin());
+            if (i == ids.size())
+                return; // a stage is gone; onNodeLost handles it
+            current = std::max(current, ModelPartitioner::estimate_seconds(
+                                            nodes[i], jobCosts_, s.a.layers.front(), s.a.layers.back() + 1));
+        }
+        double best = 0.0;
+        try
+        {
+            for (const NodeAssignment &a : ModelPartitioner::partition_by_capacity(nodes, jobCosts_))
+                best = std::max(best, a.est_seconds);
+        }
+        catch (const std::exception &)
+        {
+            return;
+        }
+        if (best < (1.0 - cfg_.rebalanceGain) * current)
+        {
+            LOG_INFO("Straggler: slowest stage %.2f ms/step, rebalanced split %.2f ms/step", current * 1e3, best * 1e3);
+            repartitionLocked("straggler");
+        }
+        else
+        {
+            // Don't re-evaluate on every report once the split is known to be good.
+            generationStartStep_ = jobStep_;
+        }
     }
 
 } // namespace dist
@@ -1,4 +1,5 @@
 #pragma once
+#include <array>
 #include <cstdint>
 #include <string>
 #include <atomic>
@@ -6,9 +7,14 @@
 #include <vector>
 #include <functional>
 #include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include "./net/EventLoop.hpp"
 #include "./net/Registry.hpp"
-#include "../../Libraries/ThreadPool.hpp"
 #include "./net/Protocol.hpp"
+#include "../../Libraries/ModelPartitioner.hpp"
 
 namespace dist
 {
@@ -21,6 +27,11 @@ namespace dist
         std::chrono::milliseconds heartbeatInterval{2000};
         std::chrono::milliseconds heartbeatTimeout{6000};
         int listenBacklog = 8;
+        // Repartition around a straggler once every stage has reported timing, at least
+        // rebalanceMinSteps steps have run on the current split, and the new split's
+        // slowest stage would be at least rebalanceGain faster.
+        uint32_t rebalanceMinSteps = 30;
+        double rebalanceGain = 0.2;
     };
 
     class MasterServer
@@ -29,7 +40,7 @@ namespace dist
         explicit MasterServer(const MasterConfig &cfg);
         ~MasterServer();
 
-        bool start(); // create listener, start accept + heartbeat threads
+        bool start(); // create listener, start IO + heartbeat threads
         void stop();  // graceful shutdown
         bool isRunning() const { return running_.load(); }
 
@@ -37,34 +48,106 @@ namespace dist
         std::vector<std::pair<socket_t, NodeInfo>> nodes() const { return registry_.snapshot(); }
 
         // --- Added for event hooks & utilities ---
-        void on_client_connect(Connection c);
-        void on_client_connected(Connection c);
+        void on_client_connect(Connection &c);
+        void on_client_connected(Connection &c);
         void on_message(Connection &c, const std::string &payload);
         void print_resource_table();
         int get_total_layers_from_model() const;
         std::uint64_t get_bytes_per_layer() const;
+        // Partitions the model across the reported nodes and sends each its CONFIG.
+        // Uses the per-layer costs from set_layer_costs when given, else uniform layers.
         void compute_and_send_configs(int total_layers, std::uint64_t bytes_per_layer);
+        void set_layer_costs(std::vector<LayerCost> costs) { layerCosts_ = std::move(costs); }
+        // The first stage reported the end of training and every node was told to shut down.
+        bool jobFinished() const { return jobFinished_.load(); }
         // --- end added ---
 
     private:
-        void acceptLoop();
-        void connectionLoop(std::shared_ptr<Connection> conn);
+        // One IO thread serves every node: the listener and all connections are
+        // non-blocking and multiplexed through loop_. Frames are reassembled per
+        // connection and handled on the IO thread in arrival order; sends from any
+        // thread queue on the connection's lanes and write what the socket takes,
+        // leaving the rest for the IO thread to flush when it becomes writable.
+        struct Peer
+        {
+            socket_t fd = INVALID_SOCKET;
+            std::string ip;
+            // Frame being received (IO thread only).
+            uint8_t head[5];
+            size_t headLen = 0;
+            std::vector<uint8_t> body;
+            size_t bodyLen = 0;
+            std::vector<uint8_t> partial; // CHUNK pieces of a bulk message
+            // Frames waiting for the socket (outMu).
+            std::mutex outMu;
+            OutboundQueue out;
+            bool wantWrite = false;
+            bool closed = false;
+        };
+        static constexpr size_t kReadBudget = 1 << 20; // bytes read from one connection per wakeup
+
+        void ioLoop();
+        void acceptPending();
+        bool readFrom(Peer &p);
+        bool consume(Peer &p, const uint8_t *data, size_t n);
+        bool dispatch(Peer &p);
+        void handleMessage(socket_t id, MsgType type, std::vector<uint8_t> &payload);
+        void closePeer(const std::shared_ptr<Peer> &peer);
+        void disconnect(socket_t id); // from any thread; the IO thread closes
+        std::shared_ptr<Peer> findPeer(socket_t id);
+        bool flushLocked(Peer &p);
         void heartbeatLoop();
 
         bool setupListener();
         void teardownListener();
 
+        // Queues one frame; false if the node is gone.
+        bool sendTo(socket_t id, MsgType type, const std::vector<uint8_t> &payload);
+
+        // Training job: the current split, where each layer lives, and the last
+        // checkpoint of every layer. A node that dies or falls behind triggers a new
+        // generation: a fresh split over the live nodes, with layer weights moving
+        // from their old owner (or the checkpoint, if it died) through the master.
+        struct StagePlan
+        {
+            socket_t id;
+            NodeAssignment a;
+        };
+        void repartitionLocked(const char *reason);
+        std::vector<NodeCompute> liveNodesLocked(std::vector<socket_t> &ids) const;
+        void onNodeLost(socket_t id);
+        void onLayerWeights(socket_t id, std::vector<uint8_t> &payload);
+        void onStageStats(socket_t id, const StageStatsPayload &stats);
+
     private:
         MasterConfig cfg_;
         std::atomic<bool> running_{false};
         std::atomic<bool> stopping_{false};
 
         socket_t listener_{INVALID_SOCKET};
-        std::thread acceptThread_;
+        EventLoop loop_;
+        std::thread ioThread_;
+        std::array<uint8_t, 64 * 1024> readBuf_; // IO thread only
         std::thread heartbeatThread_;
 
         ConnectionRegistry registry_;
-        ThreadPool pool_; // reuse your ThreadPool for message processing
+        std::mutex peersMu_;
+        std::unordered_map<socket_t, std::shared_ptr<Peer>> peers_;
+        std::vector<LayerCost> layerCosts_;
+
+        std::mutex jobMu_;
+        bool jobActive_ = false;
+        std::atomic<bool> jobFinished_{false};
+        std::vector<LayerCost> jobCosts_;
+        uint32_t generation_ = 0;
+        uint32_t jobStep_ = 0;             // steps the first stage has finished
+        uint32_t generationStartStep_ = 0; // jobStep_ when the current split started
+        std::vector<StagePlan> plan_;
+        std::unordered_map<int, socket_t> owner_;
+        std::unordered_map<int, std::pair<uint32_t, std::vector<uint8_t>>> checkpoints_; // layer -> (step, WEIGHTS)
+        std::unordered_set<int> pendingRelay_;                // moving off a live node, not yet relayed
+        std::unordered_map<socket_t, double> stageSeconds_;   // this generation
+        std::unordered_map<socket_t, double> measuredGflops_; // from stage timing, replaces calibration
     };
 
 } // namespace dist
@@ -1,4 +1,7 @@
 #include "NodeClient.hpp"
+#include "./net/Socket.hpp"
+#include "../../Libraries/System_Benchmark.hpp"
+#include "../../Libraries/ThreadPool.hpp"
 
 #include <cstring>
 #include <thread>
@@ -25,92 +28,6 @@ using namespace std::chrono_literals;
 namespace
 {
 
-    // create a TCP socket and connect to host:port (IPv4)
-    // returns INVALID_SOCKET on failure
-    static socket_t dialTcpIPv4(const std::string &host, uint16_t port, std::string &outPeerIp)
-    {
-#if defined(_WIN32)
-        WSADATA wsa{};
-        if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
-        {
-            LOG_ERROR("WSAStartup failed");
-            return INVALID_SOCKET;
-        }
-#endif
-
-        socket_t s = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-        if (s == INVALID_SOCKET)
-        {
-            LOG_ERROR("socket() failed");
-            return INVALID_SOCKET;
-        }
-
-        // TCP_NODELAY (optional, helps interactive control messages)
-        int one = 1;
-        ::setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<char *>(&one), sizeof(one));
-
-        sockaddr_in sin{};
-        sin.sin_family = AF_INET;
-        sin.sin_port = htons(port);
-
-        // try to parse as dotted quad; if that fails, resolve
-        if (::inet_pton(AF_INET, host.c_str(), &sin.sin_addr) != 1)
-        {
-#if defined(_WIN32)
-            addrinfoW hints{};
-            hints.ai_family = AF_INET;
-            hints.ai_socktype = SOCK_STREAM;
-            hints.ai_protocol = IPPROTO_TCP;
-            wchar_t whost[256]{};
-            mbstowcs(whost, host.c_str(), sizeof(whost) / sizeof(wchar_t) - 1);
-            addrinfoW *res = nullptr;
-            if (GetAddrInfoW(whost, nullptr, &hints, &res) != 0 || !res)
-            {
-                LOG_ERROR("DNS resolve failed for host '%s'", host.c_str());
-                closesocket(s);
-                return INVALID_SOCKET;
-            }
-            // take first A record
-            sockaddr_in *ain = reinterpret_cast<sockaddr_in *>(res->ai_addr);
-            sin.sin_addr = ain->sin_addr;
-            FreeAddrInfoW(res);
-#else
-            addrinfo hints{};
-            hints.ai_family = AF_INET;
-            hints.ai_socktype = SOCK_STREAM;
-            hints.ai_protocol = IPPROTO_TCP;
-            addrinfo *res = nullptr;
-            if (::getaddrinfo(host.c_str(), nullptr, &hints, &res) != 0 || !res)
-            {
-                LOG_ERROR("DNS resolve failed for host '%s'", host.c_str());
-                ::close(s);
-                return INVALID_SOCKET;
-            }
-            // take first A record
-            sockaddr_in *ain = reinterpret_cast<sockaddr_in *>(res->ai_addr);
-            sin.sin_addr = ain->sin_addr;
-            ::freeaddrinfo(res);
-#endif
-        }
-
-        if (::connect(s, reinterpret_cast<sockaddr *>(&sin), sizeof(sin)) != 0)
-        {
-#if defined(_WIN32)
-            LOG_ERROR("connect() failed with %d", int(WSAGetLastError()));
-            closesocket(s);
-#else
-            LOG_ERROR("connect() failed: %s", std::strerror(errno));
-            ::close(s);
-#endif
-            return INVALID_SOCKET;
-        }
-
-        char ipbuf[INET_ADDRSTRLEN]{};
-        ::inet_ntop(AF_INET, &sin.sin_addr, ipbuf, sizeof(ipbuf));
-        outPeerIp = ipbuf;
-        return s;
-    }
-
 #if defined(_WIN32)
     static uint64_t totalRamBytes()
     {
@@ -158,10 +75,20 @@ NodeClient::NodeClient(std::string masterHost, uint16_t masterPort)
 {
 }
 
+NodeClient::~NodeClient()
+{
+    conn_.stopWriter(); // flush final checkpoints and stats before hanging up
+    if (control_.joinable())
+    {
+        ::shutdown(conn_.raw(), SHUT_RDWR); // wakes the control thread's recv
+        control_.join();
+    }
+}
+
 bool NodeClient::connect()
 {
     std::string peerIp;
-    socket_t s = dialTcpIPv4(masterHost_, masterPort_, peerIp);
+    socket_t s = dist::dialTcpIPv4(masterHost_, masterPort_, peerIp);
     if (s == INVALID_SOCKET)
     {
         LOG_ERROR("Failed to connect to %s:%u", masterHost_.c_str(), unsigned(masterPort_));
@@ -171,6 +98,7 @@ bool NodeClient::connect()
     // Destroy the placeholder Connection and reconstruct in-place with the live socket.
     conn_.~Connection();
     new (&conn_) dist::Connection(s, peerIp);
+    conn_.startWriter();
 
     LOG_INFO("Connected to master %s:%u (peer=%s)", masterHost_.c_str(),
              unsigned(masterPort_), peerIp.c_str());
@@ -182,44 +110,49 @@ bool NodeClient::sendSpecsAndAwaitConfig(NodeConfig &outConfig)
     // Gather host specs
     NodeSpecs specs = gatherSpecs();
 
-    // Translate to current wire payload (ResourceReportPayload = total RAM bytes, hardware threads)
-    dist::ResourceReportPayload pld{};
+    // Measure what this machine actually sustains; thread counts alone don't tell
+    // an old laptop from a newer desktop.
+    sys_bench::Calibration cal;
+    {
+        ThreadPool pool(specs.hardware_threads > 0 ? specs.hardware_threads : 1);
+        cal = sys_bench::calibrate(pool);
+    }
+
+    dist::CalibratedReportPayload pld{};
     pld.ramBytes = (specs.ram_mb_free > 0) ? (specs.ram_mb_free * 1024ull * 1024ull) : totalRamBytes();
     pld.threads = specs.hardware_threads > 0 ? specs.hardware_threads : 1;
+    pld.gemmGflops = float(cal.gemm_gflops);
+    pld.memBandwidthGBs = float(cal.mem_bandwidth_gbs);
+    pld.loopbackLatencyUs = float(cal.loopback_latency_us);
+    pld.pipelinePort = pipelinePort_;
 
-    std::vector<uint8_t> payload = dist::encodeResourceReport(pld);
+    std::vector<uint8_t> payload = dist::encodeCalibratedReport(pld);
 
-    if (!conn_.sendMessage(dist::MsgType::RESOURCE_REPORT, payload))
+    if (!send(dist::MsgType::RESOURCE_REPORT_EX, payload))
     {
-        LOG_ERROR("Failed to send RESOURCE_REPORT to master");
+        LOG_ERROR("Failed to send RESOURCE_REPORT_EX to master");
         return false;
     }
-    LOG_INFO("Sent RESOURCE_REPORT: ram=%llu bytes, threads=%u",
-             static_cast<unsigned long long>(pld.ramBytes), pld.threads);
+    LOG_INFO("Sent RESOURCE_REPORT_EX: ram=%llu bytes, threads=%u, %.1f GFLOP/s, %.1f GB/s, loopback %.1f us",
+             static_cast<unsigned long long>(pld.ramBytes), pld.threads,
+             cal.gemm_gflops, cal.mem_bandwidth_gbs, cal.loopback_latency_us);
 
-    // With the protocol you provided, there is no explicit "config" message.
-    // We’ll service keepalives and return true once the report is sent.
-    // If/when you add a CONFIG message, handle it in the switch below.
-    auto start = std::chrono::steady_clock::now();
+    // The master sends CONFIG once every node has reported; answer keepalives until then.
     while (true)
     {
-        // Soft, brief window to answer an immediate PING or SHUTDOWN after connect
-        if (std::chrono::steady_clock::now() - start > 500ms)
-            break;
-
         dist::MsgType type{};
         std::vector<uint8_t> in;
         if (!conn_.recvMessage(type, in))
         {
-            // Non-fatal: if master sends nothing in the short window, we’re done.
-            break;
+            LOG_ERROR("Lost the master before receiving CONFIG");
+            return false;
         }
         switch (type)
         {
         case dist::MsgType::PING:
         {
             LOG_DEBUG("Received PING; replying PONG");
-            conn_.sendMessage(dist::MsgType::PONG, {});
+            send(dist::MsgType::PONG, {});
             break;
         }
         case dist::MsgType::SHUTDOWN:
@@ -227,18 +160,87 @@ bool NodeClient::sendSpecsAndAwaitConfig(NodeConfig &outConfig)
             LOG_WARN("Received SHUTDOWN from master");
             return false;
         }
-        // Placeholder for future: CONFIG
-        // case dist::MsgType::CONFIG:
-        //   parse config (e.g., JSON or binary), fill outConfig, return true;
-        //   break;
+        case dist::MsgType::CONFIG:
+        {
+            try
+            {
+                outConfig = configFromJson(json::parse(in.begin(), in.end()));
+            }
+            catch (const std::exception &e)
+            {
+                LOG_ERROR("Bad CONFIG from master: %s", e.what());
+                return false;
+            }
+            LOG_INFO("Received CONFIG: node_index=%d, %zu layers", outConfig.node_index, outConfig.layers.size());
+            return true;
+        }
         default:
             LOG_WARN("Unexpected message type %u from master", unsigned(type));
             break;
         }
     }
+}
+
+bool NodeClient::send(dist::MsgType type, const std::vector<uint8_t> &payload)
+{
+    return conn_.post(type, payload);
+}
 
-    // No config defined in current protocol; leave defaults and report success of the handshake.
-    outConfig = NodeConfig{};
+bool NodeClient::sendLayer(uint32_t generation, int layer, uint32_t step, const NeuralNetwork::Tensor &weights,
+                           const NeuralNetwork::Tensor &bias)
+{
+    return dist::sendLayerWeights(conn_, generation, uint32_t(layer), step, weights, bias);
+}
+
+void NodeClient::startControlLoop()
+{
+    control_ = std::thread([this]
+                           {
+        dist::LayerReceiver weights; // WEIGHTS land in their tensors, not in msg.payload
+        Inbound msg;
+        while (conn_.recvMessage(msg.type, msg.payload, dist::MsgType::WEIGHTS, &weights))
+        {
+            if (msg.type == dist::MsgType::PING)
+            {
+                send(dist::MsgType::PONG, {});
+                continue;
+            }
+            if (msg.type == dist::MsgType::WEIGHTS)
+            {
+                try
+                {
+                    msg.layer = weights.take();
+                }
+                catch (const std::exception &e)
+                {
+                    LOG_WARN("Bad WEIGHTS from master: %s", e.what());
+                    continue;
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lk(inboxMu_);
+                if (msg.type == dist::MsgType::CONFIG || msg.type == dist::MsgType::SHUTDOWN)
+                    ++pendingControl_;
+                inbox_.push_back(std::move(msg));
+            }
+            inboxCv_.notify_all();
+            msg = {};
+        }
+        lost_.store(true);
+        inboxCv_.notify_all(); });
+}
+
+bool NodeClient::waitMessage(Inbound &msg, std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lk(inboxMu_);
+    if (!inboxCv_.wait_for(lk, timeout, [this]
+                           { return !inbox_.empty() || lost_.load(); }) ||
+        inbox_.empty())
+        return false;
+    msg = std::move(inbox_.front());
+    inbox_.pop_front();
+    if (msg.type == dist::MsgType::CONFIG || msg.type == dist::MsgType::SHUTDOWN)
+        --pendingControl_;
     return true;
 }
 
@@ -258,8 +260,7 @@ NodeSpecs NodeClient::gatherSpecs()
     return s;
 }
 
-// These JSON helpers are present because NodeClient.hpp declares them.
-// They’re not used by the current wire protocol, but we provide minimal definitions.
+// configFromJson reads the CONFIG payload (keys from ModelPartitioner::to_config_json).
 json NodeClient::specsToJson(const NodeSpecs &s)
 {
     json j;
@@ -284,5 +285,11 @@ NodeConfig NodeClient::configFromJson(const json &j)
         c.array_size = j["array_size"].get<std::uint64_t>();
     if (j.contains("next_node_addr"))
         c.next_node_addr = j["next_node_addr"].get<std::string>();
+    if (j.contains("generation"))
+        c.generation = j["generation"].get<uint32_t>();
+    if (j.contains("step"))
+        c.step = j["step"].get<uint32_t>();
+    if (j.contains("await_layers"))
+        c.await_layers = j["await_layers"].get<std::vector<int>>();
     return c;
 }
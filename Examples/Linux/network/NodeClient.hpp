@@ -3,10 +3,17 @@
 #include <cstdint>
 #include <vector>
 #include <optional>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 
 #include "./net/Connection.hpp"
 #include "./net/Protocol.hpp"
 #include "./net/Logger.hpp"
+#include "./TensorTransfer.hpp"
 
 #include "../../Libraries/System_Info.hpp"
 
@@ -28,15 +35,48 @@ struct NodeConfig
     std::vector<int> layers;      // layer indices assigned to this node
     std::uint64_t array_size = 0; // bytes to allocate for temp buffers
     std::string next_node_addr;   // "ip:port", empty if last
+    uint32_t generation = 0;      // bumped by the master on every repartition
+    uint32_t step = 0;            // training step to resume from
+    std::vector<int> await_layers; // layers whose weights the master will send (WEIGHTS)
+};
+
+// A message from the master. WEIGHTS arrive already in layer's tensors, with an empty payload.
+struct Inbound
+{
+    dist::MsgType type{};
+    std::vector<uint8_t> payload;
+    dist::LayerTensors layer;
 };
 
 class NodeClient
 {
 public:
     NodeClient(std::string masterHost, uint16_t masterPort);
+    ~NodeClient();
     bool connect();
     bool sendSpecsAndAwaitConfig(NodeConfig &outConfig);
 
+    // Reported to the master so it can point the previous stage here.
+    void setPipelinePort(uint16_t port) { pipelinePort_ = port; }
+
+    // After the first CONFIG: a background thread answers PINGs and queues everything
+    // else (CONFIG, WEIGHTS, SHUTDOWN) for waitMessage.
+    void startControlLoop();
+    // False on timeout or once the master is gone (see masterLost).
+    bool waitMessage(Inbound &msg, std::chrono::milliseconds timeout);
+    // A CONFIG or SHUTDOWN is queued: the current pipeline should wind down.
+    bool interrupted() const { return pendingControl_.load() > 0; }
+    bool masterLost() const { return lost_.load(); }
+    // Queues the message; safe to call from any thread. Control messages overtake
+    // queued bulk data such as WEIGHTS.
+    bool send(dist::MsgType type, const std::vector<uint8_t> &payload);
+    // Sends a layer's parameters (WEIGHTS) straight from its tensors; returns once they
+    // are written, so the caller may train them again.
+    bool sendLayer(uint32_t generation, int layer, uint32_t step, const NeuralNetwork::Tensor &weights,
+                   const NeuralNetwork::Tensor &bias);
+
+    static NodeConfig configFromJson(const json &j);
+
 private:
     std::string masterHost_;
     uint16_t masterPort_;
@@ -44,5 +84,12 @@ private:
 
     static NodeSpecs gatherSpecs();
     static json specsToJson(const NodeSpecs &s);
-    static NodeConfig configFromJson(const json &j);
+
+    uint16_t pipelinePort_ = dist::kDefaultPipelinePort;
+    std::mutex inboxMu_;
+    std::condition_variable inboxCv_;
+    std::deque<Inbound> inbox_;
+    std::atomic<int> pendingControl_{0};
+    std::atomic<bool> lost_{false};
+    std::thread control_;
 };
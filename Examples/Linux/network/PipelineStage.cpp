@@ -0,0 +1,462 @@
+#include "./PipelineStage.hpp"
+#include "./net/Socket.hpp"
+#include "./net/Logger.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+
+namespace dist
+{
+
+    using NeuralNetwork::Tensor;
+
+    namespace
+    {
+        double secondsSince(std::chrono::steady_clock::time_point t0)
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        }
+    }
+
+    // ---------- FrameQueue ----------
+
+    void PipelineStage::FrameQueue::push(Frame f)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            q_.push_back(std::move(f));
+        }
+        cv_.notify_one();
+    }
+
+    bool PipelineStage::FrameQueue::pop(Frame &out)
+    {
+        std::unique_lock<std::mutex> lock(mu_);
+        cv_.wait(lock, [this]
+                 { return closed_ || !q_.empty(); });
+        if (q_.empty())
+            return false;
+        out = std::move(q_.front());
+        q_.pop_front();
+        return true;
+    }
+
+    bool PipelineStage::FrameQueue::tryPop(Frame &out)
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        if (q_.empty())
+            return false;
+        out = std::move(q_.front());
+        q_.pop_front();
+        return true;
+    }
+
+    void PipelineStage::FrameQueue::close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            closed_ = true;
+        }
+        cv_.notify_all();
+    }
+
+    // ---------- setup / teardown ----------
+
+    PipelineStage::PipelineStage(NeuralNetwork::Sequential &model, bool isFirst, bool isLast)
+        : model_(model), pool_(&model.pool), isFirst_(isFirst), isLast_(isLast)
+    {
+        model_.setDeferUpdates(true);
+    }
+
+    PipelineStage::~PipelineStage()
+    {
+        shutdown();
+        model_.setDeferUpdates(false);
+    }
+
+    bool PipelineStage::connect(uint16_t listenPort, const std::string &nextAddr,
+                                std::chrono::milliseconds connectTimeout)
+    {
+        // Listen before dialling so the previous stage's connect lands in our backlog
+        // while we are still waiting on the next stage.
+        if (!isFirst_)
+        {
+            listener_ = listenTcpIPv4(listenPort, 1);
+            if (listener_ == INVALID_SOCKET)
+                return false;
+        }
+
+        if (!isLast_)
+        {
+            std::string host, peerIp;
+            uint16_t port = 0;
+            if (!splitHostPort(nextAddr, host, port))
+            {
+                LOG_ERROR("Bad next stage address '%s'", nextAddr.c_str());
+                return false;
+            }
+            const auto deadline = std::chrono::steady_clock::now() + connectTimeout;
+            socket_t s = INVALID_SOCKET;
+            while ((s = dialTcpIPv4(host, port, peerIp, false)) == INVALID_SOCKET)
+            {
+                if (std::chrono::steady_clock::now() > deadline)
+                {
+                    LOG_ERROR("Next stage %s did not come up", nextAddr.c_str());
+                    return false;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(250));
+            }
+            next_.conn = std::make_unique<Connection>(s, peerIp);
+            LOG_INFO("Pipeline: connected to next stage %s", nextAddr.c_str());
+        }
+
+        if (!isFirst_)
+        {
+            std::string peerIp;
+            socket_t s = waitReadable(listener_, connectTimeout) ? acceptTcp(listener_, peerIp) : INVALID_SOCKET;
+            closesocket(listener_);
+            listener_ = INVALID_SOCKET;
+            if (s == INVALID_SOCKET)
+            {
+                LOG_ERROR("Pipeline: accept from previous stage failed");
+                return false;
+            }
+            prev_.conn = std::make_unique<Connection>(s, peerIp);
+            LOG_INFO("Pipeline: previous stage connected from %s", peerIp.c_str());
+        }
+
+        startLink(prev_);
+        startLink(next_);
+        return true;
+    }
+
+    void PipelineStage::startLink(Link &link)
+    {
+        if (!link.conn)
+            return;
+        Connection *conn = link.conn.get();
+        link.sender = std::thread([conn, &link]
+                                  {
+            Frame f;
+            while (link.outbox.pop(f))
+            {
+                if (!sendFrame(*conn, f))
+                {
+                    LOG_ERROR("Pipeline: send to %s failed", conn->peerIp().c_str());
+                    break;
+                }
+                // The frame's tensors were allocated by the compute thread; don't let
+                // this thread's arena cache hoard them.
+                f = Frame{};
+                NeuralNetwork::TensorArena::trim();
+            } });
+        link.receiver = std::thread([this, conn]
+                                    {
+            Frame f;
+            while (recvFrame(*conn, f))
+                inbox_.push(std::move(f));
+            inbox_.close(); });
+    }
+
+    bool PipelineStage::sendFrame(Connection &conn, const Frame &f)
+    {
+        if (!isTensorFrame(f.type))
+            return conn.sendMessage(f.type, f.payload);
+        uint8_t head[kTensorFrameHeaderBytes];
+        encodeTensorFrameHeader(f.header, head);
+        const IoSlice parts[3] = {{head, sizeof(head)},
+                                  {f.values.data, sizeof(float) * size_t(f.values.length())},
+                                  {f.targets.data, f.targets.data ? sizeof(float) * size_t(f.targets.length()) : 0}};
+        return conn.sendParts(f.type, parts, 3);
+    }
+
+    bool PipelineStage::recvFrame(Connection &conn, Frame &f)
+    {
+        uint32_t len = 0;
+        f = Frame{};
+        if (!conn.recvFrameHeader(f.type, len))
+            return false;
+        if (!isTensorFrame(f.type))
+        {
+            f.payload.resize(len);
+            return conn.recvPayload(f.payload.data(), len);
+        }
+
+        uint8_t head[kTensorFrameHeaderBytes];
+        if (len < sizeof(head) || !conn.recvPayload(head, sizeof(head)))
+            return false;
+        try
+        {
+            f.header = decodeTensorFrameHeader(head, len);
+        }
+        catch (const std::exception &e)
+        {
+            LOG_ERROR("Pipeline: %s from %s", e.what(), conn.peerIp().c_str());
+            return false;
+        }
+        const int values[2] = {int(f.header.rows), int(f.header.cols)};
+        f.values = Tensor::uninitialized(2, pool_, values);
+        if (!conn.recvPayload(f.values.data, sizeof(float) * size_t(f.values.length())))
+            return false;
+        if (f.header.targetCols)
+        {
+            const int targets[2] = {int(f.header.rows), int(f.header.targetCols)};
+            f.targets = Tensor::uninitialized(2, pool_, targets);
+            if (!conn.recvPayload(f.targets.data, sizeof(float) * size_t(f.targets.length())))
+                return false;
+        }
+        return true;
+    }
+
+    void PipelineStage::stopLink(Link &link)
+    {
+        if (!link.conn)
+            return;
+        // Flush what we queued, half-close, then wait for the peer to close its side so
+        // nothing in flight is cut off by a reset.
+        link.outbox.close();
+        if (link.sender.joinable())
+            link.sender.join();
+        ::shutdown(link.conn->raw(), SHUT_WR);
+        if (link.receiver.joinable())
+            link.receiver.join();
+        link.conn.reset();
+    }
+
+    void PipelineStage::shutdown()
+    {
+        if (isFirst_ && next_.conn && !shutdownSent_)
+        {
+            next_.outbox.push(Frame(MsgType::SHUTDOWN));
+            shutdownSent_ = true;
+        }
+        stopLink(prev_);
+        stopLink(next_);
+        if (listener_ != INVALID_SOCKET)
+        {
+            closesocket(listener_);
+            listener_ = INVALID_SOCKET;
+        }
+    }
+
+    // ---------- schedule ----------
+
+    bool PipelineStage::trainBatch(const Tensor &X, const Tensor &Y, int microBatches, float lr, float &lossOut)
+    {
+        if (!isFirst_)
+        {
+            LOG_ERROR("trainBatch is only valid on the first pipeline stage");
+            return false;
+        }
+        if (X.dims != 2 || Y.dims != 2 || X.shape[0] != Y.shape[0])
+        {
+            LOG_ERROR("trainBatch expects X [batch, in] and Y [batch, out]");
+            return false;
+        }
+
+        const int rows = X.shape[0];
+        const int M = std::max(1, std::min(microBatches, rows));
+        beginBatch(uint32_t(M), uint32_t(rows), lr);
+
+        try
+        {
+            for (int m = 0; m < M; ++m)
+            {
+                const int r0 = int(int64_t(rows) * m / M), r1 = int(int64_t(rows) * (m + 1) / M);
+                Tensor x = X.sliceRows(r0, r1);
+                const Tensor t = Y.sliceRows(r0, r1).contiguous();
+
+                const auto t0 = std::chrono::steady_clock::now();
+                Tensor y = model_.forward(x);
+                stats_.computeSeconds += secondsSince(t0);
+                inputs_[m] = std::move(x);
+                liveMicroBatch_ = m;
+
+                if (isLast_)
+                {
+                    float loss = 0.f;
+                    const Tensor g = lossGradient(y, t, loss);
+                    runBackward(m, g, loss);
+                    continue;
+                }
+
+                Frame out(MsgType::ACTIVATION);
+                out.values = y.contiguous();
+                out.targets = t.view();
+                out.header = TensorFrameHeader{uint32_t(m), uint32_t(M), uint32_t(rows), uint32_t(r1 - r0),
+                                               uint32_t(out.values.shape[1]), uint32_t(t.shape[1]), lr, 0.f};
+                next_.outbox.push(std::move(out));
+
+                // Fold in gradients that have already come back before the next forward.
+                Frame f;
+                while (inbox_.tryPop(f))
+                    handleFrame(f);
+            }
+
+            while (gradientsDone_ < numMicroBatches_)
+            {
+                Frame f;
+                if (!inbox_.pop(f))
+                {
+                    LOG_ERROR("Pipeline: lost the next stage mid-batch");
+                    return false;
+                }
+                handleFrame(f);
+            }
+        }
+        catch (const std::exception &e)
+        {
+            LOG_ERROR("Pipeline: %s", e.what());
+            return false;
+        }
+
+        lossOut = batchLoss_;
+        return true;
+    }
+
+    bool PipelineStage::serve(const std::function<void()> &afterBatch)
+    {
+        if (isFirst_)
+        {
+            LOG_ERROR("serve is not valid on the first pipeline stage");
+            return false;
+        }
+        try
+        {
+            Frame f;
+            while (inbox_.pop(f))
+            {
+                if (f.type == MsgType::SHUTDOWN)
+                {
+                    if (next_.conn)
+                        next_.outbox.push(Frame(MsgType::SHUTDOWN));
+                    return true;
+                }
+                const uint64_t before = stats_.batches;
+                handleFrame(f);
+                if (afterBatch && stats_.batches != before)
+                    afterBatch();
+            }
+        }
+        catch (const std::exception &e)
+        {
+            LOG_ERROR("Pipeline: %s", e.what());
+            return false;
+        }
+        LOG_ERROR("Pipeline: link closed without SHUTDOWN");
+        return false;
+    }
+
+    bool PipelineStage::handleFrame(Frame &f)
+    {
+        switch (f.type)
+        {
+        case MsgType::ACTIVATION:
+            handleActivation(f);
+            return true;
+        case MsgType::GRADIENT:
+            handleGradient(f);
+            return true;
+        default:
+            LOG_WARN("Pipeline: unexpected message type %u", unsigned(f.type));
+            return false;
+        }
+    }
+
+    void PipelineStage::beginBatch(uint32_t numMicroBatches, uint32_t batchRows, float lr)
+    {
+        numMicroBatches_ = numMicroBatches;
+        batchRows_ = batchRows;
+        lr_ = lr;
+        gradientsDone_ = 0;
+        batchLoss_ = 0.f;
+        liveMicroBatch_ = -1;
+        inputs_.assign(numMicroBatches, Tensor());
+        targets_.assign(isLast_ ? numMicroBatches : 0, Tensor());
+    }
+
+    void PipelineStage::handleActivation(Frame &f)
+    {
+        TensorFrameHeader h = f.header;
+        if (h.microBatch == 0)
+            beginBatch(h.numMicroBatches, h.batchRows, h.learningRate);
+        const int m = int(h.microBatch);
+        if (m >= int(numMicroBatches_))
+            throw std::runtime_error("ACTIVATION for a micro-batch outside the current batch");
+
+        Tensor x = std::move(f.values);
+        const auto t0 = std::chrono::steady_clock::now();
+        Tensor y = model_.forward(x);
+        stats_.computeSeconds += secondsSince(t0);
+        inputs_[m] = std::move(x);
+        liveMicroBatch_ = m;
+
+        if (isLast_)
+        {
+            Tensor t = f.targets.data ? std::move(f.targets) : Tensor(2, pool_, {int(h.rows), int(h.targetCols)});
+            float loss = 0.f;
+            const Tensor g = lossGradient(y, t, loss);
+            runBackward(m, g, loss);
+            return;
+        }
+
+        Frame out(MsgType::ACTIVATION);
+        out.values = y.contiguous();
+        out.targets = std::move(f.targets); // passed through to the last stage
+        h.cols = uint32_t(out.values.shape[1]);
+        out.header = h;
+        next_.outbox.push(std::move(out));
+    }
+
+    void PipelineStage::handleGradient(Frame &f)
+    {
+        const int m = int(f.header.microBatch);
+        if (m >= int(numMicroBatches_) || !inputs_[m].data)
+            throw std::runtime_error("GRADIENT for a micro-batch that is not in flight");
+        runBackward(m, f.values, f.header.loss);
+    }
+
+    void PipelineStage::runBackward(int m, const Tensor &grad, float loss)
+    {
+        const auto t0 = std::chrono::steady_clock::now();
+        if (liveMicroBatch_ != m)
+            model_.forward(inputs_[m]); // rematerialise this micro-batch's layer state
+        Tensor gx = model_.backward(grad, lr_);
+        stats_.computeSeconds += secondsSince(t0);
+        liveMicroBatch_ = -1;
+        inputs_[m] = Tensor();
+        batchLoss_ += loss;
+
+        if (!isFirst_)
+        {
+            Frame out(MsgType::GRADIENT);
+            out.values = gx.contiguous();
+            out.header = TensorFrameHeader{uint32_t(m), numMicroBatches_, batchRows_, uint32_t(out.values.shape[0]),
+                                           uint32_t(out.values.shape[1]), 0, lr_, loss};
+            prev_.outbox.push(std::move(out));
+        }
+
+        if (++gradientsDone_ == numMicroBatches_)
+        {
+            model_.applyUpdates(lr_);
+            ++stats_.batches;
+        }
+    }
+
+    // d/dy of sum((y - t)^2) / batchRows, so micro-batch gradients add up to the batch gradient.
+    Tensor PipelineStage::lossGradient(const Tensor &y, const Tensor &target, float &loss) const
+    {
+        Tensor g = y - target;
+        const float scale = 2.f / float(batchRows_);
+        double sum = 0.0;
+        for (uint64_t i = 0; i < g.length(); ++i)
+        {
+            sum += double(g.data[i]) * g.data[i];
+            g.data[i] *= scale;
+        }
+        loss = float(sum / batchRows_);
+        return g;
+    }
+
+} // namespace dist
@@ -0,0 +1,150 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "./net/Connection.hpp"
+#include "./net/Protocol.hpp"
+#include "../../Libraries/NeuralNetwork.hpp"
+
+namespace dist
+{
+
+    // One node's slice of a pipeline-parallel model (GPipe-style micro-batching).
+    //
+    // The first stage cuts each batch into micro-batches and streams them forward;
+    // every stage forwards a micro-batch as soon as it arrives, so stage k computes
+    // micro-batch m while stage k+1 computes m-1. The last stage turns each output
+    // into a loss gradient right away and gradients stream back the same way.
+    // Weights stay fixed for the whole batch: parameter gradients are summed across
+    // micro-batches (Layer::setDeferUpdates) and applied once every micro-batch has
+    // come back, so the result matches a single full-batch step.
+    //
+    // Layers keep state for one forward only, so a stage stores just each in-flight
+    // micro-batch's input and recomputes the forward before that micro-batch's
+    // backward (skipped when the layers still hold it).
+    //
+    // Each link to a neighbour has its own sender and receiver thread; compute only
+    // enqueues outbound frames and never blocks on a socket.
+    class PipelineStage
+    {
+    public:
+        PipelineStage(NeuralNetwork::Sequential &model, bool isFirst, bool isLast);
+        ~PipelineStage();
+
+        PipelineStage(const PipelineStage &) = delete;
+        PipelineStage &operator=(const PipelineStage &) = delete;
+
+        // Listen on listenPort for the previous stage (unless first), dial nextAddr
+        // "ip:port" (unless last, retrying until connectTimeout since the next node may
+        // still be starting), then accept the previous stage (also within connectTimeout).
+        bool connect(uint16_t listenPort, const std::string &nextAddr,
+                     std::chrono::milliseconds connectTimeout = std::chrono::seconds(30));
+
+        // First stage only: one SGD step on (X, Y), both [batch, cols], split into
+        // microBatches row slices. Loss is squared error summed over output columns,
+        // averaged over the batch.
+        bool trainBatch(const NeuralNetwork::Tensor &X, const NeuralNetwork::Tensor &Y,
+                        int microBatches, float lr, float &lossOut);
+
+        // Other stages: process batches until the first stage shuts the pipeline down
+        // (true) or a link fails (false). afterBatch runs once each batch's updates
+        // have been applied.
+        bool serve(const std::function<void()> &afterBatch = {});
+
+        // Batches applied on this stage and the time spent in the model's forward and
+        // backward (not waiting on links), for straggler detection.
+        struct Stats
+        {
+            uint64_t batches = 0;
+            double computeSeconds = 0.0;
+        };
+        Stats stats() const { return stats_; }
+
+        // First stage: tell the downstream stages to exit. All stages: close links.
+        void shutdown();
+
+    private:
+        // ACTIVATION / GRADIENT frames carry their tensors by reference (refcounted
+        // views) and go out with one gathered write; on receipt the values land
+        // directly in freshly allocated tensors. Other frames use payload.
+        struct Frame
+        {
+            Frame() = default;
+            explicit Frame(MsgType t) : type(t) {}
+
+            MsgType type{};
+            std::vector<uint8_t> payload;
+            TensorFrameHeader header{};
+            NeuralNetwork::Tensor values;
+            NeuralNetwork::Tensor targets; // ACTIVATION to the last stage only
+        };
+        static bool isTensorFrame(MsgType t) { return t == MsgType::ACTIVATION || t == MsgType::GRADIENT; }
+        static bool sendFrame(Connection &conn, const Frame &f);
+        bool recvFrame(Connection &conn, Frame &f);
+
+        class FrameQueue
+        {
+        public:
+            void push(Frame f);
+            bool pop(Frame &out); // blocks; false once closed and drained
+            bool tryPop(Frame &out);
+            void close();
+
+        private:
+            std::mutex mu_;
+            std::condition_variable cv_;
+            std::deque<Frame> q_;
+            bool closed_ = false;
+        };
+
+        struct Link
+        {
+            std::unique_ptr<Connection> conn;
+            FrameQueue outbox;
+            std::thread sender;
+            std::thread receiver;
+        };
+
+        void startLink(Link &link);
+        void stopLink(Link &link);
+
+        bool handleFrame(Frame &f);
+        void handleActivation(Frame &f);
+        void handleGradient(Frame &f);
+        void runBackward(int m, const NeuralNetwork::Tensor &grad, float loss);
+        void beginBatch(uint32_t numMicroBatches, uint32_t batchRows, float lr);
+        NeuralNetwork::Tensor lossGradient(const NeuralNetwork::Tensor &y, const NeuralNetwork::Tensor &target, float &loss) const;
+
+        NeuralNetwork::Sequential &model_;
+        ThreadPool *pool_;
+        const bool isFirst_;
+        const bool isLast_;
+
+        Link prev_; // receives ACTIVATION, sends GRADIENT
+        Link next_; // sends ACTIVATION, receives GRADIENT
+        FrameQueue inbox_; // frames from both links, in arrival order
+        socket_t listener_ = INVALID_SOCKET;
+        bool shutdownSent_ = false;
+
+        // Current batch.
+        std::vector<NeuralNetwork::Tensor> inputs_;
+        std::vector<NeuralNetwork::Tensor> targets_; // last stage only
+        uint32_t numMicroBatches_ = 0;
+        uint32_t batchRows_ = 0;
+        uint32_t gradientsDone_ = 0;
+        int liveMicroBatch_ = -1; // whose forward state the layers currently hold
+        float lr_ = 0.f;
+        float batchLoss_ = 0.f;
+
+        Stats stats_;
+    };
+
+} // namespace dist
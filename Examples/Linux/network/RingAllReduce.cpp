@@ -0,0 +1,487 @@
+#include "./RingAllReduce.hpp"
+#include "./net/Socket.hpp"
+#include "./net/Logger.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace dist
+{
+
+    // ---------- RingAllReduce ----------
+
+    RingAllReduce::RingAllReduce(int rank, int size)
+        : rank_(rank), size_(size)
+    {
+    }
+
+    RingAllReduce::~RingAllReduce()
+    {
+        close();
+    }
+
+    bool RingAllReduce::connect(uint16_t listenPort, const std::string &nextAddr, std::chrono::milliseconds timeout)
+    {
+        if (size_ <= 1)
+            return true;
+
+        // Listen first so the previous rank's dial lands in the backlog while we wait
+        // on the next rank.
+        listener_ = listenTcpIPv4(listenPort, 1);
+        if (listener_ == INVALID_SOCKET)
+            return false;
+
+        std::string host, peerIp;
+        uint16_t port = 0;
+        if (!splitHostPort(nextAddr, host, port))
+        {
+            LOG_ERROR("Bad next rank address '%s'", nextAddr.c_str());
+            return false;
+        }
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        socket_t s = INVALID_SOCKET;
+        while ((s = dialTcpIPv4(host, port, peerIp, false)) == INVALID_SOCKET)
+        {
+            if (std::chrono::steady_clock::now() > deadline)
+            {
+                LOG_ERROR("Next rank %s did not come up", nextAddr.c_str());
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        }
+        next_ = std::make_unique<Connection>(s, peerIp);
+
+        s = waitReadable(listener_, timeout) ? acceptTcp(listener_, peerIp) : INVALID_SOCKET;
+        closesocket(listener_);
+        listener_ = INVALID_SOCKET;
+        if (s == INVALID_SOCKET)
+        {
+            LOG_ERROR("Ring: accept from previous rank failed");
+            return false;
+        }
+        prev_ = std::make_unique<Connection>(s, peerIp);
+        LOG_INFO("Ring: rank %d/%d linked (next %s, previous %s)", rank_, size_, nextAddr.c_str(), peerIp.c_str());
+
+        scratch_.resize(kChunkFloats);
+        sender_ = std::thread(&RingAllReduce::senderLoop, this);
+        return true;
+    }
+
+    void RingAllReduce::close()
+    {
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            closing_ = true;
+        }
+        cv_.notify_all();
+        if (sender_.joinable())
+            sender_.join();
+        if (listener_ != INVALID_SOCKET)
+        {
+            closesocket(listener_);
+            listener_ = INVALID_SOCKET;
+        }
+        next_.reset();
+        prev_.reset();
+    }
+
+    bool RingAllReduce::agreeCodec(GradCodec &codec)
+    {
+        if (size_ <= 1)
+            return true;
+        if (!next_ || !prev_)
+            return false;
+        if (rank_ == 0)
+        {
+            const std::string mine = gradCodecToJson(codec).dump();
+            post(std::vector<uint8_t>(mine.begin(), mine.end()), MsgType::CONFIG);
+        }
+        MsgType type{};
+        std::vector<uint8_t> in;
+        if (!prev_->recvMessage(type, in) || type != MsgType::CONFIG)
+        {
+            LOG_ERROR("Ring: no codec CONFIG from the previous rank");
+            return false;
+        }
+        try
+        {
+            const GradCodec agreed = gradCodecFromJson(nlohmann::json::parse(in.begin(), in.end()));
+            if (rank_ == 0 && (agreed.codec != codec.codec || agreed.topkRatio != codec.topkRatio))
+            {
+                LOG_ERROR("Ring: codec CONFIG came back changed");
+                return false;
+            }
+            codec = agreed;
+        }
+        catch (const std::exception &e)
+        {
+            LOG_ERROR("Ring: bad codec CONFIG: %s", e.what());
+            return false;
+        }
+        if (rank_ != 0)
+            post(std::move(in), MsgType::CONFIG);
+        LOG_INFO("Ring: gradients travel as %s", codecName(codec.codec));
+        return waitSent();
+    }
+
+    bool RingAllReduce::allReduce(float *data, size_t count, bool average, Codec codec)
+    {
+        if (codec == Codec::TopK)
+            throw std::invalid_argument("TopK is not a dense codec; use allGather");
+        if (size_ <= 1 || count == 0)
+            return true;
+        if (!next_ || !prev_)
+            return false;
+
+        const int n = size_;
+        auto segBegin = [&](int k)
+        { return count * size_t(k) / size_t(n); };
+        auto forEachChunk = [&](int k, auto &&fn)
+        {
+            const size_t end = segBegin(k + 1);
+            for (size_t b = segBegin(k); b < end; b += kChunkFloats)
+                if (!fn(b, std::min(kChunkFloats, end - b)))
+                    return false;
+            return true;
+        };
+        auto encode = [&](const float *src, size_t len)
+        {
+            std::vector<uint8_t> out(encodedBytes(codec, len));
+            encodeValues(codec, src, len, out.data());
+            return out;
+        };
+        const bool raw = codec == Codec::None;
+
+        // Step 0 sends this rank's own segment; every later step forwards the segment
+        // received in the step before, chunk by chunk as it becomes ready.
+        forEachChunk(rank_, [&](size_t b, size_t len)
+                     {
+            if (raw)
+                post(data + b, len);
+            else
+                post(encode(data + b, len));
+            return true; });
+
+        const int steps = 2 * (n - 1);
+        const float inv = 1.f / float(n);
+        std::vector<uint8_t> in;
+        for (int s = 0; s < steps; ++s)
+        {
+            const int k = ((rank_ - s - 1) % n + n) % n; // segment arriving in step s
+            const bool reducing = s < n - 1;
+            const bool owned = s == n - 2; // this reduction completes segment k
+            const bool forward = s + 1 < steps;
+            const bool ok = forEachChunk(k, [&](size_t b, size_t len)
+                                         {
+                float *dst = data + b;
+                if (!raw)
+                {
+                    in.resize(encodedBytes(codec, len));
+                    if (!recvChunk(in.data(), in.size()))
+                        return false;
+                }
+                else if (!recvChunk(reducing ? scratch_.data() : dst, len * sizeof(float)))
+                    return false;
+
+                if (!reducing)
+                {
+                    // All-gather: take the finished values; pass the same bytes on.
+                    if (!raw)
+                    {
+                        decodeValues(codec, in.data(), len, dst);
+                        if (forward)
+                            post(std::move(in));
+                        in = {};
+                    }
+                    else if (forward)
+                        post(dst, len);
+                    return true;
+                }
+
+                if (!raw)
+                    decodeValues(codec, in.data(), len, scratch_.data());
+                const float *src = scratch_.data();
+                if (owned && average)
+                    for (size_t i = 0; i < len; ++i)
+                        dst[i] = (dst[i] + src[i]) * inv;
+                else
+                    for (size_t i = 0; i < len; ++i)
+                        dst[i] += src[i];
+                if (raw)
+                    post(dst, len);
+                else
+                {
+                    std::vector<uint8_t> out = encode(dst, len);
+                    if (owned)
+                        decodeValues(codec, out.data(), len, dst);
+                    post(std::move(out));
+                }
+                return true; });
+            if (!ok)
+                return false;
+        }
+        // The caller may touch data once we return, so the last forwards must be out.
+        return waitSent();
+    }
+
+    bool RingAllReduce::allGather(std::vector<uint8_t> mine, std::vector<std::vector<uint8_t>> &all)
+    {
+        all.assign(size_t(size_), {});
+        if (size_ <= 1)
+        {
+            all[0] = std::move(mine);
+            return true;
+        }
+        if (!next_ || !prev_)
+            return false;
+        post(mine);
+        all[size_t(rank_)] = std::move(mine);
+        for (int s = 0; s < size_ - 1; ++s)
+        {
+            const int k = ((rank_ - s - 1) % size_ + size_) % size_;
+            if (!recvChunk(all[size_t(k)]))
+                return false;
+            if (s + 2 < size_)
+                post(all[size_t(k)]);
+        }
+        return waitSent();
+    }
+
+    void RingAllReduce::post(const float *data, size_t count)
+    {
+        Chunk c;
+        c.data = data;
+        c.count = count;
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            queue_.push_back(std::move(c));
+            ++unsent_;
+        }
+        cv_.notify_all();
+    }
+
+    void RingAllReduce::post(std::vector<uint8_t> bytes, MsgType type)
+    {
+        Chunk c;
+        c.type = type;
+        c.bytes = std::move(bytes);
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            queue_.push_back(std::move(c));
+            ++unsent_;
+        }
+        cv_.notify_all();
+    }
+
+    bool RingAllReduce::waitSent()
+    {
+        std::unique_lock<std::mutex> lk(mu_);
+        cv_.wait(lk, [this]
+                 { return unsent_ == 0 || failed_; });
+        return !failed_;
+    }
+
+    bool RingAllReduce::recvChunk(void *dst, size_t bytes)
+    {
+        MsgType type{};
+        uint32_t len = 0;
+        if (!prev_->recvFrameHeader(type, len))
+        {
+            LOG_ERROR("Ring: previous rank went away");
+            return false;
+        }
+        uint32_t seqN = 0;
+        if (type != MsgType::REDUCE || len != sizeof(seqN) + bytes)
+        {
+            LOG_ERROR("Ring: unexpected frame (type %u, %u bytes)", unsigned(type), len);
+            return false;
+        }
+        if (!prev_->recvPayload(&seqN, sizeof(seqN)) || !prev_->recvPayload(dst, bytes))
+            return false;
+        if (netToHost32(seqN) != recvSeq_++)
+        {
+            LOG_ERROR("Ring: chunks out of step with the previous rank");
+            return false;
+        }
+        return true;
+    }
+
+    bool RingAllReduce::recvChunk(std::vector<uint8_t> &out)
+    {
+        MsgType type{};
+        uint32_t len = 0;
+        if (!prev_->recvFrameHeader(type, len))
+        {
+            LOG_ERROR("Ring: previous rank went away");
+            return false;
+        }
+        uint32_t seqN = 0;
+        if (type != MsgType::REDUCE || len < sizeof(seqN))
+        {
+            LOG_ERROR("Ring: unexpected frame (type %u, %u bytes)", unsigned(type), len);
+            return false;
+        }
+        out.resize(len - sizeof(seqN));
+        if (!prev_->recvPayload(&seqN, sizeof(seqN)) || !prev_->recvPayload(out.data(), out.size()))
+            return false;
+        if (netToHost32(seqN) != recvSeq_++)
+        {
+            LOG_ERROR("Ring: chunks out of step with the previous rank");
+            return false;
+        }
+        return true;
+    }
+
+    void RingAllReduce::senderLoop()
+    {
+        uint32_t seq = 0;
+        for (;;)
+        {
+            Chunk c;
+            {
+                std::unique_lock<std::mutex> lk(mu_);
+                cv_.wait(lk, [this]
+                         { return closing_ || !queue_.empty(); });
+                if (queue_.empty())
+                    return;
+                c = std::move(queue_.front());
+                queue_.pop_front();
+            }
+            bool ok;
+            if (c.type != MsgType::REDUCE)
+                ok = next_->sendMessage(c.type, c.bytes);
+            else
+            {
+                const uint32_t seqN = hostToNet32(seq++);
+                const IoSlice parts[2] = {{&seqN, sizeof(seqN)},
+                                          c.data ? IoSlice{c.data, c.count * sizeof(float)}
+                                                 : IoSlice{c.bytes.data(), c.bytes.size()}};
+                ok = next_->sendParts(MsgType::REDUCE, parts, 2);
+            }
+            {
+                std::lock_guard<std::mutex> lk(mu_);
+                --unsent_;
+                if (!ok)
+                    failed_ = true;
+            }
+            cv_.notify_all();
+            if (!ok)
+            {
+                LOG_ERROR("Ring: next rank went away");
+                ::shutdown(prev_->raw(), SHUT_RDWR); // unblock a receive waiting on the ring
+                return;
+            }
+        }
+    }
+
+    // ---------- GradientAllReducer ----------
+
+    GradientAllReducer::GradientAllReducer(NeuralNetwork::Sequential &model, RingAllReduce &ring, bool average,
+                                           GradCodec codec)
+        : model_(model), ring_(ring), average_(average), codec_(codec)
+    {
+        model_.setDeferUpdates(true);
+        model_.afterLayerBackward = [this](int index)
+        { onLayer(index); };
+        worker_ = std::thread(&GradientAllReducer::workerLoop, this);
+    }
+
+    GradientAllReducer::~GradientAllReducer()
+    {
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        worker_.join();
+        model_.afterLayerBackward = nullptr;
+        model_.setDeferUpdates(false);
+    }
+
+    bool GradientAllReducer::finish()
+    {
+        std::unique_lock<std::mutex> lk(mu_);
+        cv_.wait(lk, [this]
+                 { return pending_ == 0; });
+        return !failed_;
+    }
+
+    void GradientAllReducer::onLayer(int index)
+    {
+        std::vector<NeuralNetwork::Tensor *> grads;
+        model_.layers[size_t(index)]->gradients(grads);
+        if (grads.empty())
+            return;
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            jobs_.insert(jobs_.end(), grads.begin(), grads.end());
+            pending_ += grads.size();
+        }
+        cv_.notify_all();
+    }
+
+    void GradientAllReducer::workerLoop()
+    {
+        for (;;)
+        {
+            NeuralNetwork::Tensor *t;
+            bool failed;
+            {
+                std::unique_lock<std::mutex> lk(mu_);
+                cv_.wait(lk, [this]
+                         { return stop_ || !jobs_.empty(); });
+                if (jobs_.empty())
+                    return;
+                t = jobs_.front();
+                jobs_.pop_front();
+                failed = failed_;
+            }
+            // Once the ring has failed the rest can't complete; drain without sending.
+            const bool ok = !failed && (codec_.codec == Codec::TopK ? reduceTopK(*t)
+                                                                    : ring_.allReduce(t->data, t->length(), average_, codec_.codec));
+            {
+                std::lock_guard<std::mutex> lk(mu_);
+                --pending_;
+                if (!ok)
+                    failed_ = true;
+            }
+            cv_.notify_all();
+        }
+    }
+
+    bool GradientAllReducer::reduceTopK(NeuralNetwork::Tensor &t)
+    {
+        const size_t count = size_t(t.length());
+        std::vector<float> &residual = residuals_[&t];
+        residual.resize(count, 0.f);
+        for (size_t i = 0; i < count; ++i)
+            residual[i] += t.data[i];
+
+        std::vector<uint8_t> mine;
+        const size_t k = std::max<size_t>(1, size_t(double(codec_.topkRatio) * double(count)));
+        encodeTopK(residual.data(), count, k, mine);
+        std::vector<std::vector<uint8_t>> all;
+        if (!ring_.allGather(std::move(mine), all))
+            return false;
+
+        std::fill(t.data, t.data + count, 0.f);
+        try
+        {
+            for (const auto &blob : all)
+                addTopK(blob.data(), blob.size(), t.data, count);
+        }
+        catch (const std::exception &e)
+        {
+            LOG_ERROR("Ring: bad TopK gradient: %s", e.what());
+            return false;
+        }
+        if (average_)
+        {
+            const float inv = 1.f / float(ring_.size());
+            for (size_t i = 0; i < count; ++i)
+                t.data[i] *= inv;
+        }
+        return true;
+    }
+
+} // namespace dist
@@ -0,0 +1,143 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "./GradientCodec.hpp"
+#include "./net/Connection.hpp"
+#include "./net/Protocol.hpp"
+#include "../../Libraries/NeuralNetwork.hpp"
+
+namespace dist
+{
+
+    // Sums (or averages) a float buffer across the ranks of a ring. Each rank only
+    // talks to its two neighbours and moves 2(n-1)/n of the buffer, whatever n is.
+    //
+    // Reduce-scatter: the buffer is cut into n segments; in each of n-1 steps a rank
+    // sends one segment to the next rank and adds the segment arriving from the
+    // previous one, after which rank r holds the total of segment r+1. All-gather:
+    // n-1 more steps pass the finished segments around the ring.
+    //
+    // Segments travel as REDUCE frames of at most kChunkFloats, and a chunk is handed
+    // to the sender thread as soon as it has been reduced, so step s+1 is already on
+    // the wire while step s is still arriving and the link never idles between steps.
+    class RingAllReduce
+    {
+    public:
+        static constexpr size_t kChunkFloats = 64 * 1024; // 256 KiB per frame
+
+        RingAllReduce(int rank, int size);
+        ~RingAllReduce();
+
+        RingAllReduce(const RingAllReduce &) = delete;
+        RingAllReduce &operator=(const RingAllReduce &) = delete;
+
+        // Listen on listenPort for the previous rank, dial nextAddr "ip:port" of rank+1
+        // (retrying until timeout, it may still be starting), then accept the previous
+        // rank. Nothing to do for a ring of one.
+        bool connect(uint16_t listenPort, const std::string &nextAddr,
+                     std::chrono::milliseconds timeout = std::chrono::seconds(30));
+
+        // Makes every rank use the codec rank 0 passes: rank 0's choice goes around the
+        // ring as a CONFIG message and the others adopt it. Call once after connect.
+        bool agreeCodec(GradCodec &codec);
+
+        // In place. Every rank must make the same calls with the same counts in the
+        // same order. False if a neighbour went away. With a dense codec chunks travel
+        // encoded, and each finished segment is rounded through the codec on its owner
+        // too, so every rank ends with the same values.
+        bool allReduce(float *data, size_t count, bool average = true, Codec codec = Codec::None);
+
+        // Every rank's blob, indexed by rank (sizes may differ).
+        bool allGather(std::vector<uint8_t> mine, std::vector<std::vector<uint8_t>> &all);
+
+        void close();
+
+        int rank() const { return rank_; }
+        int size() const { return size_; }
+
+    private:
+        // Raw floats are sent from the caller's buffer; anything else from bytes.
+        struct Chunk
+        {
+            MsgType type = MsgType::REDUCE;
+            const float *data = nullptr;
+            size_t count = 0;
+            std::vector<uint8_t> bytes;
+        };
+
+        void post(const float *data, size_t count);
+        void post(std::vector<uint8_t> bytes, MsgType type = MsgType::REDUCE);
+        bool waitSent();
+        bool recvChunk(void *dst, size_t bytes);
+        bool recvChunk(std::vector<uint8_t> &out);
+        void senderLoop();
+
+        int rank_;
+        int size_;
+        socket_t listener_{INVALID_SOCKET};
+        std::unique_ptr<Connection> next_;
+        std::unique_ptr<Connection> prev_;
+        std::vector<float> scratch_;
+        uint32_t recvSeq_ = 0;
+
+        std::thread sender_;
+        std::mutex mu_;
+        std::condition_variable cv_;
+        std::deque<Chunk> queue_;
+        size_t unsent_ = 0; // queued or being written
+        bool closing_ = false;
+        bool failed_ = false;
+    };
+
+    // Data-parallel training over a ring: every replica runs the same model on its
+    // own rows, and each layer's gradients are all-reduced the moment backward is
+    // done with that layer, on a background thread, so the exchange for layer i runs
+    // while layers i-1..0 are still computing. Per step: forward, backward, finish(),
+    // then model.applyUpdates(lr).
+    class GradientAllReducer
+    {
+    public:
+        // average=false sums the replicas' gradients (right when each replica scales
+        // its loss by the global batch size); true takes their mean. TopK keeps a
+        // residual per gradient tensor and all-gathers the selected entries.
+        GradientAllReducer(NeuralNetwork::Sequential &model, RingAllReduce &ring, bool average = true,
+                           GradCodec codec = {});
+        ~GradientAllReducer();
+
+        GradientAllReducer(const GradientAllReducer &) = delete;
+        GradientAllReducer &operator=(const GradientAllReducer &) = delete;
+
+        // Waits until every gradient queued by the last backward is reduced; false if
+        // the ring failed.
+        bool finish();
+
+    private:
+        void onLayer(int index);
+        void workerLoop();
+        bool reduceTopK(NeuralNetwork::Tensor &t);
+
+        NeuralNetwork::Sequential &model_;
+        RingAllReduce &ring_;
+        bool average_;
+        GradCodec codec_;
+        std::unordered_map<const NeuralNetwork::Tensor *, std::vector<float>> residuals_; // TopK error feedback
+
+        std::thread worker_;
+        std::mutex mu_;
+        std::condition_variable cv_;
+        std::deque<NeuralNetwork::Tensor *> jobs_;
+        size_t pending_ = 0;
+        bool stop_ = false;
+        bool failed_ = false;
+    };
+
+} // namespace dist
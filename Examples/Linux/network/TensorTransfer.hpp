@@ -0,0 +1,131 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include "./net/Connection.hpp"
+#include "../../Libraries/NeuralNetwork.hpp"
+
+namespace dist
+{
+
+    // One layer's parameters as a WEIGHTS message carries them.
+    struct LayerTensors
+    {
+        LayerWeightsHeader header{};
+        NeuralNetwork::Tensor weights; // [rows, cols]
+        NeuralNetwork::Tensor bias;    // [cols]
+    };
+
+    // Sends a layer as one WEIGHTS message, gathered straight from the tensors' buffers
+    // (only a strided view is packed first). On a connection with a writer this returns
+    // once the message is written, so training may update the tensors again.
+    inline bool sendLayerWeights(Connection &conn, uint32_t generation, uint32_t layer, uint32_t step,
+                                 const NeuralNetwork::Tensor &weights, const NeuralNetwork::Tensor &bias)
+    {
+        if (weights.dims != 2 || bias.dims != 1 || bias.shape[0] != weights.shape[1])
+            return false;
+        const NeuralNetwork::Tensor w = weights.contiguous(), b = bias.contiguous();
+        const LayerWeightsHeader h{generation, layer, step, uint32_t(w.shape[0]), uint32_t(w.shape[1])};
+        uint8_t head[kLayerWeightsHeadBytes], biasHead[kLayerBiasHeadBytes];
+        encodeLayerWeightsHeads(h, head, biasHead);
+        const IoSlice parts[4] = {{head, sizeof(head)},
+                                  {w.data, sizeof(float) * size_t(w.length())},
+                                  {biasHead, sizeof(biasHead)},
+                                  {b.data, sizeof(float) * size_t(b.length())}};
+        return conn.sendParts(MsgType::WEIGHTS, parts, 4);
+    }
+
+    // Reads WEIGHTS messages straight into new tensors, through
+    // Connection::recvMessage(type, payload, MsgType::WEIGHTS, &receiver): the heads go
+    // to small buffers, the elements to the weights and bias as they arrive, whole or
+    // in chunks. After each WEIGHTS, take() hands over the layer, or throws if the
+    // message was malformed (its bytes are then dropped).
+    class LayerReceiver : public PayloadSink
+    {
+    public:
+        void begin() override
+        {
+            layer_ = LayerTensors{};
+            started_ = biasChecked_ = false;
+            error_.clear();
+        }
+
+        uint8_t *place(size_t offset, size_t &len) override
+        {
+            if (offset < kLayerWeightsHeadBytes)
+                return region(head_, offset, len, kLayerWeightsHeadBytes);
+            if (!error_.empty())
+                return nullptr;
+            try
+            {
+                if (!started_)
+                    start();
+                const size_t biasAt = kLayerWeightsHeadBytes + weightsBytes();
+                const size_t biasDataAt = biasAt + kLayerBiasHeadBytes;
+                if (offset < biasAt)
+                    return region(reinterpret_cast<uint8_t *>(layer_.weights.data), offset - kLayerWeightsHeadBytes, len,
+                                  weightsBytes());
+                if (offset < biasDataAt)
+                    return region(biasHead_, offset - biasAt, len, kLayerBiasHeadBytes);
+                if (!biasChecked_)
+                {
+                    checkLayerBiasHead(biasHead_, layer_.header);
+                    biasChecked_ = true;
+                }
+                if (offset < biasDataAt + biasBytes())
+                    return region(reinterpret_cast<uint8_t *>(layer_.bias.data), offset - biasDataAt, len, biasBytes());
+                throw std::runtime_error("Bad LayerWeights size");
+            }
+            catch (const std::exception &e)
+            {
+                error_ = e.what();
+                return nullptr;
+            }
+        }
+
+        void end(size_t total) override
+        {
+            if (error_.empty() && (!started_ || total != layerWeightsBytes(layer_.header)))
+                error_ = "Bad LayerWeights size";
+        }
+
+        LayerTensors take()
+        {
+            if (!error_.empty())
+                throw std::runtime_error(error_);
+            return std::move(layer_);
+        }
+
+    private:
+        static uint8_t *region(uint8_t *base, size_t at, size_t &len, size_t size)
+        {
+            len = std::min(len, size - at);
+            return base + at;
+        }
+
+        size_t weightsBytes() const { return sizeof(float) * size_t(layer_.header.rows) * layer_.header.cols; }
+        size_t biasBytes() const { return sizeof(float) * size_t(layer_.header.cols); }
+
+        // The head is in: check it and allocate the tensors the elements go to.
+        void start()
+        {
+            started_ = true;
+            layer_.header = decodeLayerWeightsHead(head_);
+            const LayerWeightsHeader &h = layer_.header;
+            if (h.rows == 0 || h.cols == 0 || layerWeightsBytes(h) > UINT32_MAX)
+                throw std::runtime_error("Bad LayerWeights shape");
+            const int shape[2] = {int(h.rows), int(h.cols)};
+            layer_.weights = NeuralNetwork::Tensor::uninitialized(2, nullptr, shape);
+            layer_.bias = NeuralNetwork::Tensor::uninitialized(1, nullptr, shape + 1);
+        }
+
+        uint8_t head_[kLayerWeightsHeadBytes];
+        uint8_t biasHead_[kLayerBiasHeadBytes];
+        LayerTensors layer_;
+        bool started_ = false, biasChecked_ = false;
+        std::string error_;
+    };
+
+} // namespace dist
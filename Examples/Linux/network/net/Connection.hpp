@@ -1,10 +1,15 @@
 #pragma once
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <atomic>
 #include <chrono>
 #include <functional>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <thread>
+#include "./OutboundQueue.hpp"
 #include "./Protocol.hpp"
 #include "./Logger.hpp"
 
@@ -17,8 +22,10 @@ using socket_t = SOCKET;
 #define close closesocket
 #endif
 #else
+#include <cerrno>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/tcp.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -36,17 +43,82 @@ namespace dist
         std::string ip;
         uint64_t ramBytes = 0;
         uint32_t threads = 0;
+        // From RESOURCE_REPORT_EX; 0 when the node sent a plain RESOURCE_REPORT.
+        float gemmGflops = 0.f;
+        float memBandwidthGBs = 0.f;
+        float loopbackLatencyUs = 0.f;
+        uint16_t pipelinePort = 0; // 0 = kDefaultPipelinePort
         std::chrono::steady_clock::time_point lastSeen{};
         bool alive = true;
     };
 
+    // One gathered write (sendmsg / WSASend) of up to OutboundQueue::kMaxSlices slices,
+    // retried if a signal interrupts it. Returns the bytes written, 0 if a non-blocking
+    // socket is full, -1 on error.
+    inline long sendSlices(socket_t s, const IoSlice *parts, size_t count)
+    {
+#if defined(_WIN32)
+        WSABUF bufs[OutboundQueue::kMaxSlices];
+        for (size_t i = 0; i < count; ++i)
+        {
+            bufs[i].buf = const_cast<char *>(static_cast<const char *>(parts[i].data));
+            bufs[i].len = ULONG(parts[i].len);
+        }
+        DWORD sent = 0;
+        if (WSASend(s, bufs, DWORD(count), &sent, 0, nullptr, nullptr) != 0)
+            return WSAGetLastError() == WSAEWOULDBLOCK ? 0 : -1;
+        return long(sent);
+#else
+        iovec iov[OutboundQueue::kMaxSlices];
+        for (size_t i = 0; i < count; ++i)
+        {
+            iov[i].iov_base = const_cast<void *>(parts[i].data);
+            iov[i].iov_len = parts[i].len;
+        }
+        msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        ssize_t r;
+        do
+        {
+#if defined(MSG_NOSIGNAL)
+            r = ::sendmsg(s, &msg, MSG_NOSIGNAL);
+#else
+            r = ::sendmsg(s, &msg, 0);
+#endif
+        } while (r < 0 && errno == EINTR); // a signal is not a failed link
+        if (r < 0)
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        return long(r);
+#endif
+    }
+
+    // Where a bulk message's payload lands as it is read, for receivers that keep large
+    // messages in their own buffers (e.g. straight in tensors) rather than a vector; see
+    // Connection::recvMessage. The bytes arrive in order. place(offset, len) returns
+    // where the payload bytes from offset go and may lower len to what fits there;
+    // nullptr (or len 0) drops them. end() gets the payload's total size.
+    class PayloadSink
+    {
+    public:
+        virtual ~PayloadSink() = default;
+        virtual void begin() = 0;
+        virtual uint8_t *place(size_t offset, size_t &len) = 0;
+        virtual void end(size_t total) = 0;
+    };
+
     class Connection
     {
     public:
+        static constexpr size_t kMaxSlices = 15; // payload slices per sendParts call
         Connection(socket_t s, std::string peerIp)
             : sock_(s), peerIp_(std::move(peerIp)), lastSeen_(std::chrono::steady_clock::now()) {}
 
-        ~Connection() { close(); }
+        ~Connection()
+        {
+            stopWriter();
+            close();
+        }
 
         const std::string &peerIp() const { return peerIp_; }
 
@@ -55,22 +127,157 @@ namespace dist
 
         bool sendMessage(MsgType type, const std::vector<uint8_t> &payload)
         {
-            uint32_t len = static_cast<uint32_t>(1 + payload.size());
-            uint32_t lenN = hostToNet32(len);
+            const IoSlice slice{payload.data(), payload.size()};
+            return sendParts(type, &slice, payload.empty() ? 0 : 1);
+        }
+
+        // Sends one frame whose payload is the concatenation of parts, gathered by the
+        // kernel (writev-style) straight from the callers' buffers. Once the writer runs,
+        // a bulk message is queued without copying the parts (as CHUNK frames) and this
+        // waits until the writer has sent them, so the caller may change the buffers again
+        // when it returns; control messages are copied and posted.
+        bool sendParts(MsgType type, const IoSlice *parts, size_t count)
+        {
+            if (count > kMaxSlices)
+                return false;
+            uint64_t total = 1;
+            for (size_t i = 0; i < count; ++i)
+                total += parts[i].len;
+            if (total > UINT32_MAX)
+                return false;
+            if (writer_)
+                return laneOf(type) == Lane::Bulk ? postBorrowed(type, parts, count) : post(type, gather(parts, count));
+
+            uint8_t head[5];
+            const uint32_t lenN = hostToNet32(static_cast<uint32_t>(total));
+            std::memcpy(head, &lenN, 4);
+            head[4] = static_cast<uint8_t>(type);
+
+            IoSlice all[kMaxSlices + 1];
+            size_t n = 0;
+            all[n++] = IoSlice{head, sizeof(head)};
+            for (size_t i = 0; i < count; ++i)
+                if (parts[i].len)
+                    all[n++] = parts[i];
+            return sendAllParts(all, n);
+        }
+
+        // Queued sending for connections written from several threads. After
+        // startWriter one thread owns the socket's writes: post() queues a frame by
+        // lane and returns, and the writer coalesces whatever is queued into gathered
+        // writes. sendMessage/sendParts then go through the queue too.
+        void startWriter()
+        {
+            if (writer_)
+                return;
+            writer_ = std::make_unique<Writer>();
+            writer_->thread = std::thread([this]
+                                          { writerLoop(); });
+        }
+
+        // False once the writer has failed (peer gone) or was never started.
+        bool post(MsgType type, std::vector<uint8_t> payload)
+        {
+            if (!writer_)
+                return false;
+            {
+                std::lock_guard<std::mutex> lk(writer_->mu);
+                if (writer_->failed || writer_->stopping)
+                    return false;
+                writer_->queue.push(type, std::move(payload));
+            }
+            writer_->cv.notify_one();
+            return true;
+        }
 
-            std::vector<uint8_t> frame(4 + len);
-            std::memcpy(frame.data(), &lenN, 4);
-            frame[4] = static_cast<uint8_t>(type);
-            if (!payload.empty())
-                std::memcpy(frame.data() + 5, payload.data(), payload.size());
-            return sendAll(frame.data(), frame.size());
+        // Writes out what is queued (if the peer still reads) and joins the writer.
+        void stopWriter()
+        {
+            if (!writer_)
+                return;
+            {
+                std::lock_guard<std::mutex> lk(writer_->mu);
+                writer_->stopping = true;
+            }
+            writer_->cv.notify_one();
+            writer_->thread.join();
+            writer_.reset();
         }
 
         // Returns false on peer disconnect or fatal error; fills out parameters on success.
+        // Bulk messages that arrive as CHUNK frames are reassembled and returned whole.
         bool recvMessage(MsgType &typeOut, std::vector<uint8_t> &payloadOut)
         {
-            payloadOut.clear();
+            return recvMessage(typeOut, payloadOut, MsgType::CHUNK, nullptr);
+        }
 
+        // As above, except that the payload of a `placed` message, whole or in CHUNK
+        // frames, is read straight into sink as it arrives; it is returned with an empty
+        // payloadOut once complete. Control messages that overtake its chunks are
+        // returned in between, so keep one sink per connection.
+        bool recvMessage(MsgType &typeOut, std::vector<uint8_t> &payloadOut, MsgType placed, PayloadSink *sink)
+        {
+            for (;;)
+            {
+                uint32_t len = 0;
+                if (!recvFrameHeader(typeOut, len))
+                    return false;
+                if (sink && typeOut == placed)
+                {
+                    sink->begin();
+                    if (!recvPlaced(*sink, 0, len))
+                        return false;
+                    sink->end(len);
+                    payloadOut.clear();
+                    return true;
+                }
+                if (typeOut != MsgType::CHUNK)
+                {
+                    payloadOut.resize(len);
+                    return recvPayload(payloadOut.data(), len);
+                }
+
+                uint8_t prefix[kChunkPrefixBytes];
+                if (len < sizeof(prefix))
+                    throw std::runtime_error("CHUNK payload too short");
+                if (!recvAll(prefix, sizeof(prefix)))
+                    return false;
+                const MsgType inner = static_cast<MsgType>(prefix[0]);
+                const bool last = prefix[1] != 0;
+                const size_t body = len - sizeof(prefix);
+                if (sink && inner == placed)
+                {
+                    if (placedBytes_ == 0)
+                        sink->begin();
+                    if (!recvPlaced(*sink, placedBytes_, body))
+                        return false;
+                    placedBytes_ += body;
+                    if (!last)
+                        continue;
+                    sink->end(placedBytes_);
+                    placedBytes_ = 0;
+                    typeOut = placed;
+                    payloadOut.clear();
+                    return true;
+                }
+                const size_t at = partial_.size();
+                partial_.resize(at + body);
+                if (!recvPayload(partial_.data() + at, body))
+                    return false;
+                if (last)
+                {
+                    typeOut = inner;
+                    payloadOut.swap(partial_);
+                    partial_.clear();
+                    return true;
+                }
+            }
+        }
+
+        // Two-step receive for callers that place the payload themselves (e.g. straight
+        // into a tensor): read the frame header, then exactly payloadLen bytes with recvPayload.
+        bool recvFrameHeader(MsgType &typeOut, uint32_t &payloadLen)
+        {
             uint32_t lenN;
             if (!recvAll(&lenN, 4))
                 return false;
@@ -80,20 +287,17 @@ namespace dist
                 LOG_WARN("Received zero-length frame from %s", peerIp_.c_str());
                 return false;
             }
-            std::vector<uint8_t> buf(len);
-            if (!recvAll(buf.data(), len))
+            uint8_t type;
+            if (!recvAll(&type, 1))
                 return false;
-
-            typeOut = static_cast<MsgType>(buf[0]);
-            if (len > 1)
-                payloadOut.assign(buf.begin() + 1, buf.end());
-            else
-                payloadOut.clear();
-
+            typeOut = static_cast<MsgType>(type);
+            payloadLen = len - 1;
             updateLastSeen();
             return true;
         }
 
+        bool recvPayload(void *out, size_t len) { return len == 0 || recvAll(out, len); }
+
         void close()
         {
             if (sock_ != INVALID_SOCKET)
@@ -107,26 +311,114 @@ namespace dist
         socket_t raw() const { return sock_; }
 
     private:
-        bool sendAll(const void *data, size_t len)
+        static std::vector<uint8_t> gather(const IoSlice *parts, size_t count)
+        {
+            std::vector<uint8_t> out;
+            for (size_t i = 0; i < count; ++i)
+                out.insert(out.end(), static_cast<const uint8_t *>(parts[i].data),
+                           static_cast<const uint8_t *>(parts[i].data) + parts[i].len);
+            return out;
+        }
+
+        // The queued pieces share token; it expires once the writer has sent the last.
+        bool postBorrowed(MsgType type, const IoSlice *parts, size_t count)
+        {
+            auto token = std::make_shared<int>(0);
+            const std::weak_ptr<int> sent = token;
+            std::unique_lock<std::mutex> lk(writer_->mu);
+            if (writer_->failed || writer_->stopping)
+                return false;
+            writer_->queue.push(type, parts, count, std::move(token));
+            writer_->cv.notify_one();
+            writer_->written.wait(lk, [&]
+                                  { return sent.expired() || writer_->failed; });
+            return sent.expired();
+        }
+
+        // Reads len payload bytes at offset into sink; bytes it does not place are dropped.
+        bool recvPlaced(PayloadSink &sink, size_t offset, size_t len)
         {
-            const uint8_t *p = static_cast<const uint8_t *>(data);
-            size_t sent = 0;
-            while (sent < len)
+            uint8_t scratch[4096];
+            while (len > 0)
             {
-#if defined(_WIN32)
-                int n = ::send(sock_, reinterpret_cast<const char *>(p + sent), int(len - sent), 0);
-#else
-                ssize_t n = ::send(sock_, p + sent, len - sent, MSG_NOSIGNAL);
-#endif
-                if (n <= 0)
+                size_t n = len;
+                uint8_t *dst = sink.place(offset, n);
+                if (!dst || n == 0 || n > len)
                 {
+                    dst = scratch;
+                    n = std::min(len, sizeof(scratch));
+                }
+                if (!recvAll(dst, n))
+                    return false;
+                offset += n;
+                len -= n;
+            }
+            return true;
+        }
+
+        // Gathered send that resumes after partial writes.
+        bool sendAllParts(IoSlice *parts, size_t count)
+        {
+            size_t first = 0;
+            while (first < count)
+            {
+                const long r = sendSlices(sock_, parts + first, count - first);
+                if (r <= 0)
                     return false;
+                size_t n = size_t(r);
+                while (first < count && n >= parts[first].len)
+                    n -= parts[first++].len;
+                if (first < count)
+                {
+                    parts[first].data = static_cast<const uint8_t *>(parts[first].data) + n;
+                    parts[first].len -= n;
                 }
-                sent += size_t(n);
             }
             return true;
         }
 
+        struct Writer
+        {
+            std::mutex mu;
+            std::condition_variable cv;
+            std::condition_variable written; // postBorrowed waits for its pieces here
+            OutboundQueue queue;
+            bool stopping = false;
+            bool failed = false;
+            std::thread thread;
+        };
+
+        void writerLoop()
+        {
+            Writer &w = *writer_;
+            IoSlice slices[OutboundQueue::kMaxSlices];
+            for (;;)
+            {
+                size_t count;
+                {
+                    std::unique_lock<std::mutex> lk(w.mu);
+                    w.cv.wait(lk, [&]
+                              { return w.stopping || !w.queue.empty(); });
+                    if (w.queue.empty())
+                        return;
+                    count = w.queue.gather(slices, OutboundQueue::kMaxSlices);
+                }
+                size_t total = 0;
+                for (size_t i = 0; i < count; ++i)
+                    total += slices[i].len;
+                const bool ok = sendAllParts(slices, count);
+                std::lock_guard<std::mutex> lk(w.mu);
+                if (!ok)
+                {
+                    w.failed = true;
+                    w.written.notify_all();
+                    return;
+                }
+                w.queue.consume(total);
+                w.written.notify_all();
+            }
+        }
+
         bool recvAll(void *out, size_t len)
         {
             uint8_t *p = static_cast<uint8_t *>(out);
@@ -141,7 +433,13 @@ namespace dist
                 if (n == 0)
                     return false; // peer closed
                 if (n < 0)
+                {
+#if !defined(_WIN32)
+                    if (errno == EINTR)
+                        continue;
+#endif
                     return false;
+                }
                 recvd += size_t(n);
             }
             return true;
@@ -149,6 +447,9 @@ namespace dist
 
         socket_t sock_{INVALID_SOCKET};
         std::string peerIp_;
+        std::unique_ptr<Writer> writer_;
+        std::vector<uint8_t> partial_; // CHUNK frames received so far
+        size_t placedBytes_ = 0;       // of the chunked message going into a PayloadSink
         std::chrono::steady_clock::time_point lastSeen_;
     };
 
@@ -0,0 +1,234 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "./Connection.hpp"
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#elif !defined(_WIN32)
+#include <poll.h>
+#endif
+#if !defined(_WIN32)
+#include <fcntl.h>
+#endif
+
+namespace dist
+{
+
+    inline bool setNonBlocking(socket_t s)
+    {
+#if defined(_WIN32)
+        u_long on = 1;
+        return ::ioctlsocket(s, FIONBIO, &on) == 0;
+#else
+        const int flags = ::fcntl(s, F_GETFL, 0);
+        return flags >= 0 && ::fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+    }
+
+    // true when a non-blocking send/recv/accept failed only because it would block
+    inline bool wouldBlock()
+    {
+#if defined(_WIN32)
+        return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+    }
+
+    // Level-triggered readiness over many sockets: epoll on Linux, poll() elsewhere.
+    // Every socket is watched for reads; write interest is switched on while a socket
+    // has output queued. add/remove/setWriteInterest/wakeup may be called from any
+    // thread; wait is called by the single thread that owns the loop.
+    class EventLoop
+    {
+    public:
+        struct Event
+        {
+            socket_t fd;
+            bool readable;
+            bool writable;
+            bool hangup; // error or peer closed; reading drains what is left
+        };
+
+        EventLoop()
+        {
+#if defined(__linux__)
+            ep_ = ::epoll_create1(EPOLL_CLOEXEC);
+            wake_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.fd = wake_;
+            ::epoll_ctl(ep_, EPOLL_CTL_ADD, wake_, &ev);
+#elif !defined(_WIN32)
+            int p[2] = {-1, -1};
+            if (::pipe(p) == 0)
+            {
+                setNonBlocking(p[0]);
+                setNonBlocking(p[1]);
+            }
+            wakeRead_ = p[0];
+            wakeWrite_ = p[1];
+#endif
+        }
+
+        ~EventLoop()
+        {
+#if defined(__linux__)
+            ::close(wake_);
+            ::close(ep_);
+#elif !defined(_WIN32)
+            ::close(wakeRead_);
+            ::close(wakeWrite_);
+#endif
+        }
+
+        EventLoop(const EventLoop &) = delete;
+        EventLoop &operator=(const EventLoop &) = delete;
+
+        bool valid() const
+        {
+#if defined(__linux__)
+            return ep_ >= 0 && wake_ >= 0;
+#elif !defined(_WIN32)
+            return wakeRead_ >= 0;
+#else
+            return true;
+#endif
+        }
+
+        bool add(socket_t fd)
+        {
+#if defined(__linux__)
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLRDHUP;
+            ev.data.fd = fd;
+            return ::epoll_ctl(ep_, EPOLL_CTL_ADD, fd, &ev) == 0;
+#else
+            std::lock_guard<std::mutex> lk(mu_);
+            interest_[fd] = POLLIN;
+            wakeup();
+            return true;
+#endif
+        }
+
+        void remove(socket_t fd)
+        {
+#if defined(__linux__)
+            ::epoll_ctl(ep_, EPOLL_CTL_DEL, fd, nullptr);
+#else
+            std::lock_guard<std::mutex> lk(mu_);
+            interest_.erase(fd);
+#endif
+        }
+
+        void setWriteInterest(socket_t fd, bool on)
+        {
+#if defined(__linux__)
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLRDHUP | (on ? EPOLLOUT : 0u);
+            ev.data.fd = fd;
+            ::epoll_ctl(ep_, EPOLL_CTL_MOD, fd, &ev);
+#else
+            std::lock_guard<std::mutex> lk(mu_);
+            auto it = interest_.find(fd);
+            if (it == interest_.end())
+                return;
+            it->second = short(POLLIN | (on ? POLLOUT : 0));
+            wakeup();
+#endif
+        }
+
+        // Interrupts a blocked wait, e.g. to notice a stop request.
+        void wakeup()
+        {
+#if defined(__linux__)
+            const uint64_t one = 1;
+            (void)!::write(wake_, &one, sizeof(one));
+#elif !defined(_WIN32)
+            const char b = 0;
+            (void)!::write(wakeWrite_, &b, 1);
+#endif
+        }
+
+        // Waits up to timeoutMs (-1 = forever) and fills out with the ready sockets.
+        // Returns false on an unrecoverable error.
+        bool wait(std::vector<Event> &out, int timeoutMs)
+        {
+            out.clear();
+#if defined(__linux__)
+            epoll_event evs[64];
+            const int n = ::epoll_wait(ep_, evs, 64, timeoutMs);
+            if (n < 0)
+                return errno == EINTR;
+            for (int i = 0; i < n; ++i)
+            {
+                if (evs[i].data.fd == wake_)
+                {
+                    uint64_t drained;
+                    (void)!::read(wake_, &drained, sizeof(drained));
+                    continue;
+                }
+                const uint32_t e = evs[i].events;
+                out.push_back({evs[i].data.fd, (e & EPOLLIN) != 0, (e & EPOLLOUT) != 0,
+                               (e & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) != 0});
+            }
+            return true;
+#else
+            std::vector<pollfd> fds;
+            {
+                std::lock_guard<std::mutex> lk(mu_);
+                fds.reserve(interest_.size() + 1);
+                for (const auto &[fd, events] : interest_)
+                    fds.push_back({fd, events, 0});
+            }
+#if defined(_WIN32)
+            // No wake-up handle for WSAPoll; bound the wait instead.
+            if (timeoutMs < 0 || timeoutMs > 50)
+                timeoutMs = 50;
+            const int n = fds.empty() ? (::Sleep(DWORD(timeoutMs)), 0) : ::WSAPoll(fds.data(), ULONG(fds.size()), timeoutMs);
+#else
+            fds.push_back({wakeRead_, POLLIN, 0});
+            const int n = ::poll(fds.data(), nfds_t(fds.size()), timeoutMs);
+#endif
+            if (n < 0)
+                return wouldBlock();
+            for (const pollfd &p : fds)
+            {
+                if (p.revents == 0)
+                    continue;
+#if !defined(_WIN32)
+                if (p.fd == wakeRead_)
+                {
+                    char drain[64];
+                    while (::read(wakeRead_, drain, sizeof(drain)) > 0)
+                    {
+                    }
+                    continue;
+                }
+#endif
+                out.push_back({p.fd, (p.revents & POLLIN) != 0, (p.revents & POLLOUT) != 0,
+                               (p.revents & (POLLERR | POLLHUP | POLLNVAL)) != 0});
+            }
+            return true;
+#endif
+        }
+
+    private:
+#if defined(__linux__)
+        int ep_ = -1;
+        int wake_ = -1;
+#else
+        std::mutex mu_;
+        std::unordered_map<socket_t, short> interest_;
+#if !defined(_WIN32)
+        int wakeRead_ = -1;
+        int wakeWrite_ = -1;
+#endif
+#endif
+    };
+
+} // namespace dist
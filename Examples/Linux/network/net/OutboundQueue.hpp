@@ -0,0 +1,181 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "./Protocol.hpp"
+
+namespace dist
+{
+
+    // One piece of a frame for a gathered write; nothing is copied.
+    struct IoSlice
+    {
+        const void *data;
+        size_t len;
+    };
+
+    // Frames waiting to be written to one socket, in two lanes (see laneOf). Control
+    // frames always go out ahead of queued bulk data, and bulk messages larger than
+    // kChunkBytes are cut into CHUNK frames, so a PONG or CONFIG waits for at most one
+    // chunk rather than a whole weight transfer. gather() hands the single writer the
+    // next frames as slices for one gathered write, coalescing small frames into one
+    // syscall; consume() retires what the socket accepted.
+    //
+    // Not synchronised. Callers serialise push() against gather()/consume(); the
+    // slices gather() returns stay valid across later push() calls, so the writer
+    // may send without holding that lock.
+    class OutboundQueue
+    {
+    public:
+        static constexpr size_t kChunkBytes = 256 * 1024;
+        static constexpr size_t kMaxFrames = 32; // frames per gathered write
+        static constexpr size_t kMaxSlices = 2 * kMaxFrames;
+
+        void push(MsgType type, std::vector<uint8_t> payload)
+        {
+            const Lane lane = laneOf(type);
+            auto buf = std::make_shared<const std::vector<uint8_t>>(std::move(payload));
+            const size_t size = buf->size();
+            if (lane == Lane::Control || size <= kChunkBytes)
+            {
+                (lane == Lane::Control ? control_ : bulk_).push_back(frame(type, buf, buf->data(), size));
+                bytes_ += size + 5;
+                return;
+            }
+            for (size_t off = 0; off < size; off += kChunkBytes)
+            {
+                const size_t len = std::min(kChunkBytes, size - off);
+                bulk_.push_back(chunk(type, buf, buf->data() + off, len, off + len == size));
+                bytes_ += len + 5 + kChunkPrefixBytes;
+            }
+        }
+
+        // Queues a bulk message whose payload is the concatenation of parts without
+        // copying them: the parts must stay valid and unchanged until every piece holding
+        // keep has been written and dropped. It goes out as CHUNK frames that never
+        // straddle two parts.
+        void push(MsgType type, const IoSlice *parts, size_t count, const std::shared_ptr<const void> &keep)
+        {
+            size_t last = count;
+            for (size_t i = 0; i < count; ++i)
+                if (parts[i].len)
+                    last = i;
+            if (last == count)
+            {
+                bulk_.push_back(frame(type, keep, nullptr, 0));
+                bytes_ += 5;
+                return;
+            }
+            for (size_t i = 0; i <= last; ++i)
+            {
+                const uint8_t *data = static_cast<const uint8_t *>(parts[i].data);
+                for (size_t off = 0; off < parts[i].len; off += kChunkBytes)
+                {
+                    const size_t len = std::min(kChunkBytes, parts[i].len - off);
+                    bulk_.push_back(chunk(type, keep, data + off, len, i == last && off + len == parts[i].len));
+                    bytes_ += len + 5 + kChunkPrefixBytes;
+                }
+            }
+        }
+
+        bool empty() const { return bytes_ == 0; }
+        size_t bytes() const { return bytes_; } // queued and not yet written
+
+        // Slices for the next write: frames already started (they must finish first),
+        // then every queued control frame, then bulk frames up to about one chunk.
+        size_t gather(IoSlice *out, size_t max)
+        {
+            size_t bulkBytes = 0;
+            for (const Piece &p : inflight_)
+                bulkBytes += p.bulk ? p.len : 0;
+            while (inflight_.size() < kMaxFrames && !control_.empty())
+            {
+                inflight_.push_back(std::move(control_.front()));
+                control_.pop_front();
+            }
+            while (inflight_.size() < kMaxFrames && !bulk_.empty() && bulkBytes < kChunkBytes)
+            {
+                bulkBytes += bulk_.front().len;
+                inflight_.push_back(std::move(bulk_.front()));
+                bulk_.pop_front();
+            }
+
+            size_t n = 0;
+            for (const Piece &p : inflight_)
+            {
+                if (n + 2 > max)
+                    break;
+                if (p.sent < p.headLen)
+                    out[n++] = IoSlice{p.head.data() + p.sent, size_t(p.headLen - p.sent)};
+                const size_t bodySent = p.sent > p.headLen ? p.sent - p.headLen : 0;
+                if (p.len > bodySent)
+                    out[n++] = IoSlice{p.data + bodySent, p.len - bodySent};
+            }
+            return n;
+        }
+
+        // The socket accepted n bytes of what gather() returned.
+        void consume(size_t n)
+        {
+            bytes_ -= std::min(n, bytes_);
+            while (n > 0 && !inflight_.empty())
+            {
+                Piece &p = inflight_.front();
+                const size_t left = p.headLen + p.len - p.sent;
+                if (n < left)
+                {
+                    p.sent += n;
+                    return;
+                }
+                n -= left;
+                inflight_.pop_front();
+            }
+        }
+
+    private:
+        struct Piece
+        {
+            std::array<uint8_t, 5 + kChunkPrefixBytes> head;
+            uint8_t headLen = 5;
+            bool bulk = false;
+            std::shared_ptr<const void> keep; // owns (or stands for) the body
+            const uint8_t *data = nullptr;
+            size_t len = 0;
+            size_t sent = 0; // header + body bytes already written
+        };
+
+        static Piece frame(MsgType type, std::shared_ptr<const void> keep, const uint8_t *data, size_t len)
+        {
+            Piece p;
+            const uint32_t lenN = hostToNet32(static_cast<uint32_t>(len + 1));
+            std::memcpy(p.head.data(), &lenN, 4);
+            p.head[4] = static_cast<uint8_t>(type);
+            p.bulk = laneOf(type) == Lane::Bulk;
+            p.keep = std::move(keep);
+            p.data = data;
+            p.len = len;
+            return p;
+        }
+
+        static Piece chunk(MsgType inner, std::shared_ptr<const void> keep, const uint8_t *data, size_t len, bool last)
+        {
+            Piece p = frame(MsgType::CHUNK, std::move(keep), data, len);
+            const uint32_t lenN = hostToNet32(static_cast<uint32_t>(len + 1 + kChunkPrefixBytes));
+            std::memcpy(p.head.data(), &lenN, 4);
+            p.head[5] = static_cast<uint8_t>(inner);
+            p.head[6] = last ? 1 : 0;
+            p.headLen = 5 + kChunkPrefixBytes;
+            p.bulk = true;
+            return p;
+        }
+
+        std::deque<Piece> inflight_; // committed to the wire in this order
+        std::deque<Piece> control_;
+        std::deque<Piece> bulk_;
+        size_t bytes_ = 0;
+    };
+
+} // namespace dist
@@ -16,8 +16,58 @@ namespace dist
         PING = 2,
         PONG = 3,
         SHUTDOWN = 4,
+        ACTIVATION = 5, // pipeline: forward activations (+ targets) for one micro-batch, to the next stage
+        GRADIENT = 6,   // pipeline: gradient w.r.t. a stage's input for one micro-batch, to the previous stage
+        CONFIG = 7,     // master -> node: JSON stage assignment (ModelPartitioner::to_config_json)
+        RESOURCE_REPORT_EX = 8, // RESOURCE_REPORT plus measured throughput (CalibratedReportPayload)
+        WEIGHTS = 9,            // one layer's parameters: node -> master checkpoint/migration, master -> node relay
+        STAGE_STATS = 10,       // node -> master: measured per-batch compute time of its pipeline stage
+        TENSOR = 11,            // one dense tensor (TensorHeader + raw elements); WEIGHTS carries one per parameter
+        CHUNK = 12,             // one piece of a large bulk message: [u8 inner type][u8 last][bytes...]
+        REDUCE = 13,            // ring all-reduce: [u32 sequence][float32 values...], see RingAllReduce.hpp
+        MIGRANTS = 14,          // island GA: an island's best genomes and their fitness, see IslandMigrator.hpp
     };
 
+    // Send priority. Bulk messages can be megabytes; control messages must not queue
+    // behind them (see OutboundQueue).
+    enum class Lane
+    {
+        Control,
+        Bulk
+    };
+
+    inline Lane laneOf(MsgType t)
+    {
+        switch (t)
+        {
+        case MsgType::ACTIVATION:
+        case MsgType::GRADIENT:
+        case MsgType::WEIGHTS:
+        case MsgType::TENSOR:
+        case MsgType::REDUCE:
+        case MsgType::MIGRANTS:
+            return Lane::Bulk;
+        default:
+            return Lane::Control;
+        }
+    }
+
+    constexpr size_t kChunkPrefixBytes = 2;
+
+    // Appends one CHUNK payload to partial. Returns true when it was the last piece;
+    // partial then holds the whole message and inner its type.
+    inline bool appendChunk(std::vector<uint8_t> &partial, const uint8_t *payload, size_t len, MsgType &inner)
+    {
+        if (len < kChunkPrefixBytes)
+            throw std::runtime_error("CHUNK payload too short");
+        inner = static_cast<MsgType>(payload[0]);
+        partial.insert(partial.end(), payload + kChunkPrefixBytes, payload + len);
+        return payload[1] != 0;
+    }
+
+    // Port every node's pipeline stage listens on; CONFIG next-node addresses use it.
+    constexpr uint16_t kDefaultPipelinePort = 5600;
+
     struct ResourceReportPayload
     {
         uint64_t ramBytes; // total RAM on worker
@@ -25,6 +75,53 @@ namespace dist
         // IP is inferred from socket's peer address; no need to send it.
     };
 
+    // Sent instead of RESOURCE_REPORT by nodes that calibrate on connect.
+    struct CalibratedReportPayload
+    {
+        uint64_t ramBytes;
+        uint32_t threads;
+        float gemmGflops;
+        float memBandwidthGBs;
+        float loopbackLatencyUs;
+        uint32_t pipelinePort; // where this node's pipeline stage listens
+    };
+
+    // WEIGHTS payload: [u32 generation][u32 layer][u32 step], then the layer's weights
+    // [rows, cols] and bias [cols] as TENSOR records (see TensorHeader), tags 0 and 1.
+    struct LayerWeightsHeader
+    {
+        uint32_t generation; // partition generation the transfer belongs to
+        uint32_t layer;      // global layer index
+        uint32_t step;       // training step the weights are from
+        uint32_t rows;       // rows and cols come from the weights' TensorHeader
+        uint32_t cols;
+    };
+    constexpr size_t kLayerWeightsHeaderBytes = 12;
+
+    struct StageStatsPayload
+    {
+        uint32_t generation;
+        uint32_t step;           // global training step this stage has finished
+        float secondsPerBatch;   // forward + backward compute only, no waiting on links
+        uint32_t done;           // 1: first stage finished the job
+    };
+
+    // Header of ACTIVATION / GRADIENT payloads, followed by rows*cols floats and, for
+    // ACTIVATION, rows*targetCols target floats that the last stage needs for the loss.
+    // Floats are sent in host byte order (every node in the cluster is little-endian).
+    struct TensorFrameHeader
+    {
+        uint32_t microBatch;      // index within the batch
+        uint32_t numMicroBatches; // micro-batches in this batch
+        uint32_t batchRows;       // rows in the whole batch (loss normalisation)
+        uint32_t rows;
+        uint32_t cols;
+        uint32_t targetCols; // 0 for GRADIENT
+        float learningRate;  // ACTIVATION: step size for this batch
+        float loss;          // GRADIENT: this micro-batch's share of the batch loss
+    };
+    constexpr size_t kTensorFrameHeaderBytes = 32;
+
     // Helpers for host/network endian conversions (portable).
     inline uint32_t hostToNet32(uint32_t v)
     {
@@ -77,4 +174,296 @@ namespace dist
         return p;
     }
 
+    inline std::vector<uint8_t> encodeCalibratedReport(const CalibratedReportPayload &p)
+    {
+        std::vector<uint8_t> buf(28);
+        uint64_t ramN = hostToNet64(p.ramBytes);
+        std::memcpy(buf.data(), &ramN, 8);
+        const float scalars[3] = {p.gemmGflops, p.memBandwidthGBs, p.loopbackLatencyUs};
+        uint32_t words[5] = {p.threads, 0, 0, 0, p.pipelinePort};
+        for (int i = 0; i < 3; ++i)
+            std::memcpy(&words[i + 1], &scalars[i], 4);
+        for (int i = 0; i < 5; ++i)
+        {
+            uint32_t v = hostToNet32(words[i]);
+            std::memcpy(buf.data() + 8 + 4 * i, &v, 4);
+        }
+        return buf;
+    }
+    inline CalibratedReportPayload decodeCalibratedReport(const std::vector<uint8_t> &buf)
+    {
+        if (buf.size() != 28)
+            throw std::runtime_error("Bad CalibratedReport size");
+        CalibratedReportPayload p{};
+        uint64_t ramN;
+        std::memcpy(&ramN, buf.data(), 8);
+        p.ramBytes = netToHost64(ramN);
+        uint32_t words[5];
+        for (int i = 0; i < 5; ++i)
+        {
+            std::memcpy(&words[i], buf.data() + 8 + 4 * i, 4);
+            words[i] = netToHost32(words[i]);
+        }
+        p.threads = words[0];
+        std::memcpy(&p.gemmGflops, &words[1], 4);
+        std::memcpy(&p.memBandwidthGBs, &words[2], 4);
+        std::memcpy(&p.loopbackLatencyUs, &words[3], 4);
+        p.pipelinePort = words[4];
+        return p;
+    }
+
+    // Rewrites the generation of an encoded WEIGHTS payload (the master re-tags relays).
+    inline void setLayerWeightsGeneration(std::vector<uint8_t> &buf, uint32_t generation)
+    {
+        if (buf.size() >= 4)
+        {
+            uint32_t v = hostToNet32(generation);
+            std::memcpy(buf.data(), &v, 4);
+        }
+    }
+
+    inline std::vector<uint8_t> encodeStageStats(const StageStatsPayload &p)
+    {
+        std::vector<uint8_t> buf(16);
+        uint32_t words[4] = {p.generation, p.step, 0, p.done};
+        std::memcpy(&words[2], &p.secondsPerBatch, 4);
+        for (int i = 0; i < 4; ++i)
+        {
+            uint32_t v = hostToNet32(words[i]);
+            std::memcpy(buf.data() + 4 * i, &v, 4);
+        }
+        return buf;
+    }
+    inline StageStatsPayload decodeStageStats(const std::vector<uint8_t> &buf)
+    {
+        if (buf.size() != 16)
+            throw std::runtime_error("Bad StageStats size");
+        uint32_t words[4];
+        for (int i = 0; i < 4; ++i)
+        {
+            std::memcpy(&words[i], buf.data() + 4 * i, 4);
+            words[i] = netToHost32(words[i]);
+        }
+        StageStatsPayload p{words[0], words[1], 0.f, words[3]};
+        std::memcpy(&p.secondsPerBatch, &words[2], 4);
+        return p;
+    }
+
+    // MIGRANTS payload header, followed by count fitness floats and count*genomeLength
+    // genome floats (host byte order, like tensor frames).
+    struct MigrantsHeader
+    {
+        uint32_t island;     // sender
+        uint32_t generation; // sender's generation when the migrants left
+        uint32_t count;
+        uint32_t genomeLength;
+    };
+    constexpr size_t kMigrantsHeaderBytes = 16;
+
+    inline std::vector<uint8_t> encodeMigrants(const MigrantsHeader &h, const float *fitness, const float *genomes)
+    {
+        const size_t n = size_t(h.count) * h.genomeLength;
+        std::vector<uint8_t> buf(kMigrantsHeaderBytes + 4 * (h.count + n));
+        const uint32_t fields[4] = {h.island, h.generation, h.count, h.genomeLength};
+        for (int i = 0; i < 4; ++i)
+        {
+            uint32_t v = hostToNet32(fields[i]);
+            std::memcpy(buf.data() + 4 * i, &v, 4);
+        }
+        if (h.count)
+            std::memcpy(buf.data() + kMigrantsHeaderBytes, fitness, 4 * size_t(h.count));
+        if (n)
+            std::memcpy(buf.data() + kMigrantsHeaderBytes + 4 * size_t(h.count), genomes, 4 * n);
+        return buf;
+    }
+
+    // Fills the header and returns pointers into buf for the fitness and genomes.
+    inline MigrantsHeader decodeMigrants(const std::vector<uint8_t> &buf, const float *&fitness, const float *&genomes)
+    {
+        if (buf.size() < kMigrantsHeaderBytes)
+            throw std::runtime_error("Bad Migrants size");
+        uint32_t fields[4];
+        for (int i = 0; i < 4; ++i)
+        {
+            std::memcpy(&fields[i], buf.data() + 4 * i, 4);
+            fields[i] = netToHost32(fields[i]);
+        }
+        MigrantsHeader h{fields[0], fields[1], fields[2], fields[3]};
+        const uint64_t n = uint64_t(h.count) * h.genomeLength;
+        if (buf.size() != kMigrantsHeaderBytes + 4 * (h.count + n))
+            throw std::runtime_error("Bad Migrants size");
+        fitness = reinterpret_cast<const float *>(buf.data() + kMigrantsHeaderBytes);
+        genomes = reinterpret_cast<const float *>(buf.data() + kMigrantsHeaderBytes + 4 * size_t(h.count));
+        return h;
+    }
+
+    // ACTIVATION / GRADIENT: the header goes out through Connection::sendParts with the
+    // value and target buffers as further slices, so tensors are never copied into a frame.
+    inline void encodeTensorFrameHeader(const TensorFrameHeader &h, uint8_t (&out)[kTensorFrameHeaderBytes])
+    {
+        uint32_t fields[8] = {h.microBatch, h.numMicroBatches, h.batchRows, h.rows, h.cols, h.targetCols, 0, 0};
+        std::memcpy(&fields[6], &h.learningRate, 4);
+        std::memcpy(&fields[7], &h.loss, 4);
+        for (int i = 0; i < 8; ++i)
+        {
+            uint32_t v = hostToNet32(fields[i]);
+            std::memcpy(out + 4 * i, &v, 4);
+        }
+    }
+
+    // Decodes the header and checks it against the frame's payload length.
+    inline TensorFrameHeader decodeTensorFrameHeader(const uint8_t (&in)[kTensorFrameHeaderBytes], uint32_t payloadLen)
+    {
+        uint32_t fields[8];
+        for (int i = 0; i < 8; ++i)
+        {
+            std::memcpy(&fields[i], in + 4 * i, 4);
+            fields[i] = netToHost32(fields[i]);
+        }
+        TensorFrameHeader h{fields[0], fields[1], fields[2], fields[3], fields[4], fields[5], 0.f, 0.f};
+        std::memcpy(&h.learningRate, &fields[6], 4);
+        std::memcpy(&h.loss, &fields[7], 4);
+
+        const uint64_t n = uint64_t(h.rows) * h.cols, t = uint64_t(h.rows) * h.targetCols;
+        if (payloadLen != kTensorFrameHeaderBytes + 4 * (n + t))
+            throw std::runtime_error("Bad TensorFrame size");
+        return h;
+    }
+
+    // TENSOR record: [u8 dtype][u8 dims][u16 0][u32 tag][u32 shape[dims]] then the
+    // elements, row-major, host byte order.
+    enum class DType : uint8_t
+    {
+        F32 = 1,
+    };
+    inline size_t dtypeBytes(DType t) { return t == DType::F32 ? 4 : 0; }
+
+    constexpr size_t kMaxTensorDims = 6;
+    struct TensorHeader
+    {
+        DType dtype = DType::F32;
+        uint8_t dims = 0;
+        uint32_t tag = 0; // caller-defined: parameter index within WEIGHTS, ...
+        uint32_t shape[kMaxTensorDims] = {};
+
+        uint64_t elements() const
+        {
+            uint64_t n = 1;
+            for (int i = 0; i < dims; ++i)
+                n *= shape[i];
+            return n;
+        }
+        size_t bytes() const { return 8 + 4 * size_t(dims); }
+    };
+
+    // Writes h.bytes() bytes.
+    inline void encodeTensorHeader(const TensorHeader &h, uint8_t *out)
+    {
+        out[0] = static_cast<uint8_t>(h.dtype);
+        out[1] = h.dims;
+        out[2] = out[3] = 0;
+        uint32_t v = hostToNet32(h.tag);
+        std::memcpy(out + 4, &v, 4);
+        for (int i = 0; i < h.dims; ++i)
+        {
+            v = hostToNet32(h.shape[i]);
+            std::memcpy(out + 8 + 4 * i, &v, 4);
+        }
+    }
+
+    // in holds len bytes, at least the whole header.
+    inline TensorHeader decodeTensorHeader(const uint8_t *in, size_t len)
+    {
+        if (len < 8)
+            throw std::runtime_error("Bad TensorHeader size");
+        TensorHeader h;
+        h.dtype = static_cast<DType>(in[0]);
+        h.dims = in[1];
+        if (dtypeBytes(h.dtype) == 0 || h.dims == 0 || h.dims > kMaxTensorDims)
+            throw std::runtime_error("Bad TensorHeader");
+        if (len < h.bytes())
+            throw std::runtime_error("Bad TensorHeader size");
+        uint32_t v;
+        std::memcpy(&v, in + 4, 4);
+        h.tag = netToHost32(v);
+        for (int i = 0; i < h.dims; ++i)
+        {
+            std::memcpy(&v, in + 8 + 4 * i, 4);
+            h.shape[i] = netToHost32(v);
+        }
+        return h;
+    }
+
+    // A WEIGHTS payload is these two heads around the element blocks:
+    //   [head: layer header + weights' TensorHeader][weights][biasHead][bias]
+    // so a sender can gather it straight from the layer's tensors.
+    constexpr size_t kLayerWeightsHeadBytes = kLayerWeightsHeaderBytes + 8 + 4 * 2;
+    constexpr size_t kLayerBiasHeadBytes = 8 + 4;
+
+    inline uint64_t layerWeightsBytes(const LayerWeightsHeader &h)
+    {
+        return kLayerWeightsHeadBytes + kLayerBiasHeadBytes + 4 * (uint64_t(h.rows) * h.cols + h.cols);
+    }
+
+    inline void encodeLayerWeightsHeads(const LayerWeightsHeader &h, uint8_t (&head)[kLayerWeightsHeadBytes],
+                                        uint8_t (&biasHead)[kLayerBiasHeadBytes])
+    {
+        const uint32_t fields[3] = {h.generation, h.layer, h.step};
+        for (int i = 0; i < 3; ++i)
+        {
+            uint32_t v = hostToNet32(fields[i]);
+            std::memcpy(head + 4 * i, &v, 4);
+        }
+        TensorHeader t;
+        t.dims = 2;
+        t.tag = 0;
+        t.shape[0] = h.rows;
+        t.shape[1] = h.cols;
+        encodeTensorHeader(t, head + kLayerWeightsHeaderBytes);
+        t.dims = 1;
+        t.tag = 1;
+        t.shape[0] = h.cols;
+        encodeTensorHeader(t, biasHead);
+    }
+
+    inline LayerWeightsHeader decodeLayerWeightsHead(const uint8_t (&head)[kLayerWeightsHeadBytes])
+    {
+        uint32_t fields[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            std::memcpy(&fields[i], head + 4 * i, 4);
+            fields[i] = netToHost32(fields[i]);
+        }
+        const TensorHeader t = decodeTensorHeader(head + kLayerWeightsHeaderBytes, kLayerWeightsHeadBytes - kLayerWeightsHeaderBytes);
+        if (t.dtype != DType::F32 || t.dims != 2 || t.tag != 0)
+            throw std::runtime_error("Bad LayerWeights tensor");
+        return LayerWeightsHeader{fields[0], fields[1], fields[2], t.shape[0], t.shape[1]};
+    }
+
+    // The bias record must be the [cols] float vector that goes with h's weights.
+    inline void checkLayerBiasHead(const uint8_t (&biasHead)[kLayerBiasHeadBytes], const LayerWeightsHeader &h)
+    {
+        const TensorHeader t = decodeTensorHeader(biasHead, kLayerBiasHeadBytes);
+        if (t.dtype != DType::F32 || t.dims != 1 || t.tag != 1 || t.shape[0] != h.cols)
+            throw std::runtime_error("Bad LayerWeights bias");
+    }
+
+    // Fills the header and returns pointers into buf for the weights and bias.
+    inline LayerWeightsHeader decodeLayerWeights(const std::vector<uint8_t> &buf, const float *&weights, const float *&bias)
+    {
+        if (buf.size() < kLayerWeightsHeadBytes)
+            throw std::runtime_error("Bad LayerWeights size");
+        uint8_t head[kLayerWeightsHeadBytes], biasHead[kLayerBiasHeadBytes];
+        std::memcpy(head, buf.data(), sizeof(head));
+        const LayerWeightsHeader h = decodeLayerWeightsHead(head);
+        if (buf.size() != layerWeightsBytes(h))
+            throw std::runtime_error("Bad LayerWeights size");
+        const size_t n = 4 * size_t(h.rows) * h.cols;
+        std::memcpy(biasHead, buf.data() + kLayerWeightsHeadBytes + n, sizeof(biasHead));
+        checkLayerBiasHead(biasHead, h);
+        weights = reinterpret_cast<const float *>(buf.data() + kLayerWeightsHeadBytes);
+        bias = reinterpret_cast<const float *>(buf.data() + kLayerWeightsHeadBytes + n + kLayerBiasHeadBytes);
+        return h;
+    }
+
 } // namespace dist
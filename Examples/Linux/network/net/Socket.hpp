@@ -0,0 +1,183 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#include "./Connection.hpp"
+#include "./Logger.hpp"
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#include <errno.h>
+#include <poll.h>
+#endif
+#include <chrono>
+
+namespace dist
+{
+
+    // create a TCP socket and connect to host:port (IPv4)
+    // returns INVALID_SOCKET on failure; logConnectError=false keeps retry loops quiet
+    inline socket_t dialTcpIPv4(const std::string &host, uint16_t port, std::string &outPeerIp,
+                                bool logConnectError = true)
+    {
+#if defined(_WIN32)
+        WSADATA wsa{};
+        if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+        {
+            LOG_ERROR("WSAStartup failed");
+            return INVALID_SOCKET;
+        }
+#endif
+
+        socket_t s = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (s == INVALID_SOCKET)
+        {
+            LOG_ERROR("socket() failed");
+            return INVALID_SOCKET;
+        }
+
+        // TCP_NODELAY (optional, helps interactive control messages)
+        int one = 1;
+        ::setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<char *>(&one), sizeof(one));
+
+        sockaddr_in sin{};
+        sin.sin_family = AF_INET;
+        sin.sin_port = htons(port);
+
+        // try to parse as dotted quad; if that fails, resolve
+        if (::inet_pton(AF_INET, host.c_str(), &sin.sin_addr) != 1)
+        {
+#if defined(_WIN32)
+            addrinfoW hints{};
+            hints.ai_family = AF_INET;
+            hints.ai_socktype = SOCK_STREAM;
+            hints.ai_protocol = IPPROTO_TCP;
+            wchar_t whost[256]{};
+            mbstowcs(whost, host.c_str(), sizeof(whost) / sizeof(wchar_t) - 1);
+            addrinfoW *res = nullptr;
+            if (GetAddrInfoW(whost, nullptr, &hints, &res) != 0 || !res)
+            {
+                LOG_ERROR("DNS resolve failed for host '%s'", host.c_str());
+                closesocket(s);
+                return INVALID_SOCKET;
+            }
+            // take first A record
+            sockaddr_in *ain = reinterpret_cast<sockaddr_in *>(res->ai_addr);
+            sin.sin_addr = ain->sin_addr;
+            FreeAddrInfoW(res);
+#else
+            addrinfo hints{};
+            hints.ai_family = AF_INET;
+            hints.ai_socktype = SOCK_STREAM;
+            hints.ai_protocol = IPPROTO_TCP;
+            addrinfo *res = nullptr;
+            if (::getaddrinfo(host.c_str(), nullptr, &hints, &res) != 0 || !res)
+            {
+                LOG_ERROR("DNS resolve failed for host '%s'", host.c_str());
+                ::close(s);
+                return INVALID_SOCKET;
+            }
+            // take first A record
+            sockaddr_in *ain = reinterpret_cast<sockaddr_in *>(res->ai_addr);
+            sin.sin_addr = ain->sin_addr;
+            ::freeaddrinfo(res);
+#endif
+        }
+
+        if (::connect(s, reinterpret_cast<sockaddr *>(&sin), sizeof(sin)) != 0)
+        {
+#if defined(_WIN32)
+            if (logConnectError)
+                LOG_ERROR("connect() failed with %d", int(WSAGetLastError()));
+            closesocket(s);
+#else
+            if (logConnectError)
+                LOG_ERROR("connect() failed: %s", std::strerror(errno));
+            ::close(s);
+#endif
+            return INVALID_SOCKET;
+        }
+
+        char ipbuf[INET_ADDRSTRLEN]{};
+        ::inet_ntop(AF_INET, &sin.sin_addr, ipbuf, sizeof(ipbuf));
+        outPeerIp = ipbuf;
+        return s;
+    }
+
+    // bind + listen on 0.0.0.0:port; returns INVALID_SOCKET on failure
+    inline socket_t listenTcpIPv4(uint16_t port, int backlog = 8)
+    {
+        socket_t s = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (s == INVALID_SOCKET)
+        {
+            LOG_ERROR("socket() failed");
+            return INVALID_SOCKET;
+        }
+
+        int yes = 1;
+        ::setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<char *>(&yes), sizeof(yes));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (::bind(s, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || ::listen(s, backlog) != 0)
+        {
+            LOG_ERROR("bind/listen on port %u failed", unsigned(port));
+            closesocket(s);
+            return INVALID_SOCKET;
+        }
+        return s;
+    }
+
+    // blocking accept; sets TCP_NODELAY on the new socket
+    inline socket_t acceptTcp(socket_t listener, std::string &outPeerIp)
+    {
+        sockaddr_in addr{};
+        socklen_t len = sizeof(addr);
+        socket_t s = ::accept(listener, reinterpret_cast<sockaddr *>(&addr), &len);
+        if (s == INVALID_SOCKET)
+            return INVALID_SOCKET;
+
+        int one = 1;
+        ::setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<char *>(&one), sizeof(one));
+
+        char ipbuf[INET_ADDRSTRLEN]{};
+        ::inet_ntop(AF_INET, &addr.sin_addr, ipbuf, sizeof(ipbuf));
+        outPeerIp = ipbuf;
+        return s;
+    }
+
+    // true once s has something to read (or a pending connection, for a listener)
+    inline bool waitReadable(socket_t s, std::chrono::milliseconds timeout)
+    {
+        pollfd p{};
+        p.fd = s;
+        p.events = POLLIN;
+#if defined(_WIN32)
+        return ::WSAPoll(&p, 1, int(timeout.count())) > 0;
+#else
+        return ::poll(&p, 1, int(timeout.count())) > 0;
+#endif
+    }
+
+    // "host:port" -> (host, port); false if the port is missing or malformed
+    inline bool splitHostPort(const std::string &addr, std::string &host, uint16_t &port)
+    {
+        const size_t colon = addr.rfind(':');
+        if (colon == std::string::npos || colon + 1 >= addr.size())
+            return false;
+        char *end = nullptr;
+        const unsigned long p = std::strtoul(addr.c_str() + colon + 1, &end, 10);
+        if (*end != '\0' || p == 0 || p > 65535)
+            return false;
+        host = addr.substr(0, colon);
+        port = uint16_t(p);
+        return true;
+    }
+
+} // namespace dist
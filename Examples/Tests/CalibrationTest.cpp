@@ -0,0 +1,17 @@
+#include "Check.hpp"
+#include "System_Benchmark.hpp"
+#include "TensorArena.hpp"
+#include "ThreadPool.hpp"
+
+// Calibration runs on a node before it reports its free RAM: it must not leave its
+// buffers cached in the arena.
+int main()
+{
+    ThreadPool pool(2);
+    const size_t before = NeuralNetwork::TensorArena::cachedBytes();
+    const sys_bench::Calibration c = sys_bench::calibrate(pool);
+    CHECK(c.gemm_gflops > 0.0);
+    CHECK(c.mem_bandwidth_gbs > 0.0);
+    CHECK(NeuralNetwork::TensorArena::cachedBytes() == before);
+    return checkFailures();
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdio>
+
+// Minimal check macro for the test executables: reports the failed expression and
+// counts it, so main can return the number of failures.
+inline int &checkFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(expr)                                                                           \
+    do                                                                                        \
+    {                                                                                         \
+        if (!(expr))                                                                          \
+        {                                                                                     \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr);     \
+            ++checkFailures();                                                                \
+        }                                                                                     \
+    } while (0)
@@ -0,0 +1,102 @@
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "Check.hpp"
+#include "GradientCodec.hpp"
+
+using namespace dist;
+
+namespace
+{
+    float bits(uint32_t x)
+    {
+        float f;
+        std::memcpy(&f, &x, 4);
+        return f;
+    }
+
+    std::vector<float> roundTrip(Codec c, const std::vector<float> &in)
+    {
+        std::vector<uint8_t> wire(encodedBytes(c, in.size()));
+        encodeValues(c, in.data(), in.size(), wire.data());
+        std::vector<float> out(in.size());
+        decodeValues(c, wire.data(), in.size(), out.data());
+        return out;
+    }
+}
+
+int main()
+{
+    const float inf = std::numeric_limits<float>::infinity(), nan = std::numeric_limits<float>::quiet_NaN();
+
+    // FP16: every half survives half -> float -> half.
+    for (uint32_t h = 0; h < 0x10000u; ++h)
+        if ((h & 0x7c00u) != 0x7c00u || (h & 0x3ffu) == 0)
+            CHECK(floatToHalf(halfToFloat(uint16_t(h))) == h);
+    // Ties to even, normal and subnormal.
+    CHECK(floatToHalf(1.f + std::ldexp(1.f, -11)) == 0x3c00);     // 1 + half an ulp -> 1
+    CHECK(floatToHalf(1.f + 3 * std::ldexp(1.f, -11)) == 0x3c02); // -> even mantissa above
+    CHECK(floatToHalf(std::ldexp(1.f, -25)) == 0x0000);           // half the smallest subnormal
+    CHECK(floatToHalf(3 * std::ldexp(1.f, -25)) == 0x0002);
+    CHECK(floatToHalf(std::ldexp(1.f, -14) - std::ldexp(1.f, -25)) == 0x0400); // up into the normals
+    CHECK(floatToHalf(-std::ldexp(1.f, -24)) == 0x8001);
+    CHECK(floatToHalf(1e-40f) == 0x0000); // float subnormal
+    // Overflow: the largest half, the tie above it, and beyond.
+    CHECK(floatToHalf(65504.f) == 0x7bff);
+    CHECK(floatToHalf(65519.f) == 0x7bff);
+    CHECK(floatToHalf(65520.f) == 0x7c00);
+    CHECK(floatToHalf(-1e6f) == 0xfc00);
+    CHECK(floatToHalf(inf) == 0x7c00);
+    CHECK(std::isnan(halfToFloat(floatToHalf(nan))));
+
+    // BF16: every bf16 survives the round trip; rounding as for FP16.
+    for (uint32_t h = 0; h < 0x10000u; ++h)
+        if ((h & 0x7f80u) != 0x7f80u || (h & 0x7fu) == 0)
+            CHECK(floatToBf16(bf16ToFloat(uint16_t(h))) == h);
+    CHECK(floatToBf16(1.f + std::ldexp(1.f, -8)) == 0x3f80);
+    CHECK(floatToBf16(1.f + 3 * std::ldexp(1.f, -8)) == 0x3f82);
+    CHECK(floatToBf16(bits(0x00008000u)) == 0x0000); // subnormal ties
+    CHECK(floatToBf16(bits(0x00018000u)) == 0x0002);
+    CHECK(floatToBf16(std::numeric_limits<float>::max()) == 0x7f80);
+    CHECK(floatToBf16(-inf) == 0xff80);
+    CHECK(std::isnan(bf16ToFloat(floatToBf16(nan))));
+
+    // Int8: within half a step of the chunk's scale.
+    {
+        const std::vector<float> in = {0.f, 1.f, -2.f, 0.5f, 3.9f, -0.01f};
+        const std::vector<float> out = roundTrip(Codec::Int8, in);
+        for (size_t i = 0; i < in.size(); ++i)
+            CHECK(std::fabs(out[i] - in[i]) <= 3.9f / 127.f * 0.5f + 1e-6f);
+    }
+    // Non-finite values neither poison the chunk nor reach the int8 conversion.
+    {
+        const std::vector<float> in = {1.f, inf, -2.f, nan, -inf, 0.5f};
+        const std::vector<float> out = roundTrip(Codec::Int8, in);
+        for (float v : out)
+            CHECK(std::isfinite(v));
+        CHECK(std::fabs(out[0] - 1.f) <= 2.f / 127.f);
+        CHECK(out[1] == 2.f && out[4] == -2.f); // saturated at the largest finite |x|
+        CHECK(out[3] == 0.f);
+    }
+    for (const std::vector<float> &in : {std::vector<float>{nan, inf, -inf}, std::vector<float>{0.f, 1e-44f, -1e-45f}})
+        for (float v : roundTrip(Codec::Int8, in))
+            CHECK(std::isfinite(v));
+
+    // None is exact; TopK moves the largest entries and keeps the rest as residual.
+    {
+        const std::vector<float> in = {1.f, -3.f, nan, 1e-30f};
+        const std::vector<float> out = roundTrip(Codec::None, in);
+        CHECK(std::memcmp(in.data(), out.data(), sizeof(float) * in.size()) == 0);
+
+        std::vector<float> residual = {0.1f, -5.f, 0.2f, 4.f, -0.3f};
+        std::vector<uint8_t> msg;
+        encodeTopK(residual.data(), residual.size(), 2, msg);
+        std::vector<float> sum(residual.size(), 0.f);
+        addTopK(msg.data(), msg.size(), sum.data(), sum.size());
+        CHECK(sum[1] == -5.f && sum[3] == 4.f && sum[0] == 0.f);
+        CHECK(residual[1] == 0.f && residual[3] == 0.f && residual[4] == -0.3f);
+    }
+    return checkFailures();
+}
@@ -0,0 +1,43 @@
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "Check.hpp"
+#include "SpatialGrid.hpp"
+
+int main()
+{
+    ThreadPool pool(4);
+    const float nan = std::numeric_limits<float>::quiet_NaN(), inf = std::numeric_limits<float>::infinity();
+
+    // Non-finite coordinates are filed in range and never match a query.
+    {
+        sim::SpatialGrid grid(64.f, 64.f, 8.f);
+        const std::vector<float> x = {10.f, nan, 12.f, inf, -inf, 30.f, nan};
+        const std::vector<float> y = {10.f, 10.f, nan, 5.f, 5.f, inf, nan};
+        grid.build(pool, x.data(), y.data(), x.size());
+        CHECK(grid.size() == x.size());
+        CHECK(grid.countWithin(10.f, 10.f, 4.f) == 1);
+        CHECK(grid.nearest(10.f, 10.f, 100.f, 0) == -1);
+        CHECK(grid.nearest(nan, nan, 10.f) == -1);
+        size_t seen = 0;
+        grid.forEachWithin(32.f, 32.f, 1000.f, [&](size_t)
+                           { ++seen; });
+        CHECK(seen == 1);
+    }
+
+    // A grid with far more cells than points: one histogram, same answers.
+    {
+        sim::SpatialGrid grid(4096.f, 4096.f, 1.f);
+        std::vector<float> x, y;
+        for (uint32_t i = 0; i < 40000; ++i)
+        {
+            x.push_back(float(i % 4096u) + 0.5f);
+            y.push_back(float(i / 4096u * 400u) + 0.5f);
+        }
+        grid.build(pool, x.data(), y.data(), x.size());
+        CHECK(grid.countWithin(x[17], y[17], 0.25f) == 1);
+        CHECK(grid.nearest(x[17], y[17], 0.25f) == 17);
+    }
+    return checkFailures();
+}
@@ -0,0 +1,123 @@
+#include <sys/socket.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "Check.hpp"
+#include "TensorTransfer.hpp"
+
+using namespace dist;
+using NeuralNetwork::Tensor;
+
+namespace
+{
+    Tensor filled(std::initializer_list<int> shape, float base)
+    {
+        Tensor t(int(shape.size()), nullptr, shape);
+        for (uint64_t i = 0; i < t.length(); ++i)
+            t.data[i] = base + float(i);
+        return t;
+    }
+
+    bool same(const Tensor &a, const Tensor &b)
+    {
+        if (a.dims != b.dims || a.length() != b.length())
+            return false;
+        for (int i = 0; i < a.dims; ++i)
+            if (a.shape[i] != b.shape[i])
+                return false;
+        for (uint64_t i = 0; i < a.length(); ++i)
+            if (a.data[i] != b.data[i])
+                return false;
+        return true;
+    }
+}
+
+// WEIGHTS go out of a writer-driven connection straight from the tensors (in CHUNK
+// frames, with control messages overtaking them) and land in new tensors on the other side.
+int main()
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        return 1;
+    Connection tx(fds[0], "tx"), rx(fds[1], "rx");
+    tx.startWriter();
+
+    const Tensor big = filled({300, 700}, 1.f), bigBias = filled({700}, -5.f); // ~840 KB: several chunks
+    const Tensor small = filled({3, 2}, 0.5f), smallBias = filled({2}, 9.f);
+    Tensor sentBig = big.view();
+    std::thread sender([&]
+                       {
+        tx.post(MsgType::PING, {});
+        CHECK(sendLayerWeights(tx, 3, 7, 42, sentBig, bigBias));
+        // Written by now: changing the weights must not reach the peer.
+        for (uint64_t i = 0; i < sentBig.length(); ++i)
+            sentBig.data[i] = 0.f;
+        tx.post(MsgType::PONG, {});
+
+        // A bias record that does not go with the weights is dropped; the stream stays in step.
+        uint8_t head[kLayerWeightsHeadBytes], biasHead[kLayerBiasHeadBytes], other[kLayerWeightsHeadBytes];
+        encodeLayerWeightsHeads({3, 8, 42, 3, 2}, head, biasHead);
+        encodeLayerWeightsHeads({3, 8, 42, 3, 3}, other, biasHead); // bias [3] after weights [3, 2]
+        const IoSlice bad[4] = {{head, sizeof(head)}, {small.data, 4 * 6}, {biasHead, sizeof(biasHead)}, {smallBias.data, 4 * 2}};
+        CHECK(tx.sendParts(MsgType::WEIGHTS, bad, 4));
+
+        CHECK(sendLayerWeights(tx, 3, 9, 43, small, smallBias));
+        tx.post(MsgType::SHUTDOWN, {}); });
+
+    // Start reading late: the big layer cannot fit in the socket buffer, so its send only
+    // completes as it is read here, and the weights it zeroes afterwards must not show.
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    LayerReceiver receiver;
+    std::vector<MsgType> control;
+    std::vector<LayerTensors> layers;
+    int malformed = 0;
+    MsgType type{};
+    std::vector<uint8_t> payload;
+    while (control.size() < 3 && rx.recvMessage(type, payload, MsgType::WEIGHTS, &receiver))
+    {
+        if (type != MsgType::WEIGHTS)
+        {
+            control.push_back(type);
+            continue;
+        }
+        CHECK(payload.empty());
+        try
+        {
+            layers.push_back(receiver.take());
+        }
+        catch (const std::exception &)
+        {
+            ++malformed;
+        }
+    }
+    sender.join();
+
+    CHECK(control.size() == 3 && control.back() == MsgType::SHUTDOWN);
+    CHECK(malformed == 1);
+    CHECK(layers.size() == 2);
+    if (layers.size() == 2)
+    {
+        const LayerWeightsHeader &h = layers[0].header;
+        CHECK(h.generation == 3 && h.layer == 7 && h.step == 42 && h.rows == 300 && h.cols == 700);
+        CHECK(same(layers[0].weights, filled({300, 700}, 1.f)));
+        CHECK(same(layers[0].bias, bigBias));
+        CHECK(layers[1].header.layer == 9 && layers[1].header.step == 43);
+        CHECK(same(layers[1].weights, small));
+        CHECK(same(layers[1].bias, smallBias));
+    }
+
+    // The master keeps WEIGHTS as bytes: the same message decodes from a plain receive.
+    int fds2[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds2) != 0)
+        return 1;
+    Connection a(fds2[0], "a"), b(fds2[1], "b");
+    CHECK(sendLayerWeights(a, 1, 2, 3, small, smallBias));
+    CHECK(b.recvMessage(type, payload) && type == MsgType::WEIGHTS);
+    const float *w = nullptr, *bias = nullptr;
+    const LayerWeightsHeader h = decodeLayerWeights(payload, w, bias);
+    CHECK(h.layer == 2 && h.rows == 3 && h.cols == 2);
+    CHECK(std::equal(small.data, small.data + 6, w) && std::equal(smallBias.data, smallBias.data + 2, bias));
+    return checkFailures();
+}
@@ -0,0 +1,35 @@
+#include "Check.hpp"
+#include "World.hpp"
+
+// Dead blobs keep their slots until removeDead(); ticking must leave them frozen.
+int main()
+{
+    ThreadPool pool(2);
+    sim::World world(pool);
+    sim::Traits t;
+    t.speed = 1.f;
+    const size_t a = world.spawn(t, 100.f, 100.f, sim::East);
+    const size_t b = world.spawn(t, 200.f, 200.f, sim::North);
+
+    // b is dead but standing still and fed: the default config would heal it.
+    world.health[b] = -0.25f;
+    world.turn[b] = 1;
+    world.throttle[b] = 1.f;
+    world.throttle[a] = 1.f;
+    const float bx = world.x[b], by = world.y[b], bfood = world.food[b];
+    const uint8_t bfacing = world.facing[b];
+
+    for (int tick = 0; tick < 10; ++tick)
+        CHECK(world.tick() == 1);
+    CHECK(world.health[b] == -0.25f);
+    CHECK(world.x[b] == bx && world.y[b] == by);
+    CHECK(world.facing[b] == bfacing);
+    CHECK(world.food[b] == bfood);
+    CHECK(world.x[a] > 100.f); // the living blob still moves
+    CHECK(world.health[a] > 0.f);
+
+    world.removeDead();
+    CHECK(world.size() == 1);
+    CHECK(world.tick() == 0);
+    return checkFailures();
+}